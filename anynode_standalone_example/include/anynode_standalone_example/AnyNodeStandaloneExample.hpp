@@ -23,15 +23,13 @@ class AnyNodeStandaloneExample : public any_node::Node {
   void preCleanup();
   void cleanup() override;
 
-  bool updateEthercatMaster(const any_worker::WorkerEvent& event);
-
   bool startupWorker(const any_worker::WorkerEvent& event);
 
  protected:
   EthercatDeviceConfigurator::SharedPtr configurator_;
-  std::atomic<bool> abrt_{false};
-  std::atomic<bool> startComplete_{false};
-  std::atomic<bool> abortStartup_{false};
+  std::vector<std::future<EthercatDeviceConfigurator::MasterShutdownReport>> shutdownReports_;
+  // Hard deadline of the shutdown of all buses in seconds
+  double shutdownTimeout_{5.0};
 };
 
 } /* namespace anynode_standalone_example */
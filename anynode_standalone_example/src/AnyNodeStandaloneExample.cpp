@@ -29,15 +29,8 @@ bool AnyNodeStandaloneExample::init() {
   startupWorkerOptions.callback_ = std::bind(&AnyNodeStandaloneExample::startupWorker, this, std::placeholders::_1);
   startupWorkerOptions.name_ = "AnyNodeStandaloneExample::startupWorker";
   startupWorkerOptions.timeStep_ = std::numeric_limits<double>::infinity();  // will terminate when startup complete or aborted.
-  this->addWorker(startupWorkerOptions);
-
-  any_worker::WorkerOptions ethercatMasterOptions;
-  ethercatMasterOptions.callback_ = std::bind(&AnyNodeStandaloneExample::updateEthercatMaster, this, std::placeholders::_1);
-  ethercatMasterOptions.defaultPriority_ = 39;
-  ethercatMasterOptions.name_ = "AnyNodeStandaloneExample::updateEthercatMaster";
-  ethercatMasterOptions.timeStep_ = std::numeric_limits<double>::infinity();
-  if (!this->addWorker(ethercatMasterOptions)) {
-    MELO_ERROR_STREAM("[AnyNodeStandaloneExample] Worker " << ethercatMasterOptions.name_ << "could not be added!");
+  if (!this->addWorker(startupWorkerOptions)) {
+    MELO_ERROR_STREAM("[AnyNodeStandaloneExample] Worker " << startupWorkerOptions.name_ << "could not be added!");
     return false;
   }
 
@@ -46,53 +39,38 @@ bool AnyNodeStandaloneExample::init() {
 
 void AnyNodeStandaloneExample::preCleanup() {
   MELO_INFO_STREAM(" ");
-  abortStartup_ = true;
-  for (const auto& master : configurator_->getMasters()) {
-    master->preShutdown(true);
-  }
-  abrt_ = true;
+  configurator_->abortStartup();
+  // All buses concurrently: preShutdown(true) while still cycling, then the cyclic thread is stopped and the master shut down.
+  shutdownReports_ = configurator_->shutdownAsync(shutdownTimeout_);
 }
 
 void AnyNodeStandaloneExample::cleanup() {
   MELO_INFO_STREAM(" ");
-  for (const auto& master : configurator_->getMasters()) {
-    master->shutdown();
-  }
-}
-
-bool AnyNodeStandaloneExample::startupWorker(const any_worker::WorkerEvent& event) {
-  for (auto& master : configurator_->getMasters()) {
-    if (master->startup(abortStartup_)) {
-      startComplete_ = true;
-    } else {
-      std::cerr << "Startup not successful." << std::endl;
-      return false;
+  for (auto& shutdownReport : shutdownReports_) {
+    const auto report = shutdownReport.get();
+    if (!report.success) {
+      MELO_WARN_STREAM("[AnyNodeStandaloneExample] Shutdown of bus " << report.ethercat_bus << " failed: " << report.error)
     }
   }
-  return true;
 }
 
-bool AnyNodeStandaloneExample::updateEthercatMaster(const any_worker::WorkerEvent& event) {
-  while (!abortStartup_) {  // use a conditional variable or atomic_flag_wait_for or something more smart..
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    if (startComplete_) {
-      break;
+bool AnyNodeStandaloneExample::startupWorker(const any_worker::WorkerEvent& event) {
+  // All buses start up concurrently, a slow bus does not delay the others. Aborted by preCleanup.
+  bool success = true;
+  for (auto& startupReport : configurator_->startupAsync()) {
+    const auto report = startupReport.get();
+    if (!report.success) {
+      MELO_ERROR_STREAM("[AnyNodeStandaloneExample] Startup of bus " << report.ethercat_bus << " not successful: " << report.error)
+      success = false;
     }
   }
-
-  if (startComplete_) {
-    for (const auto& master : configurator_->getMasters()) {
-      master->activate();
-    }
-
-    while (!abrt_) {
-      for (const auto& master : configurator_->getMasters()) {
-        master->update(ecat_master::UpdateMode::StandaloneEnforceRate);
-      }
-    }
+  // preCleanup aborted the startup, the buses are being shut down
+  if (!success || configurator_->isStartupAborted()) {
+    return false;
   }
-
-  return true;
+  // One cyclic thread per bus, a slow bus does not delay the others. Priority and cpu core are configured per bus with rt_priority and
+  // cpu_core in ethercat_master_s. Does not start if preCleanup ran in the meantime.
+  return configurator_->startRuntime();
 }
 
 } /* namespace anynode_standalone_example */
@@ -0,0 +1,133 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "yaml-cpp/yaml.h"
+
+/**
+ * @brief ConfigurationCache - process wide cache of resolved configuration file paths and loaded configuration documents.
+ * Documents are keyed by their canonical path and reloaded if the modification time of the file changed.
+ * All methods are thread safe.
+ */
+class ConfigurationCache {
+ public:
+  class Document {
+   public:
+    Document(std::string path, int64_t modificationTime, std::string content);
+
+    // Canonical path of the file
+    const std::string& path() const { return m_path; }
+    // Modification time of the file when it was read
+    int64_t modificationTime() const { return m_modification_time; }
+    // 64 bit FNV-1a hash of the file content
+    uint64_t hash() const { return m_hash; }
+    const std::string& content() const { return m_content; }
+    /**
+     * @brief node - the parsed yaml document. Parsed on first access, thread safe.
+     * @return a clone owned by the caller: yaml-cpp nodes are not thread safe, even reading a node with operator[] can modify it
+     * @throw YAML::Exception if the file is no valid yaml
+     */
+    YAML::Node node() const;
+
+   private:
+    std::string m_path;
+    int64_t m_modification_time{0};
+    std::string m_content;
+    uint64_t m_hash{0};
+    mutable std::once_flag m_parse_flag;
+    mutable YAML::Node m_node;
+  };
+  typedef std::shared_ptr<const Document> DocumentPtr;
+
+  struct Statistics {
+    std::size_t path_hits{0};
+    std::size_t path_misses{0};
+    std::size_t document_hits{0};
+    std::size_t document_misses{0};
+  };
+
+  /**
+   * @brief instance - the process wide cache
+   */
+  static ConfigurationCache& instance();
+
+  /**
+   * @brief resolvePath - creates the path of a configuration file given in a setup.yaml. Relative paths are appended to the directory of
+   * the setup file, '~' is replaced with the home directory. Symlinks are not resolved in the returned path. Cached per (path, setup
+   * file directory), a cached path is only used while the file still exists with the modification time it had when it was resolved.
+   * @param canonical_path - if given, set to the canonical path of the file (symlinks resolved), e.g. to compare files
+   * @throw std::runtime_error if the file does not exist
+   */
+  std::string resolvePath(const std::string& path, const std::string& setup_file_path, std::string* canonical_path = nullptr);
+
+  /**
+   * @brief resolvedModificationTime - modification time of a file resolved by resolvePath, without resolving it
+   * @return false if the path was not resolved yet, or the file was deleted or modified since
+   */
+  bool resolvedModificationTime(const std::string& path, const std::string& setup_file_path, int64_t& modification_time) const;
+
+  /**
+   * @brief load - reads the file, or returns the cached document if the file has not been modified since.
+   * @param path - path to the file, does not have to be canonical
+   * @throw std::runtime_error if the file cannot be read
+   */
+  DocumentPtr load(const std::string& path);
+
+  /**
+   * @brief clear - drops all cached paths and documents
+   */
+  void clear();
+
+  Statistics getStatistics() const;
+
+  /**
+   * @brief hash - 64 bit FNV-1a hash
+   */
+  static uint64_t hash(const std::string& data);
+  static uint64_t hash(const char* data, std::size_t size);
+
+ private:
+  ConfigurationCache() = default;
+
+  struct ResolvedPath {
+    std::string path;
+    // Checked for modifications
+    std::string canonical_path;
+    int64_t modification_time{0};
+  };
+  // false if the key is not cached or the file was deleted or modified since it was resolved
+  bool findResolvedPath(const std::string& key, ResolvedPath& resolved) const;
+
+  mutable std::mutex m_mutex;
+  // (setup file directory + '\n' + path as written in the setup file) to resolved path
+  std::unordered_map<std::string, ResolvedPath> m_resolved_paths;
+  // canonical path to document
+  std::unordered_map<std::string, DocumentPtr> m_documents;
+  Statistics m_statistics;
+};
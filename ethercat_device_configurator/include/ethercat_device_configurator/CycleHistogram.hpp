@@ -0,0 +1,112 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief CycleHistogram - fixed memory, lock-free log-linear histogram of durations in nanoseconds (HDR histogram layout).
+ * Values below 2^subBucketBits are counted exactly, above that every power of two is split into 2^subBucketBits linear buckets,
+ * i.e. the relative bucket width is at most 1/32. Values of 2^(maxExponent + 1) ns (about 37 minutes) and above are counted by a separate
+ * overflow counter.
+ * record() is meant for a single writer (the cyclic thread), all queries can be called concurrently from any other thread.
+ */
+class CycleHistogram {
+ public:
+  static constexpr unsigned subBucketBits = 5;
+  static constexpr unsigned subBucketCount = 1u << subBucketBits;
+  static constexpr unsigned maxExponent = 40;
+  static constexpr std::size_t numberOfBuckets = subBucketCount + (maxExponent - subBucketBits + 1) * subBucketCount;
+  // bucketIndex of the values beyond the last bucket
+  static constexpr std::size_t overflowIndex = numberOfBuckets;
+  // Returned by percentile if the percentile lies in the overflow counter
+  static constexpr int64_t overflowValue = std::numeric_limits<int64_t>::max();
+
+  CycleHistogram() { reset(); }
+  CycleHistogram(const CycleHistogram&) = delete;
+  CycleHistogram& operator=(const CycleHistogram&) = delete;
+
+  /**
+   * @brief record - counts a value, negative values are counted as 0. Wait-free, does not allocate.
+   */
+  void record(int64_t nanoseconds) {
+    const uint64_t value = nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0;
+    const std::size_t index = bucketIndex(value);
+    if (index == overflowIndex) {
+      m_overflow.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      m_buckets[index].fetch_add(1, std::memory_order_relaxed);
+    }
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    if (value > m_max.load(std::memory_order_relaxed)) m_max.store(value, std::memory_order_relaxed);
+    if (value < m_min.load(std::memory_order_relaxed)) m_min.store(value, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief reset - clears all counts. Values recorded concurrently may be partially kept.
+   */
+  void reset();
+
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+  // Number of values beyond the last bucket
+  uint64_t overflowCount() const { return m_overflow.load(std::memory_order_relaxed); }
+  // Exact, 0 if empty
+  int64_t min() const;
+  // Exact, 0 if empty
+  int64_t max() const;
+  double mean() const;
+  /**
+   * @brief percentile - upper bound of the bucket containing the given percentile, clamped to max()
+   * @param percentile - in [0, 100]
+   * @return 0 if empty, overflowValue if the percentile lies beyond the last bucket
+   */
+  int64_t percentile(double percentile) const;
+  /**
+   * @brief countAbove - number of recorded values above a threshold (with bucket resolution), including the overflowed values. 0 if the
+   * threshold itself overflows.
+   */
+  uint64_t countAbove(int64_t nanoseconds) const;
+
+  static std::size_t bucketIndex(uint64_t value) {
+    if (value < subBucketCount) return static_cast<std::size_t>(value);
+    const unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    if (exponent > maxExponent) return overflowIndex;
+    const uint64_t mantissa = (value >> (exponent - subBucketBits)) & (subBucketCount - 1);
+    return subBucketCount + (exponent - subBucketBits) * subBucketCount + static_cast<std::size_t>(mantissa);
+  }
+  // Largest value counted in a bucket, the maximum of uint64_t for overflowIndex
+  static uint64_t bucketUpperBound(std::size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, numberOfBuckets> m_buckets;
+  std::atomic<uint64_t> m_overflow;
+  std::atomic<uint64_t> m_count;
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_min;
+  std::atomic<uint64_t> m_max;
+};
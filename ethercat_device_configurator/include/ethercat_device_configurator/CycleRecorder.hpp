@@ -0,0 +1,231 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+#include "ethercat_device_configurator/SharedMemoryLayout.hpp"
+
+/*
+ * Format of the ring files of a CycleRecorder, one ring per master:
+ *
+ *   CycleRecordFileHeader
+ *   CycleRecordSlave[slave_count]             the recorded slaves of the master
+ *   frames at frames_offset, frame_size each:
+ *     CycleRecordFrameHeader
+ *     per slave: reading (reading_layout), staged command (command_layout)
+ *
+ * The frame after the last written one has cycle 0. Files are reused in a ring: the file with the highest sequence is the newest one.
+ * Every recorder writes a new recording, directory/<bus>_<recording>_<index>.cyclerec, earlier recordings are never overwritten.
+ */
+struct CycleRecordFileHeader {
+  // Increment on every change of the format
+  static constexpr uint32_t formatVersion = 1;
+  // "ECATREC"
+  static constexpr uint64_t formatMagic = 0x4543415452454300;
+
+  uint64_t magic{formatMagic};
+  uint32_t version{formatVersion};
+  uint32_t slave_count{0};
+  char ethercat_bus[32]{};
+  uint64_t file_size{0};
+  uint64_t frame_size{0};
+  uint64_t frames_offset{0};
+  // Position of the content in the ring, set when the recorder starts writing the file. 0: never written
+  uint64_t sequence{0};
+  // CLOCK_REALTIME - CLOCK_MONOTONIC in ns when the recorder was created, converts the stamps to wall time
+  int64_t realtime_offset{0};
+};
+
+struct CycleRecordSlave {
+  char name[64]{};
+  char type_name[32]{};
+  uint32_t ethercat_address{0};
+  // Slave handle in the configurator which recorded the file
+  uint32_t handle{0};
+  SharedMemoryDataLayout reading_layout{SharedMemoryDataLayout::None};
+  // None if the type cannot report its staged command
+  SharedMemoryDataLayout command_layout{SharedMemoryDataLayout::None};
+};
+
+struct CycleRecordFrameHeader {
+  // Cycle of the master, starting at 1
+  uint64_t cycle{0};
+  // CLOCK_MONOTONIC in ns after the update
+  int64_t stamp{0};
+};
+
+/**
+ * @brief CycleRecorder - records the readings and staged commands of all slaves of a master in every cycle into a ring of preallocated,
+ * memory mapped files. The cyclic thread only writes the frames into an anonymous, pre-faulted buffer: no syscalls, no allocations and no
+ * page faults on file pages (writeback). A flusher thread copies them into the files, frames which do not fit into the buffer because
+ * the flusher fell behind are dropped and counted. Old cycles are overwritten once the ring is full, the disk usage of a recording is
+ * bounded by number_of_files * file_size. Attach recorders with attach, convert the files with recorder_to_csv (CycleRecording).
+ */
+class CycleRecorder {
+ public:
+  struct Configuration {
+    // Created if it does not exist
+    std::string directory{};
+    // Size of every file in bytes
+    std::size_t file_size{64 * 1024 * 1024};
+    unsigned int number_of_files{4};
+    // Frames buffered between the cyclic thread and the flusher thread
+    std::size_t buffer_frames{4096};
+    // Period of the flusher thread in seconds
+    double flush_period{0.01};
+    // mlock the buffer: it is never swapped out, needs RLIMIT_MEMLOCK
+    bool lock_memory{false};
+  };
+
+  struct Slave {
+    std::string name{};
+    std::string type_name{};
+    uint32_t ethercat_address{0};
+    std::size_t handle{0};
+    std::shared_ptr<ecat_master::EthercatDevice> device{};
+    // Slaves without reading are not recorded
+    DeviceFactoryRegistry::ProcessDataAdapter adapter{};
+  };
+
+  /**
+   * @brief CycleRecorder - creates, sizes and maps the files of a new recording (directory/<bus>_<recording>_<index>.cyclerec, the
+   * recording is named after the local start time) and starts the flusher thread. Existing files are never replaced.
+   * @throw std::runtime_error if the files cannot be created, or a frame does not fit into a file
+   */
+  CycleRecorder(const Configuration& configuration, const std::string& ethercat_bus, std::vector<Slave> slaves);
+  // Flushes the buffered frames and stops the flusher thread
+  ~CycleRecorder();
+
+  /**
+   * @brief attach - creates a recorder per master of the configurator, serviced by the cyclic thread of the master after every update.
+   * Slaves are recorded if their type has a process data adapter (DeviceFactoryRegistry), with their staged command if it reports it.
+   * @return the recorders, indexed like getMasters
+   * @throw std::runtime_error if the runtime of the configurator is running or the files cannot be created
+   */
+  static std::vector<std::shared_ptr<CycleRecorder>> attach(EthercatDeviceConfigurator& configurator, const Configuration& configuration);
+  CycleRecorder(const CycleRecorder&) = delete;
+  CycleRecorder& operator=(const CycleRecorder&) = delete;
+
+  /**
+   * @brief cycle - appends the frame of the current cycle to the buffer. Called by the cyclic thread of the master after every update.
+   */
+  void cycle();
+
+  const std::string& getRecording() const { return m_recording; }
+  const std::vector<std::string>& getFilePaths() const { return m_file_paths; }
+  std::size_t getFrameSize() const { return m_frame_size; }
+  // Frames copied into the files
+  uint64_t getFramesWritten() const { return m_frames_written.load(std::memory_order_relaxed); }
+  // Frames lost because the buffer was full, their cycles are missing in the files
+  uint64_t getFramesDropped() const { return m_frames_dropped.load(std::memory_order_relaxed); }
+  // Number of file switches, including the ones which overwrote old cycles
+  uint64_t getRotations() const { return m_rotations.load(std::memory_order_relaxed); }
+
+  static std::string filePath(const std::string& directory, const std::string& ethercat_bus, const std::string& recording,
+                              unsigned int index);
+
+ private:
+  // Mapping of a ring file (synced) or of the buffer, unmapped on destruction (also if the constructor of the recorder throws)
+  struct Mapping {
+    Mapping(char* data, std::size_t size, bool file) : data(data), size(size), file(file) {}
+    Mapping(Mapping&& other) noexcept : data(other.data), size(other.size), file(other.file) { other.data = nullptr; }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    Mapping& operator=(Mapping&&) = delete;
+    ~Mapping();
+
+    char* data{nullptr};
+    std::size_t size{0};
+    bool file{false};
+  };
+
+  // Flusher thread: copies the buffered frames into the files
+  void flush();
+  void writeFrame(const char* frame);
+  // Starts writing the next file of the ring
+  void rotate();
+
+  Configuration m_configuration;
+  std::vector<Slave> m_slaves;
+  std::string m_recording;
+  std::vector<std::string> m_file_paths;
+  std::vector<Mapping> m_files;
+  std::size_t m_frame_size{0};
+  std::size_t m_frames_offset{0};
+  std::size_t m_frames_per_file{0};
+
+  // Single producer (cyclic thread), single consumer (flusher thread) ring of buffer_frames frames. The frames [m_flushed, m_buffered)
+  // are owned by the flusher.
+  std::unique_ptr<Mapping> m_buffer;
+  std::atomic<uint64_t> m_buffered{0};
+  std::atomic<uint64_t> m_flushed{0};
+  // Only touched by the cyclic thread
+  uint64_t m_cycle{0};
+
+  // Only touched by the flusher thread
+  std::size_t m_file_index{0};
+  std::size_t m_frame_index{0};
+  uint64_t m_sequence{0};
+
+  std::atomic<uint64_t> m_frames_written{0};
+  std::atomic<uint64_t> m_frames_dropped{0};
+  std::atomic<uint64_t> m_rotations{0};
+  std::atomic<bool> m_stop{false};
+  std::thread m_flusher;
+};
+
+/**
+ * @brief CycleRecording - the frames of the ring files of one master in cycle order, for offline conversion
+ */
+class CycleRecording {
+ public:
+  /**
+   * @brief read - reads the files of one ring (any order)
+   * @throw std::runtime_error if a file cannot be read, is no cycle record, or the files belong to different recordings
+   */
+  static CycleRecording read(const std::vector<std::string>& paths);
+
+  /**
+   * @brief writeCsv - one row per cycle, one column per value: cycle, stamp [ns, monotonic], time [s, wall time], then
+   * <slave>/<value> for every recorded slave
+   */
+  void writeCsv(std::ostream& stream) const;
+
+  std::string ethercat_bus{};
+  int64_t realtime_offset{0};
+  std::vector<CycleRecordSlave> slaves{};
+  std::size_t frame_size{0};
+  // Frames in cycle order, frame_size bytes each
+  std::vector<char> frames{};
+
+  std::size_t numberOfFrames() const { return frame_size == 0 ? 0 : frames.size() / frame_size; }
+};
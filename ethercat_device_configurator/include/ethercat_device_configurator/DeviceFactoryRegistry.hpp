@@ -0,0 +1,173 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ethercat_device_configurator/EthercatDeviceConfigurator.hpp"
+#include "ethercat_device_configurator/SharedMemoryLayout.hpp"
+
+/**
+ * @brief DeviceFactoryRegistry - process wide map from the device type names used in the setup.yaml to factories creating the devices.
+ * Factories are registered statically (registerFactory / DeviceFactoryRegistration) or by plugins: if no factory is registered for a
+ * type, the plugin library pluginLibraryName(type) is loaded with dlopen the first time a device of that type is created, i.e. only the
+ * sdks used by the active setup are loaded. Plugins are searched in ETHERCAT_DEVICE_PLUGIN_PATH (':' separated), next to this library
+ * and in the default library search path. A plugin implements ETHERCAT_DEVICE_PLUGIN.
+ * All methods are thread safe.
+ */
+class DeviceFactoryRegistry {
+ public:
+  /**
+   * @param entry - parsed entry of the device
+   * @param configuration_file_path - absolute path of the configuration file, empty if the entry has no configuration file
+   */
+  typedef std::function<std::shared_ptr<ecat_master::EthercatDevice>(const EthercatDeviceConfigurator::EthercatSlaveEntry& entry,
+                                                                     const std::string& configuration_file_path)>
+      Factory;
+
+  // Drives the state machine of a drive type for EthercatDeviceConfigurator::setDriveStates
+  struct DriveStateHandler {
+    // Requests the target state without waiting for it, called from a user thread while the bus is cycling
+    std::function<void(ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target)> request;
+    // True once the drive is in the target state
+    std::function<bool(ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target)> reached;
+  };
+
+  // Converts the readings and commands of a device type from / to the fixed layouts of the shared memory export (SharedMemoryLayout.hpp)
+  struct ProcessDataAdapter {
+    SharedMemoryDataLayout reading_layout{SharedMemoryDataLayout::None};
+    SharedMemoryDataLayout command_layout{SharedMemoryDataLayout::None};
+    // Writes the current reading in reading_layout, called by the cyclic thread after the update
+    std::function<void(ecat_master::EthercatDevice& device, void* reading)> read;
+    // Stages a command given in command_layout, called by the cyclic thread before the update
+    std::function<void(ecat_master::EthercatDevice& device, const void* command)> stage;
+    // Optional: writes the staged command in command_layout, for the cycle recorder. Called by the cyclic thread after the update
+    std::function<void(ecat_master::EthercatDevice& device, void* command)> staged;
+  };
+
+  static DeviceFactoryRegistry& instance();
+
+  /**
+   * @brief registerFactory
+   * @throw std::runtime_error if a factory for the type is already registered
+   */
+  void registerFactory(const std::string& type_name, Factory factory);
+
+  /**
+   * @brief registerDriveStateHandler - registers the state machine handling of a drive type, usually next to its factory. The handler
+   * gets the devices created by the factory of the type.
+   * @throw std::runtime_error if a handler for the type is already registered
+   */
+  void registerDriveStateHandler(const std::string& type_name, DriveStateHandler handler);
+
+  /**
+   * @brief getDriveStateHandler - does not load plugins, the plugin of a type is loaded with its first device
+   * @return the handler of the type, std::nullopt if there is none
+   */
+  std::optional<DriveStateHandler> getDriveStateHandler(const std::string& type_name) const;
+
+  /**
+   * @brief registerProcessDataAdapter - registers the shared memory conversion of a device type, usually next to its factory
+   * @throw std::runtime_error if an adapter for the type is already registered, or read / stage is missing for a layout
+   */
+  void registerProcessDataAdapter(const std::string& type_name, ProcessDataAdapter adapter);
+
+  /**
+   * @brief getProcessDataAdapter - does not load plugins, like getDriveStateHandler
+   * @return the adapter of the type, std::nullopt if there is none
+   */
+  std::optional<ProcessDataAdapter> getProcessDataAdapter(const std::string& type_name) const;
+
+  /**
+   * @brief create - creates a device with the factory of entry.type_name, loads the plugin of the type if needed
+   * @throw std::runtime_error if there is no factory for the type, or what the factory throws
+   */
+  std::shared_ptr<ecat_master::EthercatDevice> create(const EthercatDeviceConfigurator::EthercatSlaveEntry& entry,
+                                                      const std::string& configuration_file_path);
+
+  /**
+   * @brief providesType - whether devices of the type can be created: a factory is registered for it, or its plugin can be loaded. Loads
+   * the plugin of the type like create.
+   */
+  bool providesType(const std::string& type_name);
+
+  /**
+   * @brief loadPlugin - loads a plugin library and registers its factories
+   * @param library - file name or path of the library
+   * @throw std::runtime_error if the library cannot be loaded or is no device plugin
+   */
+  void loadPlugin(const std::string& library);
+
+  /**
+   * @brief getRegisteredTypes - type names with a registered factory, does not include types of plugins which are not loaded yet
+   */
+  std::vector<std::string> getRegisteredTypes() const;
+
+  /**
+   * @brief pluginLibraryName - file name of the plugin providing a type: libethercat_device_configurator_<lower case type>_plugin.so
+   */
+  static std::string pluginLibraryName(const std::string& type_name);
+
+ private:
+  DeviceFactoryRegistry();
+
+  // Needs m_mutex, throws if the plugin cannot be loaded
+  void loadPluginLocked(const std::string& library);
+  // Needs m_mutex, loads the plugin of the type on first use. Returns m_factories.end() and the plugin error (if any) without factory.
+  std::unordered_map<std::string, Factory>::const_iterator findFactoryLocked(const std::string& type_name, std::string& error);
+
+  // Recursive: plugins register their factories while their loading holds the lock
+  mutable std::recursive_mutex m_mutex;
+  std::unordered_map<std::string, Factory> m_factories;
+  std::unordered_map<std::string, DriveStateHandler> m_drive_state_handlers;
+  std::unordered_map<std::string, ProcessDataAdapter> m_process_data_adapters;
+  // Types for which loading the plugin failed, with the error. Not retried for every device.
+  std::unordered_map<std::string, std::string> m_plugin_errors;
+  // Plugins are never unloaded, the created devices use their code
+  std::vector<void*> m_plugin_handles;
+};
+
+/**
+ * @brief DeviceFactoryRegistration - registers a factory during static initialization, e.g. for application specific devices:
+ *   static DeviceFactoryRegistration registration("MyDevice", [](const auto& entry, const std::string& path) { ... });
+ */
+struct DeviceFactoryRegistration {
+  DeviceFactoryRegistration(const std::string& type_name, DeviceFactoryRegistry::Factory factory) {
+    DeviceFactoryRegistry::instance().registerFactory(type_name, std::move(factory));
+  }
+};
+
+// Entry point of a device plugin, registers all factories (and drive state handlers, process data adapters) of the plugin
+#define ETHERCAT_DEVICE_PLUGIN_SYMBOL "registerEthercatDeviceFactories"
+#ifdef ETHERCAT_DEVICE_PLUGIN_BUILD
+#define ETHERCAT_DEVICE_PLUGIN(register_function) \
+  extern "C" void registerEthercatDeviceFactories(DeviceFactoryRegistry& registry) { register_function(registry); }
+#else
+#define ETHERCAT_DEVICE_PLUGIN(register_function)
+#endif
@@ -22,23 +22,83 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include "ethercat_device_configurator/CycleHistogram.hpp"
+#include "ethercat_device_configurator/ReadingDispatcher.hpp"
+#include "ethercat_device_configurator/RealtimeViolations.hpp"
+#include "ethercat_device_configurator/SlaveExchange.hpp"
+#include "ethercat_device_configurator/SlaveView.hpp"
+#include "ethercat_device_configurator/StartupProfile.hpp"
+#include "ethercat_device_configurator/VirtualBus.hpp"
 #include "ethercat_sdk_master/EthercatMaster.hpp"
 
 #include <xmlrpcpp/XmlRpc.h>
 
+// Forward declarations of the supported slave classes, used by EthercatSlaveTypeTrait. The sdks are optional dependencies.
+namespace elmo {
+class Elmo;
+}
+namespace mps_ethercat_sdk {
+class MPSDrive;
+}
+namespace maxon {
+class Maxon;
+}
+namespace anydrive_rsl {
+class AnydriveEthercatSlave;
+}
+namespace rokubimini {
+namespace ethercat {
+class RokubiminiEthercat;
+}
+}  // namespace rokubimini
+namespace beckhoff {
+namespace ek1100 {
+class EK1100;
+}
+namespace el3102 {
+class EL3102;
+}
+}  // namespace beckhoff
+class SharedMemoryExport;
+class JointStateSnapshot;
+
+/**
+ * @brief EthercatSlaveTypeTrait - maps a slave class to its EthercatDeviceConfigurator::EthercatSlaveType at compile time.
+ * Specialized below the EthercatDeviceConfigurator class for all supported slave classes, value is NA for all other classes.
+ */
+template <typename T>
+struct EthercatSlaveTypeTrait;
+
 class EthercatDeviceConfigurator {
  public:
   // Convinience typedef for a shared pointer
   typedef std::shared_ptr<EthercatDeviceConfigurator> SharedPtr;
 
-  // Type ethercat slave device. If you want to wire in a new slave device type, add an entry to this enum
-  enum class EthercatSlaveType { Elmo, MPSDrive, Maxon, Anydrive, Rokubi, EK1100, EL3102, NA };
+  // Dense index of a slave. Valid after setup, indexes getSlaves() and the parsed slave entries.
+  typedef std::size_t SlaveHandle;
+
+  // Type ethercat slave device. New device types only need a factory in the DeviceFactoryRegistry, their entries get the type NA.
+  // Add an entry to this enum (before NA) and specialize EthercatSlaveTypeTrait only if the type should be served by slavesOfType.
+  enum class EthercatSlaveType { Elmo, MPSDrive, Maxon, Anydrive, Rokubi, EK1100, EL3102, Virtual, NA };
+  static constexpr std::size_t numberOfSlaveTypes = static_cast<std::size_t>(EthercatSlaveType::NA) + 1;
 
   struct EthercatSlaveEntry {
     EthercatSlaveType type{EthercatSlaveType::Anydrive};
+    // Type as written in the setup, selects the device factory. type is NA for types only known to a registered factory or a plugin,
+    // the parsers reject types without factory
+    std::string type_name{};
     std::string name{};
     bool has_config_file{false};
     std::string config_file_path{};
@@ -48,6 +108,109 @@ class EthercatDeviceConfigurator {
     std::string ethercat_bus{};
     std::string ethercat_pdo_type{};
   };
+
+  // Configuration of the cyclic thread of a master, parsed from the ethercat_master_s entries
+  struct MasterRuntimeConfiguration {
+    // SCHED_FIFO priority of the cyclic thread. Do not set above 48, otherwise soem's kernel threads starve. 0: no realtime scheduling
+    int rt_priority{48};
+    // CPU core the cyclic thread is pinned to, -1: no pinning
+    int cpu_core{-1};
+    // The bus is a VirtualBus (loopback, only Virtual devices) instead of a network interface
+    bool is_virtual{false};
+    VirtualBus::Configuration virtual_bus{};
+  };
+
+  // All durations in nanoseconds
+  struct CycleTiming {
+    // Time between two consecutive wake-ups of the cyclic thread
+    CycleHistogram period;
+    // Duration of update() and the cycle callbacks
+    CycleHistogram execution;
+    // Delay between the scheduled and the actual wake-up
+    CycleHistogram wakeup_latency;
+    // Cycles which ended after the next scheduled wake-up
+    std::atomic<uint64_t> overruns{0};
+    // time_step of the master
+    int64_t nominal_period{0};
+
+    /**
+     * @brief maxOverrun - largest amount by which a period exceeded the nominal period, 0 if none did
+     */
+    int64_t maxOverrun() const { return period.max() > nominal_period ? period.max() - nominal_period : 0; }
+    void reset() {
+      period.reset();
+      execution.reset();
+      wakeup_latency.reset();
+      overruns.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  struct MasterStartupReport {
+    std::string name{};
+    std::string ethercat_bus{};
+    bool success{false};
+    // Exception message or reason of the failed startup, empty on success
+    std::string error{};
+    // Duration of master->startup in seconds
+    double duration{0.0};
+  };
+
+  struct ValidationReport {
+    // All errors of the setup, empty if it is valid
+    std::vector<std::string> errors{};
+    // Number of devices which passed all checks
+    std::size_t valid_devices{0};
+    // Duration of the validation in seconds
+    double duration{0.0};
+    bool valid() const { return errors.empty(); }
+  };
+
+  struct MasterShutdownReport {
+    std::string name{};
+    std::string ethercat_bus{};
+    // False if the bus was not shut down before the deadline, it keeps shutting down in the background
+    bool success{false};
+    std::string error{};
+    // Seconds from shutdownAsync to the completion (or the deadline)
+    double duration{0.0};
+  };
+
+  // Target state of a group drive transition, mapped to the state machine of every drive type by its drive state handler
+  enum class DriveTarget {
+    // Elmo, Maxon, MPSDrive: OperationEnabled. Anydrive: ControlOp
+    Operational,
+    // Elmo, Maxon, MPSDrive: SwitchOnDisabled. Anydrive: Standby
+    Disabled
+  };
+
+  // One drive of a group transition, see transitionDrives
+  struct DriveTransition {
+    std::shared_ptr<ecat_master::EthercatDevice> drive{};
+    // Requests the target state without waiting for it
+    std::function<void()> request{};
+    // True once the drive is in the target state, polled by the calling thread
+    std::function<bool()> reached{};
+  };
+
+  struct DriveTransitionResult {
+    std::string name{};
+    SlaveHandle handle{0};
+    bool success{false};
+    // Time from the request until the target state was observed, or until the deadline, in seconds
+    double duration{0.0};
+    // Exception message of the request or reason of the failure, empty on success
+    std::string error{};
+  };
+
+  // Outcome of applyConfiguration, bus names (network interfaces)
+  struct ReconfigurationReport {
+    // Kept running, their masters, slaves and cycle callbacks are untouched
+    std::vector<std::string> unchanged_buses{};
+    // Master or slave entries changed, shut down and rebuilt
+    std::vector<std::string> restarted_buses{};
+    std::vector<std::string> added_buses{};
+    std::vector<std::string> removed_buses{};
+  };
   /**
    * @brief EthercatDeviceConfigurator
    * @param path - path to the setup.yaml
@@ -55,6 +218,10 @@ class EthercatDeviceConfigurator {
    */
   EthercatDeviceConfigurator() = default;
   explicit EthercatDeviceConfigurator(std::string path, bool startup = false);
+  /**
+   * @brief ~EthercatDeviceConfigurator - stops the runtime if it is running
+   */
+  ~EthercatDeviceConfigurator();
 
   /**
    * @brief initialize
@@ -66,32 +233,324 @@ class EthercatDeviceConfigurator {
    * @param params - params with the slave informations
    */
   void initializeFromParameters(XmlRpc::XmlRpcValue& params, bool startup = false);
+  /**
+   * @brief initializeFromSnapshot - initialize from a snapshot written by compileSetupSnapshot, skips all yaml parsing.
+   * Falls back to initializeFromFile with the setup.yaml the snapshot was compiled from if any source file changed since.
+   * @param snapshot_path - path to the snapshot
+   * @throw std::runtime_error if the snapshot cannot be read
+   */
+  void initializeFromSnapshot(const std::string& snapshot_path, bool startup = false);
+  /**
+   * @brief compileSetupSnapshot - parses a setup.yaml, resolves and checks all referenced configuration files and writes a snapshot
+   * @param setup_file_path - path to the setup.yaml
+   * @param snapshot_path - output path
+   */
+  static void compileSetupSnapshot(const std::string& setup_file_path, const std::string& snapshot_path);
+  /**
+   * @brief validateSetupFile - preflight check of a setup.yaml without touching any bus. Runs the checks of the parsing, resolves the
+   * configuration file of every device and creates all devices with their sdk (parsing their configuration files).
+   * @param setup_file_path - path to the setup.yaml
+   * @param threads - threads creating the devices, 1 (default): serially, 0: hardware concurrency. See setMaxConstructionThreads
+   * @return every error found, does not throw
+   */
+  static ValidationReport validateSetupFile(const std::string& setup_file_path, unsigned int threads = 1);
+  /**
+   * @brief validateParameters - validateSetupFile for a setup given as parameters
+   */
+  static ValidationReport validateParameters(XmlRpc::XmlRpcValue& params, unsigned int threads = 1);
+  /**
+   * @brief applyConfiguration - applies a changed setup.yaml to an initialized configurator without a full rediscovery.
+   * The new master and slave entries are compared per bus with the current ones (master and runtime configuration, the ordered slave
+   * entries and the content of their configuration files). Only buses which changed are shut down, rebuilt and started again, added buses
+   * are created and removed buses shut down. The cyclic threads of unchanged buses keep running if the runtime is running.
+   * @note Master indices and slave handles are invalidated, query them again afterwards. Slaves and cycle callbacks (e.g. slave
+   * exchanges) of restarted buses are dropped, as are the CycleTiming references (getCycleTiming) of restarted and removed buses.
+   * Joint state snapshots and shared memory exports index all slaves by handle: if the handles or master indices change, they are
+   * detached before the new configuration is swapped in (see JointStateSnapshot::isAttached, the clients of the export see it inactive),
+   * create them again. Slave exchanges, reading callbacks and cycle recorders of unchanged buses keep running.
+   * Cycle callbacks must not use the lookups of the configurator while the configuration is applied.
+   * Not thread safe with respect to the other methods of the configurator.
+   * @param path - path to the new setup.yaml
+   * @param startup - call startup on the restarted and added buses, their cyclic threads are started if the runtime is running
+   * @return the buses per outcome
+   * @throw std::runtime_error if the new setup is invalid or a slave or master cannot be created or attached, the current configuration
+   * is kept in this case. If a restarted bus fails to start up, the new configuration is applied and the failed buses are listed.
+   */
+  ReconfigurationReport applyConfiguration(const std::string& path, bool startup = true);
+  /**
+   * @brief startupMasters - calls startup on all masters with the startup abort flag
+   * @param parallel - true: starts all buses concurrently, one thread per bus. false: one bus after the other.
+   * @return one report per master, same order as getMasters. Does not throw if a master fails, check the reports.
+   */
+  std::vector<MasterStartupReport> startupMasters(bool parallel);
+  /**
+   * @brief startupAsync - starts up all masters concurrently (one thread per bus) with the startup abort flag and returns immediately.
+   * The startup of a bus begins after a pending startupAsync / shutdownAsync of the same bus finished. startRuntime, stopRuntime,
+   * applyConfiguration and the destructor wait for the pending startups, use abortStartup to cut them short.
+   * @return one future per master, indexed like getMasters, ready when the startup of its bus finished
+   */
+  std::vector<std::future<MasterStartupReport>> startupAsync();
+  /**
+   * @brief shutdownAsync - shuts down all masters concurrently (one thread per bus) and returns immediately. A cycling bus is put into
+   * SAFE_OP with preShutdown(true) before its cyclic thread is stopped. The runtime stops (isRuntimeRunning) with the last bus.
+   * @param timeout - hard deadline in seconds: the futures of the buses which are not shut down by then become ready with success false,
+   * these buses finish shutting down in the background (waited for by startRuntime, stopRuntime, applyConfiguration and the destructor)
+   * @return one future per master, indexed like getMasters
+   */
+  std::vector<std::future<MasterShutdownReport>> shutdownAsync(double timeout);
+  /**
+   * @brief getStartupProfile - timing tree of the last initialization (initializeFrom*, constructor, applyConfiguration): parsing, per
+   * slave creation (configuration file resolution, deviceFromFile), master creation and slave attachment per bus, startup per bus.
+   * startupMasters calls after the initialization are appended.
+   */
+  StartupProfile getStartupProfile() const;
+  /**
+   * @brief setStartupProfilePath - writes the startup profile as json to the file after every initialization and startupMasters call.
+   * Defaults to the environment variable ETHERCAT_STARTUP_PROFILE, empty: not written.
+   */
+  void setStartupProfilePath(const std::string& path);
+  /**
+   * @brief setParallelStartup - if true, setup starts all masters concurrently (one thread per bus). Default false.
+   * Has to be called before initializeFromFile / initializeFromParameters.
+   */
+  void setParallelStartup(bool parallel);
+  /**
+   * @brief setMaxConstructionThreads - number of threads used by setup to create the slaves (parse their configuration files).
+   * 1 (default): create the slaves on the calling thread, 0: std::thread::hardware_concurrency. Only use more than one thread if the
+   * device factories of all types in the setup (sdk parsing, logging) are thread safe.
+   * Has to be called before initializeFromFile / initializeFromParameters.
+   */
+  void setMaxConstructionThreads(unsigned int threads);
+  /**
+   * @brief abortStartup - sets the startup abort flag, a running startup of the masters aborts cooperatively.
+   * The flag stays set, subsequent startups abort as well, startRuntime does not start the runtime.
+   */
+  void abortStartup();
+  /**
+   * @brief isStartupAborted - true once abortStartup was called
+   */
+  bool isStartupAborted() const;
+  /**
+   * @brief startRuntime - starts one cyclic thread per master, with priority and cpu affinity from the master's runtime configuration.
+   * Each thread calls activate() on its master and then update() every time_step, timed by the thread itself (absolute clock, no drift).
+   * Only the masters started up by the configurator (startupMasters, startupAsync, initialization with startup) are cycled.
+   * Safe to call concurrently with shutdownAsync, e.g. from a startup thread while the main thread shuts down.
+   * @return false if the runtime was not started because the startup was aborted (abortStartup) or a shutdownAsync was requested
+   * after the last startup
+   * @throw std::runtime_error if the runtime is already running
+   */
+  bool startRuntime();
+  /**
+   * @brief stopRuntime - calls preShutdown(true) on all masters while the cyclic threads still run (bus goes to SAFE_OP), then stops the
+   * threads, which call deactivate() on their master.
+   * @param shutdown - also call shutdown() on all started masters after the threads are joined, also if the runtime is not running
+   * (e.g. masters started up by startupAsync)
+   */
+  void stopRuntime(bool shutdown = true);
+  /**
+   * @brief isRuntimeRunning
+   */
+  bool isRuntimeRunning() const;
+  /**
+   * @brief addCycleCallback - callback called by the cyclic thread of a master after every update. Must not block.
+   * @param master_index - index in getMasters
+   * @throw std::runtime_error if the runtime is running
+   */
+  void addCycleCallback(std::size_t master_index, std::function<void()> callback);
+  /**
+   * @brief addSlaveExchange - creates a wait-free command/reading exchange for a slave, serviced by the cyclic thread of its master
+   * after every update. Use it instead of calling stageCommand / getReading of the slave from user threads.
+   * @tparam Command - command type of the slave, e.g. elmo::Command
+   * @param slave
+   * @throw std::runtime_error if the runtime is running
+   */
+  template <typename Command, typename Device>
+  std::shared_ptr<SlaveExchange<Device, Command>> addSlaveExchange(const std::shared_ptr<Device>& slave) {
+    static_assert(std::is_base_of_v<ecat_master::EthercatDevice, Device>, "addSlaveExchange: Device has to be an EthercatDevice");
+    auto exchange = std::make_shared<SlaveExchange<Device, Command>>(slave);
+    addCycleCallback(getMasterIndex(getSlaveHandle(slave)), [exchange]() { exchange->cycle(); });
+    return exchange;
+  }
+  /**
+   * @brief addAsyncReadingCallback - calls the callback with every reading of the slave on a worker of the reading dispatcher instead of
+   * the cyclic thread, the callback may block. The cyclic thread of the slave's master only copies the reading into a pre-allocated slot
+   * of the slave's queue after every update, in place with getReading(Reading&) if the slave has it (see DeviceReading). The dispatcher
+   * runs while the runtime is running.
+   * @param callback - void(const std::string& name, const Reading& reading), the signature of the sdk reading callbacks
+   * @return the channel of the slave, e.g. for the number of dropped readings
+   * @throw std::runtime_error if the runtime is running
+   */
+  template <typename Device, typename Reading = typename DeviceReading<Device>::Reading>
+  std::shared_ptr<ReadingChannel<Reading>> addAsyncReadingCallback(const std::shared_ptr<Device>& slave,
+                                                                   typename ReadingChannel<Reading>::Callback callback) {
+    static_assert(std::is_base_of_v<ecat_master::EthercatDevice, Device>, "addAsyncReadingCallback: Device has to be an EthercatDevice");
+    static_assert(std::is_same_v<Reading, typename DeviceReading<Device>::Reading>, "addAsyncReadingCallback: Reading of the slave");
+    if (m_runtime_running) throw std::runtime_error("[EthercatDeviceConfigurator] Reading callbacks can only be added while not running");
+    auto channel = getReadingDispatcher().addChannel<Reading>(slave->getName(), std::move(callback));
+    addCycleCallback(getMasterIndex(getSlaveHandle(slave)), [slave, channel]() {
+      channel->produce([&slave](Reading& reading) { DeviceReading<Device>::copy(*slave, reading); });
+    });
+    return channel;
+  }
+  /**
+   * @brief setReadingDispatcherConfiguration - worker threads, queue capacity and overflow policy of the reading dispatcher.
+   * Has to be called before the first addAsyncReadingCallback.
+   * @throw std::runtime_error if the dispatcher has channels already
+   */
+  void setReadingDispatcherConfiguration(const ReadingDispatcher::Configuration& configuration);
+  /**
+   * @brief getReadingDispatcher - dispatcher of the asynchronous reading callbacks, started and stopped with the runtime. Channels can
+   * also be fed from sdk reading callbacks, start and stop the dispatcher yourself if the runtime is not used.
+   */
+  ReadingDispatcher& getReadingDispatcher();
+  /**
+   * @brief exportSharedMemory - publishes the readings of all slaves after every update in a POSIX shared memory segment and stages the
+   * commands written to it by other processes (SharedMemoryClient), so that they do not need to link the sdks. The layout is generated
+   * from the slave entries, in the order of the slave handles. Types without a process data adapter (DeviceFactoryRegistry) are listed
+   * without reading and command. Serviced by the cyclic threads, the segment is removed when the export is destroyed.
+   * @param name - shm_open name, e.g. "/ethercat_device_configurator"
+   * @throw std::runtime_error if the runtime is running or the segment cannot be created
+   */
+  std::shared_ptr<SharedMemoryExport> exportSharedMemory(const std::string& name);
+  /**
+   * @brief addJointStateSnapshot - gathers the readings of all slaves into structure of arrays indexed by slave handle at the end of every
+   * cycle, and scatters the commands given the same way. Serviced by the cyclic threads, see JointStateSnapshot.
+   * @throw std::runtime_error if the runtime is running
+   */
+  std::shared_ptr<JointStateSnapshot> addJointStateSnapshot();
+  /**
+   * @brief setDriveStates - requests the target state on all selected drives at once and waits for all of them with one shared deadline,
+   * instead of a blocking transition per drive. The buses have to be cycling (startRuntime or an own update loop).
+   * The state machines are driven by the drive state handlers registered with the device factories (DeviceFactoryRegistry).
+   * @param target
+   * @param types - type names as in the setup.yaml, empty: all types which have a drive state handler
+   * @param buses - ethercat bus names, empty: all buses
+   * @param timeout - shared deadline for all drives in seconds
+   * @return one result per drive, in handle order
+   * @throw std::runtime_error if one of the given types has no drive state handler
+   */
+  std::vector<DriveTransitionResult> setDriveStates(DriveTarget target, const std::vector<std::string>& types = {},
+                                                    const std::vector<std::string>& buses = {}, double timeout = 10.0) const;
+  /**
+   * @brief transitionDrives - requests all transitions, then polls all drives until they reached their state or the shared deadline passed
+   * @param transitions - the drives have to be slaves of this configurator
+   * @param timeout - shared deadline for all drives in seconds
+   * @return one result per transition, same order
+   */
+  std::vector<DriveTransitionResult> transitionDrives(const std::vector<DriveTransition>& transitions, double timeout) const;
+  /**
+   * @brief transitionDrives - group transition for drives of one sdk type, e.g.
+   *   transitionDrives(elmos, [](elmo::Elmo& elmo) { elmo.setDriveStateViaPdo(elmo::DriveState::OperationEnabled, false); },
+   *                    [](elmo::Elmo& elmo) { return elmo.getReading().getDriveState() == elmo::DriveState::OperationEnabled; }, 5.0);
+   * @param request - void(Device&), must not block
+   * @param reached - bool(Device&)
+   */
+  template <typename Device, typename Request, typename Reached>
+  std::vector<DriveTransitionResult> transitionDrives(const std::vector<std::shared_ptr<Device>>& drives, Request request, Reached reached,
+                                                      double timeout) const {
+    static_assert(std::is_base_of_v<ecat_master::EthercatDevice, Device>, "transitionDrives: Device has to be an EthercatDevice");
+    std::vector<DriveTransition> transitions;
+    transitions.reserve(drives.size());
+    for (const auto& drive : drives) {
+      transitions.push_back({drive, [drive, request]() { request(*drive); }, [drive, reached]() { return reached(*drive); }});
+    }
+    return transitionDrives(transitions, timeout);
+  }
+  /**
+   * @brief getMasterIndex - index of the master of a slave in getMasters
+   * @param handle - handle of the slave
+   */
+  std::size_t getMasterIndex(SlaveHandle handle) const;
+  /**
+   * @brief getVirtualBus
+   * @param master_index - index in getMasters
+   * @return the virtual bus which replaces the master, nullptr if the master drives a real bus. Virtual buses have no master, their
+   * entry in getMasters is nullptr.
+   */
+  const std::shared_ptr<VirtualBus>& getVirtualBus(std::size_t master_index) const;
+  /**
+   * @brief getCycleTiming - timing distributions of the cyclic thread of a master, recorded every cycle while the runtime is running.
+   * Can be read (and reset) from any thread, also while the runtime is running.
+   * @note The reference is invalidated if applyConfiguration restarts or removes the bus.
+   * @param master_index - index in getMasters
+   */
+  CycleTiming& getCycleTiming(std::size_t master_index);
+  const CycleTiming& getCycleTiming(std::size_t master_index) const;
+  /**
+   * @brief resetCycleTiming - resets the cycle timing of all masters
+   */
+  void resetCycleTiming();
+  /**
+   * @brief getRealtimeViolations - allocations, lock waits and blocking calls in update() and the cycle callbacks of a master, counted
+   * while the runtime is running if the realtime detector is preloaded (see RealtimeSection::detectorLoaded). All 0 on a clean cycle.
+   * @param master_index - index in getMasters
+   */
+  const RealtimeViolations& getRealtimeViolations(std::size_t master_index) const;
+  /**
+   * @brief resetRealtimeViolations - resets the realtime violations of all masters, e.g. after the first cycles which may allocate
+   */
+  void resetRealtimeViolations();
+  /**
+   * @brief getMasterRuntimeConfiguration
+   * @param master_index - index in getMasters
+   */
+  const MasterRuntimeConfiguration& getMasterRuntimeConfiguration(std::size_t master_index) const;
   /**
    * @brief getMasters
-   * @return a vector of all masters
+   * @return a view on all masters, nullptr for virtual buses (see getVirtualBus). Does not allocate or touch reference counts, can be
+   * called from the cyclic thread.
    */
-  std::vector<std::shared_ptr<ecat_master::EthercatMaster>> getMasters();
+  const std::vector<std::shared_ptr<ecat_master::EthercatMaster>>& getMasters() const;
   /**
    * @brief getSlaves
-   * @return a vector of all slaves
+   * @return a view on all slaves. Does not allocate or touch reference counts, can be called from the cyclic thread.
    */
-  std::vector<std::shared_ptr<ecat_master::EthercatDevice>> getSlaves();
+  const std::vector<std::shared_ptr<ecat_master::EthercatDevice>>& getSlaves() const;
   /**
-   * @brief getSlave - get a certain slave by its name
+   * @brief getSlave - get a certain slave by its name. O(1) hash lookup, allocation free on success
    * @param name
    * @return shared_ptr on slave
+   * @throw std::runtime_error if no slave with this name exists
    */
-  std::shared_ptr<ecat_master::EthercatDevice> getSlave(std::string name);
+  const std::shared_ptr<ecat_master::EthercatDevice>& getSlave(std::string_view name) const;
   /**
-   * @brief getInfoForSlave
+   * @brief tryGetSlave - get a certain slave by its name. O(1) hash lookup, allocation free, does not throw
+   * @param name
+   * @return shared_ptr on slave, nullptr if no slave with this name exists
+   */
+  std::shared_ptr<ecat_master::EthercatDevice> tryGetSlave(std::string_view name) const noexcept;
+  /**
+   * @brief getSlaveByHandle - get a certain slave by its handle
+   * @param handle
+   * @return shared_ptr on slave
+   * @throw std::out_of_range if the handle is invalid
+   */
+  const std::shared_ptr<ecat_master::EthercatDevice>& getSlaveByHandle(SlaveHandle handle) const;
+  /**
+   * @brief getSlaveHandle - O(1), allocation free
+   * @param slave - shared ptr on slave
+   * @return handle of the slave
+   * @throw std::out_of_range if the slave was not created by this configurator
+   */
+  SlaveHandle getSlaveHandle(const std::shared_ptr<ecat_master::EthercatDevice>& slave) const;
+  /**
+   * @brief getInfoForSlave - O(1), allocation free
    * @param slave - shared ptr on slave
    * @return Info entry parsed from setup.yaml
+   * @throw std::out_of_range if the slave was not created by this configurator
    */
-  const EthercatSlaveEntry& getInfoForSlave(const std::shared_ptr<ecat_master::EthercatDevice>& slave);
+  const EthercatSlaveEntry& getInfoForSlave(const std::shared_ptr<ecat_master::EthercatDevice>& slave) const;
+  /**
+   * @brief getInfoForSlave
+   * @param handle - handle of the slave
+   * @return Info entry parsed from setup.yaml
+   * @throw std::out_of_range if the handle is invalid
+   */
+  const EthercatSlaveEntry& getInfoForSlave(SlaveHandle handle) const;
   /**
    * @brief master
    * @return pointer on master if only a single master is available
-   * @throw std::runtime_error if more than one master is configured
+   * @throw std::runtime_error if more than one master is configured or the bus is virtual
    */
   std::shared_ptr<ecat_master::EthercatMaster> master();
 
@@ -102,16 +561,55 @@ class EthercatDeviceConfigurator {
   const std::string& getSetupFilePath();
 
   /**
-   * @brief getSlavesOfType - return all slaves of type T (vector of shared_ptr).
+   * @brief slavesOfType - view on all slaves of type T in setup.yaml order. T has to be mapped to an EthercatSlaveType by
+   * EthercatSlaveTypeTrait.
+   * @note Served from an index built during setup: no RTTI, no allocation, no scan. Can be called from the cyclic thread.
+   */
+  template <typename T>
+  SlaveView<T> slavesOfType() const {
+    static_assert(EthercatSlaveTypeTrait<T>::value != EthercatSlaveType::NA, "slavesOfType: no EthercatSlaveTypeTrait for this type");
+    const auto& typed = m_typed_slaves[static_cast<std::size_t>(EthercatSlaveTypeTrait<T>::value)];
+    return SlaveView<T>(typed.data(), typed.data() + typed.size());
+  }
+
+  /**
+   * @brief slavesOfTypeOnBus - view on all slaves of type T on Busname in setup.yaml order. T has to be mapped to an EthercatSlaveType by
+   * EthercatSlaveTypeTrait.
+   * @note Served from an index built during setup: no RTTI, no allocation, no scan. Can be called from the cyclic thread.
+   * @return empty view if the bus is unknown
+   */
+  template <typename T>
+  SlaveView<T> slavesOfTypeOnBus(const std::string& busName) const {
+    static_assert(EthercatSlaveTypeTrait<T>::value != EthercatSlaveType::NA,
+                  "slavesOfTypeOnBus: no EthercatSlaveTypeTrait for this type");
+    const std::size_t typeIndex = static_cast<std::size_t>(EthercatSlaveTypeTrait<T>::value);
+    auto busIt = m_bus_indices.find(busName);
+    if (busIt == m_bus_indices.end()) return SlaveView<T>();
+    const auto& typed = m_typed_bus_slaves[typeIndex];
+    const auto& offsets = m_typed_bus_offsets[typeIndex];
+    return SlaveView<T>(typed.data() + offsets[busIt->second], typed.data() + offsets[busIt->second + 1]);
+  }
+
+  /**
+   * @brief getSlavesOfType - return all slaves of type T (vector of shared_ptr) in setup.yaml order.
    * @parm ethercatSlaveType TypeEnum to reduce number of dynamic_casts.
-   * @note Warning cache the result if you need them on a regular base. Might have bad performance
+   * @note Copies from the type index. Prefer slavesOfType if you need them on a regular base.
    */
   template <typename T, typename dummy = std::enable_if_t<std::is_base_of_v<ecat_master::EthercatDevice, T>>>
   std::vector<std::shared_ptr<T>> getSlavesOfType(EthercatSlaveType ethercatSlaveType) {
     std::vector<std::shared_ptr<T>> slaves;
+    if (ethercatSlaveType == EthercatSlaveType::NA) return slaves;
 
-    for (auto& slave : m_slaves) {
-      if (getInfoForSlave(slave).type == ethercatSlaveType) {  // we do not have to do dynamic cast for all slaves..
+    const auto& typed = m_typed_slaves[static_cast<std::size_t>(ethercatSlaveType)];
+    slaves.reserve(typed.size());
+    for (const auto& slave : typed) {
+      if constexpr (EthercatSlaveTypeTrait<T>::value != EthercatSlaveType::NA) {
+        // the type is known at compile time, no dynamic cast needed.
+        if (EthercatSlaveTypeTrait<T>::value != ethercatSlaveType) {
+          throw std::runtime_error("getSlavesOfType: ethercatSlaveTyp and provided Type does not match!");
+        }
+        slaves.push_back(std::static_pointer_cast<T>(slave));
+      } else {
         auto ptr = std::dynamic_pointer_cast<T>(slave);
         if (ptr) {
           slaves.push_back(ptr);
@@ -126,15 +624,24 @@ class EthercatDeviceConfigurator {
 
   /**
    * @brief getSlavesOfTypeOnBus - return all slaves of type T on Busname (vector of shared_ptr).
-   * @note Warning cache the result if you need them on a regular base! Might have bad performance
+   * @note Copies from the type index if T is mapped by EthercatSlaveTypeTrait, otherwise dynamic_casts the slaves of the bus. Prefer
+   * slavesOfTypeOnBus if you need them on a regular base.
    */
   template <typename T, typename dummy = std::enable_if_t<std::is_base_of_v<ecat_master::EthercatDevice, T>>>
   std::vector<std::shared_ptr<T>> getSlavesOfTypeOnBus(const std::string& busName) {
     std::vector<std::shared_ptr<T>> slaves;
 
-    for (auto& slave : m_slaves) {
-      if (getInfoForSlave(slave).ethercat_bus == busName) {
-        auto ptr = std::dynamic_pointer_cast<T>(slave);  // RTTI, for every slave on bus..
+    if constexpr (EthercatSlaveTypeTrait<T>::value != EthercatSlaveType::NA) {
+      auto view = slavesOfTypeOnBus<T>(busName);
+      slaves.reserve(view.size());
+      for (std::size_t i = 0; i < view.size(); i++) {
+        slaves.push_back(view.shared(i));
+      }
+    } else {
+      auto busIt = m_bus_indices.find(busName);
+      if (busIt == m_bus_indices.end()) return slaves;
+      for (const auto& slave : m_bus_slaves[busIt->second]) {
+        auto ptr = std::dynamic_pointer_cast<T>(slave);  // RTTI, only for the slaves on this bus.
         if (ptr) {
           slaves.push_back(ptr);
         }
@@ -146,43 +653,238 @@ class EthercatDeviceConfigurator {
  private:
   // Stores the general master configuration.
   std::vector<ecat_master::EthercatMasterConfiguration> m_master_configurations;
-  // Vector of all configured masters
+  // Stores the cyclic thread configuration of the masters, indexed like m_master_configurations
+  std::vector<MasterRuntimeConfiguration> m_master_runtime_configurations;
+  // Vector of all configured masters, nullptr for virtual buses
   std::vector<std::shared_ptr<ecat_master::EthercatMaster>> m_masters;
-  // Vecotr of all configured slaves (For all masters)
+  // Vecotr of all configured slaves (For all masters), indexed by SlaveHandle
   std::vector<std::shared_ptr<ecat_master::EthercatDevice>> m_slaves;
 
-  // List of all parsed slave entries from the setup.yaml
+  // List of all parsed slave entries from the setup.yaml, indexed by SlaveHandle
   std::vector<EthercatSlaveEntry> m_slave_entries;
-  // Map that helps finding the right slave entry for a certain slave
-  std::map<std::shared_ptr<ecat_master::EthercatDevice>, EthercatSlaveEntry> m_slave_to_entry_map;
+  // Modification time of the configuration file of every slave at creation, 0 if it has none or it is unknown. Indexed by SlaveHandle
+  std::vector<int64_t> m_slave_configuration_times;
+  // Content hash of the configuration file of every slave at creation, 0 if it has none, std::nullopt if it was modified after the
+  // creation. Computed by the first applyConfiguration, empty before. Indexed by SlaveHandle
+  std::vector<std::optional<uint64_t>> m_slave_configuration_hashes;
+  // Map that helps finding the handle (and therefore the slave entry) for a certain slave
+  std::unordered_map<const ecat_master::EthercatDevice*, SlaveHandle> m_slave_handles;
+
+  // Slave name to handle. The keys view the names in m_slave_entries, therefore rebuilt whenever m_slave_entries changes
+  std::unordered_map<std::string_view, SlaveHandle> m_slave_name_indices;
+  // Bus (network interface) name to index in m_masters / m_master_configurations
+  std::unordered_map<std::string, std::size_t> m_bus_indices;
+  // All slaves per bus, indexed like m_masters
+  std::vector<std::vector<std::shared_ptr<ecat_master::EthercatDevice>>> m_bus_slaves;
+  // All slaves per EthercatSlaveType in setup order
+  std::array<std::vector<std::shared_ptr<ecat_master::EthercatDevice>>, numberOfSlaveTypes> m_typed_slaves;
+  // All slaves per EthercatSlaveType, sorted by bus and in setup order within a bus. Together with m_typed_bus_offsets this is the
+  // (type, bus) index
+  std::array<std::vector<std::shared_ptr<ecat_master::EthercatDevice>>, numberOfSlaveTypes> m_typed_bus_slaves;
+  // Per EthercatSlaveType: slaves of bus i are m_typed_bus_slaves[type][offsets[i], offsets[i+1])
+  std::array<std::vector<std::size_t>, numberOfSlaveTypes> m_typed_bus_offsets;
 
   /*Internal methods*/
 
+ protected:
   /**
    * @brief parseFile - parses a setup.yaml. This methods adds the found entries in the m_slave_entries list and sets the
    * m_master_configuration (without the bus interface)
    * @param path
+   * @param errors - if given, errors are collected and the parsing continues, masters and devices with errors are skipped
    */
-  void parseFile(std::string path);
+  void parseFile(std::string path, std::vector<std::string>* errors = nullptr);
   /**
    * @brief parseRosParameterServer - parses the parameters. This methods adds the found entries in the m_slave_entries list and sets the
    * m_master_configuration (without the bus interface)
    * @param path
+   * @param errors - see parseFile
+   */
+  void parseParameter(XmlRpc::XmlRpcValue& params, std::vector<std::string>* errors = nullptr);
+  /**
+   * @brief checkUniqueness - checks that the interfaces of the masters, the names of the slaves and the (bus, address) pairs of the slaves
+   * are unique. Called by parseFile and parseParameter.
+   * @param errors - see parseFile
    */
-  void parseParameter(XmlRpc::XmlRpcValue& params);
+  void checkUniqueness(std::vector<std::string>* errors = nullptr) const;
   /**
    * @brief setup - uses the m_slave_entries to create slaves and bus masters. Attaches the slaves to the bus master. Can startup the bus
    * @param startup - true: call startup for all busses
    */
   void setup(bool startup);
+
+ private:
+  struct MasterRuntime;
+  /**
+   * @brief createSlave - creates the slave of an entry with the factory of its type (DeviceFactoryRegistry). Thread safe.
+   * @param entry
+   * @return slave
+   */
+  std::shared_ptr<ecat_master::EthercatDevice> createSlave(const EthercatSlaveEntry& entry) const;
+  /**
+   * @brief createSlaves - creates the slaves of some entries on a bounded pool of threads (m_construction_threads)
+   * @param entries
+   * @param handles - indices of the entries to create
+   * @param errors - if given, an error per slave which could not be created is added instead of throwing
+   * @return slaves indexed like entries, nullptr for the entries not in handles
+   * @throw std::runtime_error listing all slaves which could not be created
+   */
+  std::vector<std::shared_ptr<ecat_master::EthercatDevice>> createSlaves(const std::vector<EthercatSlaveEntry>& entries,
+                                                                         const std::vector<SlaveHandle>& handles,
+                                                                         std::vector<std::string>* errors = nullptr) const;
+  /**
+   * @brief validateEntries - checks the parsed entries without touching any bus: each device needs a master on its bus (a virtual bus
+   * for Virtual devices) and is created with its sdk, which parses its configuration file
+   * @param errors - all found errors are added
+   */
+  void validateEntries(std::vector<std::string>& errors) const;
+  /**
+   * @brief createMaster - creates the master (and virtual bus) of a master configuration and its runtime
+   */
+  std::unique_ptr<MasterRuntime> createMaster(const ecat_master::EthercatMasterConfiguration& master_configuration,
+                                              const MasterRuntimeConfiguration& runtime_configuration) const;
+  /**
+   * @brief attachSlave - attaches a slave to the master or virtual bus of the runtime of its bus
+   * @throw std::runtime_error if the bus does not suit the slave or the master refuses it
+   */
+  void attachSlave(const std::shared_ptr<ecat_master::EthercatDevice>& slave, const EthercatSlaveEntry& entry,
+                   MasterRuntime& runtime) const;
+  /**
+   * @brief startupMasters - startupMasters for a subset of the masters
+   * @param master_indices - indices in getMasters
+   * @return one report per index
+   */
+  std::vector<MasterStartupReport> startupMasters(const std::vector<std::size_t>& master_indices, bool parallel);
+  /**
+   * @brief startupMaster - starts up one master, thread safe for different masters
+   * @param parent - profiler phase of the startup of the bus
+   */
+  MasterStartupReport startupMaster(std::size_t master_index, StartupProfiler::PhaseId parent);
+  /**
+   * @brief joinLifecycleThreads - waits for the pending startupAsync / shutdownAsync calls, m_lifecycle_mutex has to be locked
+   */
+  void joinLifecycleThreads();
+  /**
+   * @brief startMasterRuntime - starts the cyclic thread of a master
+   */
+  static void startMasterRuntime(MasterRuntime& runtime);
+  /**
+   * @brief shutdownMaster - stops the cyclic thread of a master (preShutdown first) and shuts the master down if it was started
+   */
+  static void shutdownMaster(MasterRuntime& runtime);
+  /**
+   * @brief runMaster - cyclic loop of a master, executed by its runtime thread. Only uses the runtime, the vectors of the configurator
+   * can be rebuilt by applyConfiguration while it runs.
+   */
+  static void runMaster(MasterRuntime& runtime);
+  /**
+   * @brief buildSlaveIndices - builds the name, per bus and per (type, bus) slave indices. Called at the end of setup
+   */
+  void buildSlaveIndices();
   /**
    * @brief handleFilePath - helps with parsing file paths in the setup.yaml
    * @param path
    * @param setup_file_path
-   * @return
+   * @return path relative to the directory of the setup file, with '~' expanded (symlinks are not resolved)
+   * @throw std::runtime_error if the file does not exist
    */
   std::string handleFilePath(const std::string& path, const std::string& setup_file_path) const;
 
   // Path to the setup file
   std::string m_setup_file_path = "";
+
+  // Start all masters concurrently during setup
+  bool m_parallel_startup = false;
+  // Maximal number of threads used to create the slaves, 0: hardware concurrency
+  unsigned int m_construction_threads = 1;
+
+  // State of the cyclic thread of a master
+  struct MasterRuntime {
+    // nullptr for virtual buses
+    std::shared_ptr<ecat_master::EthercatMaster> master{};
+    // nullptr for real buses
+    std::shared_ptr<VirtualBus> virtual_bus{};
+    MasterRuntimeConfiguration configuration{};
+    std::string bus{};
+    // Set by a successful startup, reset by shutdown
+    bool started{false};
+    std::thread thread{};
+    std::atomic<bool> running{false};
+    // Thread of the last startupAsync / shutdownAsync of this bus
+    std::thread lifecycle_thread{};
+    // Only modified while the thread is not running
+    std::vector<std::function<void()>> cycle_callbacks{};
+    CycleTiming timing{};
+    // Counted by the realtime detector in the cycles of the thread
+    RealtimeViolations realtime_violations{};
+  };
+  // Indexed like m_masters
+  std::vector<std::unique_ptr<MasterRuntime>> m_master_runtimes;
+  // Indexed like m_masters, nullptr for real buses
+  std::vector<std::shared_ptr<VirtualBus>> m_virtual_buses;
+  // Reset by the thread of the last bus of a shutdownAsync
+  std::atomic<bool> m_runtime_running{false};
+  // Resolves the futures of shutdownAsync at the deadline
+  std::thread m_shutdown_deadline_thread;
+  // Serializes startupAsync, shutdownAsync, startupMasters, startRuntime, stopRuntime and applyConfiguration: guards the
+  // lifecycle_thread, thread and running members of the runtimes and m_runtime_running. Never locked by the lifecycle threads.
+  std::mutex m_lifecycle_mutex;
+  // Set by shutdownAsync, reset by the next startup
+  bool m_shutdown_requested{false};
+  // Created on first use
+  std::unique_ptr<ReadingDispatcher> m_reading_dispatcher;
+  // Index all slaves by handle, detached by applyConfiguration when the handles change
+  std::vector<std::weak_ptr<JointStateSnapshot>> m_joint_state_snapshots;
+  std::vector<std::weak_ptr<SharedMemoryExport>> m_shared_memory_exports;
+  // Passed to all master->startup calls
+  std::atomic<bool> m_startup_abort_flag{false};
+
+  // Timing of the initialization phases, recorded by the threads creating slaves and starting masters as well
+  mutable StartupProfiler m_startup_profiler;
+  // Empty: ETHERCAT_STARTUP_PROFILE
+  std::string m_startup_profile_path{};
+  /**
+   * @brief profileInitialization - records body as top level phase of a new startup profile and writes the profile, also if body throws
+   */
+  void profileInitialization(const std::string& name, const std::string& subject, const std::function<void()>& body);
+  void writeStartupProfile() const;
+  // applyConfiguration without the profiling
+  ReconfigurationReport reconfigure(const std::string& path, bool startup);
+};
+
+template <typename T>
+struct EthercatSlaveTypeTrait {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::NA;
+};
+template <>
+struct EthercatSlaveTypeTrait<elmo::Elmo> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::Elmo;
+};
+template <>
+struct EthercatSlaveTypeTrait<mps_ethercat_sdk::MPSDrive> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::MPSDrive;
+};
+template <>
+struct EthercatSlaveTypeTrait<maxon::Maxon> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::Maxon;
+};
+template <>
+struct EthercatSlaveTypeTrait<VirtualDevice> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::Virtual;
+};
+template <>
+struct EthercatSlaveTypeTrait<anydrive_rsl::AnydriveEthercatSlave> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::Anydrive;
+};
+template <>
+struct EthercatSlaveTypeTrait<rokubimini::ethercat::RokubiminiEthercat> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::Rokubi;
+};
+template <>
+struct EthercatSlaveTypeTrait<beckhoff::ek1100::EK1100> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::EK1100;
+};
+template <>
+struct EthercatSlaveTypeTrait<beckhoff::el3102::EL3102> {
+  static constexpr EthercatDeviceConfigurator::EthercatSlaveType value = EthercatDeviceConfigurator::EthercatSlaveType::EL3102;
 };
@@ -0,0 +1,211 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+#include "ethercat_device_configurator/TripleBuffer.hpp"
+
+/**
+ * @brief AlignedArray - fixed size, zero initialized array on its own cache lines
+ */
+template <typename T>
+class AlignedArray {
+  static_assert(std::is_trivially_copyable<T>::value, "AlignedArray: T has to be trivially copyable");
+
+ public:
+  AlignedArray() = default;
+  explicit AlignedArray(std::size_t size) : m_size(size) {
+    if (m_size == 0) return;
+    const std::size_t bytes = (m_size * sizeof(T) + 63) & ~static_cast<std::size_t>(63);
+    m_data.reset(static_cast<T*>(std::aligned_alloc(64, bytes)));
+    if (!m_data) throw std::bad_alloc();
+    std::fill(begin(), end(), T{});
+  }
+  AlignedArray(const AlignedArray& other) : AlignedArray(other.m_size) { std::copy(other.begin(), other.end(), begin()); }
+  AlignedArray(AlignedArray&&) noexcept = default;
+  // Does not allocate if the sizes match
+  AlignedArray& operator=(const AlignedArray& other) {
+    if (this == &other) return *this;
+    if (m_size != other.m_size) *this = AlignedArray(other.m_size);
+    std::copy(other.begin(), other.end(), begin());
+    return *this;
+  }
+  AlignedArray& operator=(AlignedArray&&) noexcept = default;
+
+  T* data() { return m_data.get(); }
+  const T* data() const { return m_data.get(); }
+  std::size_t size() const { return m_size; }
+  T* begin() { return data(); }
+  T* end() { return data() + m_size; }
+  const T* begin() const { return data(); }
+  const T* end() const { return data() + m_size; }
+  T& operator[](std::size_t i) { return m_data.get()[i]; }
+  const T& operator[](std::size_t i) const { return m_data.get()[i]; }
+
+ private:
+  struct Free {
+    void operator()(T* data) const { std::free(data); }
+  };
+  std::size_t m_size{0};
+  std::unique_ptr<T, Free> m_data{};
+};
+
+/**
+ * @brief JointStates - readings of all slaves as structure of arrays, indexed by slave handle. Values a slave does not have are 0.
+ */
+struct JointStates {
+  explicit JointStates(std::size_t size = 0)
+      : position(size), velocity(size), torque(size), current(size), state(size), force{}, moment{}, cycle(size) {
+    for (std::size_t axis = 0; axis < 3; axis++) {
+      force[axis] = AlignedArray<double>(size);
+      moment[axis] = AlignedArray<double>(size);
+    }
+  }
+
+  // Drives, see SharedMemoryDriveReading
+  AlignedArray<double> position;
+  AlignedArray<double> velocity;
+  AlignedArray<double> torque;
+  AlignedArray<double> current;
+  AlignedArray<uint32_t> state;
+  // Force torque sensors (x, y, z), see SharedMemoryForceTorqueReading
+  std::array<AlignedArray<double>, 3> force;
+  std::array<AlignedArray<double>, 3> moment;
+  // Cycle of the slave's master the values were gathered in, 0 before the first cycle
+  AlignedArray<uint64_t> cycle;
+};
+
+/**
+ * @brief JointCommands - commands of all drives as structure of arrays, indexed by slave handle, see SharedMemoryDriveCommand
+ */
+struct JointCommands {
+  explicit JointCommands(std::size_t size = 0)
+      : position(size), velocity(size), torque(size), current(size), mode(size), enabled(size) {}
+
+  AlignedArray<double> position;
+  AlignedArray<double> velocity;
+  AlignedArray<double> torque;
+  AlignedArray<double> current;
+  // 0 keeps the last mode other than 0 of the drive
+  AlignedArray<uint32_t> mode;
+  // Only drives with enabled != 0 get a command
+  AlignedArray<uint8_t> enabled;
+};
+
+/**
+ * @brief JointStateSnapshot - gathers the readings of all slaves into JointStates at the end of every cycle and scatters JointCommands to
+ * the drives, so that a controller iterates contiguous arrays instead of calling getReading / stageCommand per drive. The conversion is
+ * done by the process data adapters of the device types (DeviceFactoryRegistry), slaves without one stay 0.
+ * Every master exchanges its part through triple buffers: the cyclic threads never wait for the controller. One controller thread.
+ * Create it with EthercatDeviceConfigurator::addJointStateSnapshot before startRuntime.
+ */
+class JointStateSnapshot {
+ public:
+  struct Slave {
+    std::shared_ptr<ecat_master::EthercatDevice> device{};
+    // Adapter of the slave's type, reading_layout / command_layout None if it has none
+    DeviceFactoryRegistry::ProcessDataAdapter adapter{};
+    // Index of the slave's master
+    std::size_t master{0};
+  };
+
+  /**
+   * @param slaves - indexed by slave handle
+   * @param number_of_masters
+   */
+  JointStateSnapshot(std::vector<Slave> slaves, std::size_t number_of_masters);
+  JointStateSnapshot(const JointStateSnapshot&) = delete;
+  JointStateSnapshot& operator=(const JointStateSnapshot&) = delete;
+
+  /*Controller thread*/
+
+  /**
+   * @brief update - fetches the latest states of all masters. Never blocks, allocation free.
+   * @return true if a master published new states since the last call
+   */
+  bool update();
+  /**
+   * @brief getStates - states fetched by update. With one master these are the arrays written by the cyclic thread, without a copy.
+   */
+  const JointStates& getStates() const;
+  /**
+   * @brief commands - fill in the commands, then publishCommands
+   */
+  JointCommands& commands() { return m_commands; }
+  /**
+   * @brief publishCommands - the enabled commands are staged after the next update of every master. Never blocks, allocation free.
+   */
+  void publishCommands();
+  /**
+   * @brief isAttached - false once EthercatDeviceConfigurator::applyConfiguration changed the slave handles, the snapshot is not
+   * updated anymore then. Create a new one with addJointStateSnapshot.
+   */
+  bool isAttached() const { return m_attached.load(std::memory_order_acquire); }
+
+  /*Configurator*/
+
+  /**
+   * @brief detach - cycle returns immediately from now on
+   */
+  void detach() { m_attached.store(false, std::memory_order_release); }
+
+  /*Cyclic thread*/
+
+  /**
+   * @brief cycle - stages the latest commands (if there are new ones) and gathers the readings of the slaves of a master.
+   * Called by the cyclic thread of the master after every update. Does nothing once detached.
+   */
+  void cycle(std::size_t master);
+
+  std::size_t size() const { return m_slaves.size(); }
+
+ private:
+  // Part of one master, the buffers are sized for all slaves but only the master's handles are touched
+  struct MasterExchange {
+    explicit MasterExchange(std::size_t size) : states(JointStates(size)), commands(JointCommands(size)), modes(size) {}
+    std::vector<std::size_t> handles{};
+    TripleBuffer<JointStates> states;
+    TripleBuffer<JointCommands> commands;
+    uint64_t cycle{0};
+    // Last mode other than 0 staged per handle, see sharedMemoryKeepDriveMode
+    std::vector<uint32_t> modes;
+  };
+
+  std::vector<Slave> m_slaves;
+  std::vector<std::unique_ptr<MasterExchange>> m_masters;
+  // Controller side, merged from all masters. Unused with one master.
+  JointStates m_states;
+  JointCommands m_commands;
+  std::atomic<bool> m_attached{true};
+};
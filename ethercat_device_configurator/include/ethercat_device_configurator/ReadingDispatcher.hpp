@@ -0,0 +1,237 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ethercat_device_configurator/ReadingQueue.hpp"
+
+/**
+ * @brief ReadingChannelBase - readings of one device, queued by the cyclic thread and passed to a callback by the ReadingDispatcher
+ */
+class ReadingChannelBase {
+ public:
+  struct Statistics {
+    // Queued readings which were not dropped: dispatched + queued
+    uint64_t pushed{0};
+    // Readings lost because the queue was full, new or queued ones depending on the overflow policy. pushed + dropped counts all pushes.
+    uint64_t dropped{0};
+    // Readings passed to the callback
+    uint64_t dispatched{0};
+    // Callbacks which threw
+    uint64_t failed{0};
+  };
+
+  explicit ReadingChannelBase(std::string name) : m_name(std::move(name)) {}
+  virtual ~ReadingChannelBase() = default;
+
+  const std::string& getName() const { return m_name; }
+  virtual Statistics getStatistics() const = 0;
+
+ protected:
+  friend class ReadingDispatcher;
+
+  /**
+   * @brief dispatch - runs the callback for up to max_readings queued readings. Called by one worker at a time
+   * @return number of dispatched readings
+   */
+  virtual std::size_t dispatch(std::size_t max_readings) = 0;
+
+  std::string m_name;
+  // Claimed by the worker which dispatches the channel, makes it the single consumer of the queue
+  std::atomic<bool> m_busy{false};
+  std::atomic<uint64_t> m_dispatched{0};
+  std::atomic<uint64_t> m_failed{0};
+};
+
+/**
+ * @brief ReadingChannel - typed channel, see ReadingDispatcher::addChannel
+ * @tparam Reading - copy assignable reading type of the device
+ */
+template <typename Reading>
+class ReadingChannel : public ReadingChannelBase {
+ public:
+  // Same signature as the reading callbacks of the sdks (addReadingCb)
+  typedef std::function<void(const std::string& name, const Reading& reading)> Callback;
+
+  ReadingChannel(std::string name, Callback callback, std::size_t capacity, ReadingOverflowPolicy policy)
+      : ReadingChannelBase(std::move(name)), m_callback(std::move(callback)), m_queue(capacity, policy) {}
+
+  /**
+   * @brief push - queues a copy of the reading, never blocks. Call from one thread only, e.g. the cyclic thread or an sdk reading callback.
+   */
+  void push(const Reading& reading) { m_queue.push(reading); }
+
+  /**
+   * @brief produce - fills the reading in place into a free queue slot with function(Reading&), see ReadingQueue::produce. Same thread
+   * rules as push.
+   */
+  template <typename Function>
+  void produce(Function&& function) {
+    m_queue.produce(std::forward<Function>(function));
+  }
+
+  Statistics getStatistics() const override {
+    Statistics statistics;
+    statistics.pushed = m_queue.pushed();
+    statistics.dropped = m_queue.dropped();
+    statistics.dispatched = m_dispatched.load(std::memory_order_relaxed);
+    statistics.failed = m_failed.load(std::memory_order_relaxed);
+    return statistics;
+  }
+
+ protected:
+  std::size_t dispatch(std::size_t max_readings) override {
+    std::size_t dispatched = 0;
+    while (dispatched < max_readings && m_queue.consume([this](const Reading& reading) {
+      try {
+        m_callback(m_name, reading);
+      } catch (...) {
+        m_failed.fetch_add(1, std::memory_order_relaxed);
+      }
+    })) {
+      dispatched++;
+    }
+    m_dispatched.fetch_add(dispatched, std::memory_order_relaxed);
+    return dispatched;
+  }
+
+ private:
+  Callback m_callback;
+  ReadingQueue<Reading> m_queue;
+};
+
+/**
+ * @brief DeviceReading - reading type of a slave class and how the cyclic thread copies it into a queue slot. The Reading is the return
+ * type of getReading(), or the parameter of getReading(Reading&) for slaves which only fill a reading (e.g. RokubiminiEthercat).
+ * copy fills the slot in place with getReading(Reading&) if the slave has it, the storage of the slot is reused.
+ */
+template <typename Device, typename = void>
+struct DeviceReading {
+ private:
+  template <typename Reading, typename Class>
+  static Reading parameter(void (Class::*)(Reading&) const);
+  template <typename Reading, typename Class>
+  static Reading parameter(void (Class::*)(Reading&));
+
+ public:
+  typedef std::decay_t<decltype(parameter(&Device::getReading))> Reading;
+
+  static void copy(Device& device, Reading& reading) { device.getReading(reading); }
+};
+
+template <typename Device>
+struct DeviceReading<Device, std::void_t<decltype(std::declval<Device&>().getReading())>> {
+  typedef std::decay_t<decltype(std::declval<Device&>().getReading())> Reading;
+
+  static void copy(Device& device, Reading& reading) { copy(device, reading, 0); }
+
+ private:
+  template <typename D>
+  static auto copy(D& device, Reading& reading, int) -> decltype(device.getReading(reading), void()) {
+    device.getReading(reading);
+  }
+  template <typename D>
+  static void copy(D& device, Reading& reading, long) {
+    reading = device.getReading();
+  }
+};
+
+/**
+ * @brief ReadingDispatcher - runs reading callbacks on a pool of worker threads instead of the cyclic thread.
+ * The cyclic thread only copies the reading into the pre-allocated queue of the device's channel, the workers take the readings
+ * out and call the callbacks, so a slow callback cannot delay the bus update. Each channel is dispatched by one worker at a time, in
+ * order. Idle workers poll the queues every poll_period.
+ */
+class ReadingDispatcher {
+ public:
+  struct Configuration {
+    unsigned int worker_threads{1};
+    // Queued readings per channel
+    std::size_t queue_capacity{16};
+    ReadingOverflowPolicy overflow_policy{ReadingOverflowPolicy::DropOldest};
+    // Sleep of an idle worker in seconds, bounds the delay of a reading
+    double poll_period{0.001};
+  };
+
+  ReadingDispatcher();
+  explicit ReadingDispatcher(const Configuration& configuration);
+  /**
+   * @brief ~ReadingDispatcher - stops the workers
+   */
+  ~ReadingDispatcher();
+  ReadingDispatcher(const ReadingDispatcher&) = delete;
+  ReadingDispatcher& operator=(const ReadingDispatcher&) = delete;
+
+  /**
+   * @brief addChannel - creates the channel of one device, its queue is allocated here
+   * @param name - passed to the callback, e.g. the device name
+   * @param callback - called by a worker for every reading
+   * @throw std::runtime_error if the dispatcher is running
+   */
+  template <typename Reading>
+  std::shared_ptr<ReadingChannel<Reading>> addChannel(std::string name, typename ReadingChannel<Reading>::Callback callback) {
+    auto channel = std::make_shared<ReadingChannel<Reading>>(std::move(name), std::move(callback), m_configuration.queue_capacity,
+                                                             m_configuration.overflow_policy);
+    addChannel(channel);
+    return channel;
+  }
+
+  /**
+   * @brief start - starts the workers
+   */
+  void start();
+  /**
+   * @brief stop - stops the workers, the readings still queued are dispatched on the calling thread. Stop pushing readings first.
+   * Idempotent, returns immediately if the dispatcher is not running.
+   */
+  void stop();
+  bool isRunning() const { return m_running; }
+
+  const Configuration& getConfiguration() const { return m_configuration; }
+  const std::vector<std::shared_ptr<ReadingChannelBase>>& getChannels() const { return m_channels; }
+  /**
+   * @brief getStatistics - sum over all channels
+   */
+  ReadingChannelBase::Statistics getStatistics() const;
+
+ private:
+  void addChannel(std::shared_ptr<ReadingChannelBase> channel);
+  void runWorker(std::size_t worker_index);
+  // Dispatches every channel which is not busy once, starting at first_channel
+  std::size_t dispatchChannels(std::size_t first_channel);
+
+  Configuration m_configuration;
+  // Only modified while the workers are not running
+  std::vector<std::shared_ptr<ReadingChannelBase>> m_channels;
+  std::vector<std::thread> m_workers;
+  std::atomic<bool> m_running{false};
+};
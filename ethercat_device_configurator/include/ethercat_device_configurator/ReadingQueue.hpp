@@ -0,0 +1,193 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// What a full ReadingQueue does with a new reading
+enum class ReadingOverflowPolicy {
+  // Reject the new reading
+  DropNewest,
+  // Drop the oldest queued reading to take the new one
+  DropOldest
+};
+
+/**
+ * @brief ReadingQueue - bounded queue between exactly one producer thread (e.g. the cyclic thread) and one consumer thread at a time.
+ * All slots are allocated on construction. The producer copies or fills the reading into a free slot and passes the slot index, the
+ * consumer processes the slot in place and returns it. Slots are only exchanged by index, so the producer never writes a slot the consumer
+ * is reading, also when it drops the oldest reading of a full queue. Push never blocks: wait-free with DropNewest, lock-free with
+ * DropOldest.
+ */
+template <typename T>
+class ReadingQueue {
+ public:
+  typedef ReadingOverflowPolicy OverflowPolicy;
+
+  /**
+   * @param capacity - number of queued readings, at least 1
+   */
+  ReadingQueue(std::size_t capacity, OverflowPolicy policy)
+      : m_capacity(capacity),
+        m_policy(policy),
+        m_slots(capacity + 1),
+        m_queue(new std::atomic<uint32_t>[capacity]),
+        m_free(new uint32_t[capacity + 1]) {
+    if (capacity == 0) throw std::invalid_argument("[ReadingQueue] Capacity has to be at least 1");
+    // capacity queued, one held by the consumer: the producer always finds a free slot if the queue is not full.
+    for (uint32_t slot = 0; slot <= capacity; slot++) {
+      m_free[slot] = slot;
+    }
+    m_free_head.store(capacity + 1, std::memory_order_relaxed);
+  }
+  ReadingQueue(const ReadingQueue&) = delete;
+  ReadingQueue& operator=(const ReadingQueue&) = delete;
+
+  /*Producer*/
+
+  /**
+   * @brief push - copies the value into a free slot and queues it. Never blocks, does not allocate if the copy assignment of T does not.
+   * @return false if a reading was dropped, the new one (DropNewest) or the oldest one (DropOldest)
+   */
+  bool push(const T& value) {
+    return produce([&value](T& slot) { slot = value; });
+  }
+
+  /**
+   * @brief produce - calls function(T&) with a free slot to fill the new reading in place and queues it. The slot holds an older reading,
+   * reusing its storage avoids allocations of readings with dynamic members. Never blocks, function must not throw.
+   * @return false if a reading was dropped, see push
+   */
+  template <typename Function>
+  bool produce(Function&& function) {
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    bool dropped = false;
+    uint32_t slot = 0;
+    bool have_slot = false;
+    uint64_t tail = m_tail.load(std::memory_order_acquire);
+    if (head - tail >= m_capacity) {
+      if (m_policy == OverflowPolicy::DropNewest) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      // Take the oldest slot back. Fails only if the consumer took it meanwhile, then the queue is not full anymore.
+      const uint32_t oldest = m_queue[tail % m_capacity].load(std::memory_order_relaxed);
+      if (m_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        slot = oldest;
+        have_slot = true;
+        dropped = true;
+      }
+    }
+    if (!have_slot) {
+      const uint64_t free_tail = m_free_tail.load(std::memory_order_relaxed);
+      // Never empty (capacity + 1 slots, less than capacity queued, at most one held by the consumer). The acquire orders the consumer's
+      // last access of the slot before the copy below.
+      if (free_tail == m_free_head.load(std::memory_order_acquire)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      slot = m_free[free_tail % (m_capacity + 1)];
+      m_free_tail.store(free_tail + 1, std::memory_order_relaxed);
+    }
+    function(m_slots[slot]);
+    // Counted before publishing, pushed never lags behind the consumed readings. The new reading replaces an evicted one in pushed.
+    if (dropped) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      m_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_queue[head % m_capacity].store(slot, std::memory_order_relaxed);
+    m_head.store(head + 1, std::memory_order_release);
+    return !dropped;
+  }
+
+  /*Consumer*/
+
+  /**
+   * @brief consume - calls function(const T&) with the oldest queued reading, in place
+   * @return false if the queue is empty
+   */
+  template <typename Function>
+  bool consume(Function&& function) {
+    uint64_t tail = m_tail.load(std::memory_order_acquire);
+    uint32_t slot = 0;
+    do {
+      if (tail == m_head.load(std::memory_order_acquire)) return false;
+      slot = m_queue[tail % m_capacity].load(std::memory_order_relaxed);
+    } while (!m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+
+    // The slot is owned by the consumer until it is returned to the free list, also if function throws.
+    struct Release {
+      ReadingQueue& queue;
+      uint32_t slot;
+      ~Release() {
+        const uint64_t free_head = queue.m_free_head.load(std::memory_order_relaxed);
+        queue.m_free[free_head % (queue.m_capacity + 1)] = slot;
+        queue.m_free_head.store(free_head + 1, std::memory_order_release);
+      }
+    } release{*this, slot};
+    function(static_cast<const T&>(m_slots[slot]));
+    return true;
+  }
+
+  /**
+   * @brief size - number of queued readings, approximate while the queue is used
+   */
+  std::size_t size() const {
+    return static_cast<std::size_t>(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+  }
+  std::size_t capacity() const { return m_capacity; }
+  OverflowPolicy policy() const { return m_policy; }
+  /**
+   * @brief pushed - number of queued readings which were not dropped later: consumed + size() once the producer is idle
+   */
+  uint64_t pushed() const { return m_pushed.load(std::memory_order_relaxed); }
+  /**
+   * @brief dropped - number of readings lost on a full queue, new ones (DropNewest) or queued ones (DropOldest). Together with pushed it
+   * counts all calls of push and produce.
+   */
+  uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+ private:
+  const std::size_t m_capacity;
+  const OverflowPolicy m_policy;
+  std::vector<T> m_slots;
+  // Slot indices of the queued readings, ring indexed by m_tail (oldest) .. m_head
+  std::unique_ptr<std::atomic<uint32_t>[]> m_queue;
+  // Ring of free slot indices, filled by the consumer (m_free_head) and taken by the producer (m_free_tail)
+  std::unique_ptr<uint32_t[]> m_free;
+
+  // Written by the producer
+  alignas(64) std::atomic<uint64_t> m_head{0};
+  std::atomic<uint64_t> m_free_tail{0};
+  std::atomic<uint64_t> m_pushed{0};
+  std::atomic<uint64_t> m_dropped{0};
+  // Advanced by the consumer, and by the producer when it drops the oldest reading
+  alignas(64) std::atomic<uint64_t> m_tail{0};
+  // Written by the consumer
+  alignas(64) std::atomic<uint64_t> m_free_head{0};
+};
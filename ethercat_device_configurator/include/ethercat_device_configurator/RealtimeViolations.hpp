@@ -0,0 +1,82 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief RealtimeViolations - calls which must not happen on a realtime thread, counted by the realtime detector
+ * (libethercat_realtime_detector.so, preloaded with LD_PRELOAD) while the thread is in a RealtimeSection.
+ * Incremented by the marked thread, read and reset from any thread.
+ */
+struct RealtimeViolations {
+  // malloc, calloc, realloc, free, posix_memalign, aligned_alloc, memalign, valloc (including operator new / delete)
+  std::atomic<uint64_t> allocations{0};
+  // pthread_mutex_lock on a mutex held by another thread (std::mutex), pthread_rwlock_(timed)rdlock / wrlock on a held lock
+  // (std::shared_mutex), sem_(timed)wait on a semaphore at 0 and every pthread_cond_wait / timedwait / clockwait
+  // (std::condition_variable)
+  std::atomic<uint64_t> lock_waits{0};
+  // File i/o: open, open64, openat, close, read, write, writev, pread, pwrite, fsync, fdatasync. Stdio: fopen, fopen64, fclose, fwrite,
+  // fputs, fputc, putc, putchar, puts, printf, fprintf, vprintf, vfprintf (also the _FORTIFY_SOURCE variants of printf / fprintf),
+  // fflush. Sleeps: nanosleep, usleep, sleep.
+  // Not counted: the writes glibc makes internally (a buffer flush of stdio is counted at the stdio call), clock_nanosleep, socket i/o
+  // and direct system calls.
+  std::atomic<uint64_t> blocking_calls{0};
+
+  uint64_t total() const {
+    return allocations.load(std::memory_order_relaxed) + lock_waits.load(std::memory_order_relaxed) +
+           blocking_calls.load(std::memory_order_relaxed);
+  }
+  void reset() {
+    allocations.store(0, std::memory_order_relaxed);
+    lock_waits.store(0, std::memory_order_relaxed);
+    blocking_calls.store(0, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief RealtimeSection - marks the calling thread as realtime for its lifetime, the violations of the thread are counted into the
+ * given counters. Sections nest, the innermost one counts. Costs two thread local stores, without the detector nothing is counted.
+ */
+class RealtimeSection {
+ public:
+  explicit RealtimeSection(RealtimeViolations& violations);
+  ~RealtimeSection();
+  RealtimeSection(const RealtimeSection&) = delete;
+  RealtimeSection& operator=(const RealtimeSection&) = delete;
+
+  /**
+   * @brief detectorLoaded - true if the realtime detector is preloaded, otherwise all counters stay 0
+   */
+  static bool detectorLoaded();
+
+ private:
+  RealtimeViolations* m_outer;
+};
+
+/**
+ * @brief ethercat_realtime_violations - counters of the innermost RealtimeSection of the calling thread, nullptr outside of sections.
+ * Called by the realtime detector on every hooked call.
+ */
+extern "C" RealtimeViolations* ethercat_realtime_violations();
@@ -0,0 +1,74 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ethercat_device_configurator/EthercatDeviceConfigurator.hpp"
+
+/**
+ * @brief SetupSnapshot - versioned binary form of a parsed and validated setup.yaml.
+ * Contains the master configurations, the slave entries (with resolved configuration file paths) and the content hashes of all source
+ * files. Written by compile_setup_snapshot / EthercatDeviceConfigurator::compileSetupSnapshot, read with a memory mapping.
+ */
+class SetupSnapshot {
+ public:
+  // Increment on every change of the binary layout
+  static constexpr uint32_t formatVersion = 4;
+
+  struct SourceFile {
+    // Canonical path
+    std::string path{};
+    // ConfigurationCache::hash of the content
+    uint64_t hash{0};
+  };
+
+  std::string setup_file_path{};
+  std::vector<ecat_master::EthercatMasterConfiguration> master_configurations{};
+  // Indexed like master_configurations
+  std::vector<EthercatDeviceConfigurator::MasterRuntimeConfiguration> master_runtime_configurations{};
+  std::vector<EthercatDeviceConfigurator::EthercatSlaveEntry> slave_entries{};
+  // setup.yaml and all referenced configuration files
+  std::vector<SourceFile> source_files{};
+
+  /**
+   * @brief write - serializes the snapshot to a file (written to a temporary file first, then renamed)
+   * @throw std::runtime_error on io errors
+   */
+  void write(const std::string& path) const;
+
+  /**
+   * @brief read - memory maps and deserializes a snapshot
+   * @throw std::runtime_error if the file cannot be read, is corrupt or has a different format version
+   */
+  static SetupSnapshot read(const std::string& path);
+
+  /**
+   * @brief sourcesUpToDate - checks the content hashes of all source files
+   * @param outdated - set to the first source file which changed or is missing
+   * @return true if all source files still match
+   */
+  bool sourcesUpToDate(std::string& outdated) const;
+};
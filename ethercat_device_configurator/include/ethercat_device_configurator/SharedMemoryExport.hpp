@@ -0,0 +1,179 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+#include "ethercat_device_configurator/SharedMemoryLayout.hpp"
+
+/**
+ * @brief SharedMemoryExport - publishes the readings of all slaves in a POSIX shared memory segment and stages the commands written to it
+ * by other processes (SharedMemoryClient). The layout (SharedMemoryLayout.hpp) is fixed when the export is created. Readings are written
+ * in place into the segment by the process data adapters of the device types. Created with EthercatDeviceConfigurator::exportSharedMemory,
+ * serviced by the cyclic threads of the masters.
+ */
+class SharedMemoryExport {
+ public:
+  struct Slave {
+    std::string name{};
+    std::string type_name{};
+    std::string ethercat_bus{};
+    uint32_t ethercat_address{0};
+    std::shared_ptr<ecat_master::EthercatDevice> device{};
+    // Without adapter the slave is listed without reading and command
+    DeviceFactoryRegistry::ProcessDataAdapter adapter{};
+  };
+
+  /**
+   * @brief SharedMemoryExport - creates, sizes and pre-faults the segment. A stale segment with the same name (e.g. of a crashed
+   * process) is replaced, clients which still map it see it Closed. A segment of a running process is never replaced.
+   * @param name - shm_open name, e.g. "/ethercat_device_configurator"
+   * @param slaves - in the order of the slave table
+   * @throw std::runtime_error if the segment cannot be created, the name is used by a running export (or is no device export) or a
+   * name is too long for the slave table
+   */
+  SharedMemoryExport(std::string name, std::vector<Slave> slaves);
+  // Marks the segment Closed and unlinks it, unless detach did
+  ~SharedMemoryExport();
+  SharedMemoryExport(const SharedMemoryExport&) = delete;
+  SharedMemoryExport& operator=(const SharedMemoryExport&) = delete;
+
+  /**
+   * @brief cycle - publishes the reading of a slave and stages its latest command if the client wrote a new one. Called by the cyclic
+   * thread of the slave's master after every update, every slave by one thread only. Never blocks, allocation free.
+   * Does nothing once detached.
+   * @param index - index in the slave table
+   */
+  void cycle(std::size_t index);
+  /**
+   * @brief detach - marks the segment Closed and unlinks it, cycle returns immediately from now on. Called by
+   * EthercatDeviceConfigurator::applyConfiguration when the slave table does not match the configuration anymore, a new export may
+   * take the name.
+   */
+  void detach();
+  bool isAttached() const { return m_attached.load(std::memory_order_acquire); }
+
+  const std::string& getName() const { return m_name; }
+  std::size_t getSize() const { return m_size; }
+  const std::vector<Slave>& getSlaves() const { return m_slaves; }
+
+ private:
+  // Only touched by the cyclic thread of the slave
+  struct SlaveState {
+    SharedMemoryReadingSlot* reading{nullptr};
+    SharedMemoryCommandSlot* command{nullptr};
+    std::size_t reading_size{0};
+    std::size_t command_size{0};
+    uint64_t cycle{0};
+    uint64_t applied{0};
+    // Last mode of a drive command other than 0, passed to the adapter for the commands which keep the mode
+    uint32_t mode{0};
+  };
+
+  std::string m_name;
+  std::vector<Slave> m_slaves;
+  std::vector<SlaveState> m_states;
+  void* m_data{nullptr};
+  std::size_t m_size{0};
+  std::atomic<bool> m_attached{true};
+};
+
+/**
+ * @brief SharedMemoryClient - access of another process to a SharedMemoryExport, e.g. a controller, logger or safety monitor. Does not need
+ * the device sdks. Readers never block the exporting process; several processes may stage commands, the writes of one slot are serialized.
+ */
+class SharedMemoryClient {
+ public:
+  /**
+   * @brief SharedMemoryClient - maps the segment
+   * @throw std::runtime_error if the segment does not exist, is no export or has a different layout version
+   */
+  explicit SharedMemoryClient(const std::string& name);
+  ~SharedMemoryClient();
+  SharedMemoryClient(const SharedMemoryClient&) = delete;
+  SharedMemoryClient& operator=(const SharedMemoryClient&) = delete;
+
+  /**
+   * @brief isActive - false once the exporting process stopped or replaced the segment, reconnect with a new client
+   */
+  bool isActive() const;
+
+  std::size_t getNumberOfSlaves() const { return m_header->slave_count; }
+  const SharedMemorySlaveInfo& getSlaveInfo(std::size_t index) const;
+  /**
+   * @brief getSlaveIndex - index of a slave by name, O(n)
+   * @throw std::out_of_range if there is no slave with that name
+   */
+  std::size_t getSlaveIndex(const std::string& name) const;
+
+  /**
+   * @brief getReading - copies the latest reading of a slave, retries while the exporting process writes it
+   * @tparam Reading - SharedMemoryDriveReading, SharedMemoryForceTorqueReading, matching the reading_layout of the slave
+   * @param cycle - set to the number of readings published for the slave
+   * @param stamp - set to the CLOCK_MONOTONIC time of the publish in ns
+   * @return false if no consistent copy could be made (writer stuck) or nothing was published yet
+   * @throw std::invalid_argument if the layout does not match
+   */
+  template <typename Reading>
+  bool getReading(std::size_t index, Reading& reading, uint64_t* cycle = nullptr, int64_t* stamp = nullptr) const {
+    uint64_t published = 0;
+    int64_t published_stamp = 0;
+    if (!readSlot(index, Reading::layout, &reading, published, published_stamp)) return false;
+    if (cycle) *cycle = published;
+    if (stamp) *stamp = published_stamp;
+    return published != 0;
+  }
+
+  /**
+   * @brief stageCommand - the command is staged on the slave by the cyclic thread after the next update of its master
+   * @tparam Command - SharedMemoryDriveCommand, matching the command_layout of the slave
+   * @return count of the command, see getAppliedCommandCount
+   * @throw std::invalid_argument if the layout does not match
+   */
+  template <typename Command>
+  uint64_t stageCommand(std::size_t index, const Command& command) {
+    return writeSlot(index, Command::layout, &command);
+  }
+
+  /**
+   * @brief getAppliedCommandCount - count of the last command staged on the slave
+   */
+  uint64_t getAppliedCommandCount(std::size_t index) const;
+
+ private:
+  bool readSlot(std::size_t index, SharedMemoryDataLayout layout, void* data, uint64_t& cycle, int64_t& stamp) const;
+  uint64_t writeSlot(std::size_t index, SharedMemoryDataLayout layout, const void* data);
+
+  std::string m_name;
+  void* m_data{nullptr};
+  std::size_t m_size{0};
+  const SharedMemoryHeader* m_header{nullptr};
+  const SharedMemorySlaveInfo* m_slave_infos{nullptr};
+};
@@ -0,0 +1,195 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Layout of the shared memory segment written by SharedMemoryExport, shared with processes which do not link the sdks:
+ *
+ *   SharedMemoryHeader
+ *   SharedMemorySlaveInfo[slave_count]          in the order of the slave handles
+ *   per slave with a reading:  SharedMemoryReadingSlot followed by the reading (reading_layout), at reading_offset
+ *   per slave with a command:  SharedMemoryCommandSlot followed by the command (command_layout), at command_offset
+ *
+ * Slots are cache line aligned. Every slot is protected by a sequence lock: the sequence is odd while the slot is written. Readers copy
+ * the slot and retry if the sequence changed meanwhile, see sharedMemoryTryRead.
+ */
+
+// Increment on every change of the layout
+constexpr uint32_t sharedMemoryLayoutVersion = 1;
+// "ECATSHM"
+constexpr uint64_t sharedMemoryMagic = 0x4543415453484d00;
+
+// Fixed data layouts of readings and commands, process data adapters convert the sdk types from and to them
+enum class SharedMemoryDataLayout : uint32_t { None = 0, Drive = 1, DriveCommand = 2, ForceTorque = 3 };
+
+struct SharedMemoryDriveReading {
+  static constexpr SharedMemoryDataLayout layout = SharedMemoryDataLayout::Drive;
+  // Joint side if the sdk knows the gear, SI units
+  double position{0.0};
+  double velocity{0.0};
+  double torque{0.0};
+  double current{0.0};
+  // Sdk specific state: DriveState (Elmo, Maxon), active fsm state (Anydrive)
+  uint32_t state{0};
+  uint32_t reserved{0};
+};
+
+struct SharedMemoryDriveCommand {
+  static constexpr SharedMemoryDataLayout layout = SharedMemoryDataLayout::DriveCommand;
+  double position{0.0};
+  double velocity{0.0};
+  double torque{0.0};
+  double current{0.0};
+  // Sdk specific mode of operation, 0: keep the mode
+  uint32_t mode{0};
+  uint32_t reserved{0};
+};
+
+/**
+ * @brief sharedMemoryKeepDriveMode - applies "0: keep the mode" to a drive command before it is staged. The process data adapters do not
+ * set the mode of operation for mode 0, so 0 is replaced by the last mode other than 0 commanded to the drive.
+ * @param last_mode - last mode other than 0 commanded to the drive, 0 before the first one. Updated by commands with a mode.
+ */
+inline void sharedMemoryKeepDriveMode(SharedMemoryDriveCommand& command, uint32_t& last_mode) {
+  if (command.mode == 0) {
+    command.mode = last_mode;
+  } else {
+    last_mode = command.mode;
+  }
+}
+
+struct SharedMemoryForceTorqueReading {
+  static constexpr SharedMemoryDataLayout layout = SharedMemoryDataLayout::ForceTorque;
+  double force[3]{0.0, 0.0, 0.0};
+  double torque[3]{0.0, 0.0, 0.0};
+};
+
+inline std::size_t sharedMemoryDataSize(SharedMemoryDataLayout layout) {
+  switch (layout) {
+    case SharedMemoryDataLayout::Drive:
+      return sizeof(SharedMemoryDriveReading);
+    case SharedMemoryDataLayout::DriveCommand:
+      return sizeof(SharedMemoryDriveCommand);
+    case SharedMemoryDataLayout::ForceTorque:
+      return sizeof(SharedMemoryForceTorqueReading);
+    default:
+      return 0;
+  }
+}
+// Upper bound of sharedMemoryDataSize, for buffers of the cyclic thread
+constexpr std::size_t sharedMemoryMaxDataSize = 128;
+
+struct SharedMemoryHeader {
+  enum State : uint32_t { Initializing = 0, Active = 1, Closed = 2 };
+
+  uint64_t magic{sharedMemoryMagic};
+  uint32_t version{sharedMemoryLayoutVersion};
+  uint32_t slave_count{0};
+  // Size of the segment in bytes
+  uint64_t size{0};
+  // Active while the exporting process publishes, Closed after it stopped
+  std::atomic<uint32_t> state{Initializing};
+  // Process id of the exporting process, a segment not Closed by a process which does not exist anymore is stale
+  int32_t owner_pid{0};
+};
+
+struct SharedMemorySlaveInfo {
+  char name[64]{};
+  char type_name[32]{};
+  char ethercat_bus[32]{};
+  uint32_t ethercat_address{0};
+  SharedMemoryDataLayout reading_layout{SharedMemoryDataLayout::None};
+  SharedMemoryDataLayout command_layout{SharedMemoryDataLayout::None};
+  uint32_t reserved{0};
+  // Offsets of the slots from the start of the segment, 0 if the layout is None
+  uint64_t reading_offset{0};
+  uint64_t command_offset{0};
+};
+
+struct alignas(64) SharedMemoryReadingSlot {
+  std::atomic<uint32_t> sequence{0};
+  uint32_t reserved{0};
+  // Protected by the sequence, like the reading: number of published readings and CLOCK_MONOTONIC time of the publish in ns
+  uint64_t cycle{0};
+  int64_t stamp{0};
+};
+
+struct alignas(64) SharedMemoryCommandSlot {
+  // Written by the clients
+  std::atomic<uint32_t> sequence{0};
+  uint32_t reserved{0};
+  // Protected by the sequence: incremented by the client with every command
+  uint64_t count{0};
+  // count of the last command staged by the cyclic thread
+  std::atomic<uint64_t> applied{0};
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory slots need address free atomics");
+static_assert(sizeof(SharedMemoryDriveReading) <= sharedMemoryMaxDataSize && sizeof(SharedMemoryDriveCommand) <= sharedMemoryMaxDataSize &&
+                  sizeof(SharedMemoryForceTorqueReading) <= sharedMemoryMaxDataSize,
+              "sharedMemoryMaxDataSize too small");
+
+// The reading / command follows its slot
+template <typename Slot>
+void* sharedMemorySlotData(Slot* slot) {
+  return reinterpret_cast<char*>(slot) + sizeof(Slot);
+}
+template <typename Slot>
+const void* sharedMemorySlotData(const Slot* slot) {
+  return reinterpret_cast<const char*>(slot) + sizeof(Slot);
+}
+
+/**
+ * @brief sharedMemoryWriteBegin / sharedMemoryWriteEnd - enclose the writes of a slot. Single writer per slot.
+ * @return the sequence to pass to sharedMemoryWriteEnd
+ */
+inline uint32_t sharedMemoryWriteBegin(std::atomic<uint32_t>& sequence) {
+  const uint32_t odd = sequence.load(std::memory_order_relaxed) + 1;
+  sequence.store(odd, std::memory_order_relaxed);
+  // keeps the writes of the slot after the odd sequence
+  std::atomic_thread_fence(std::memory_order_release);
+  return odd;
+}
+inline void sharedMemoryWriteEnd(std::atomic<uint32_t>& sequence, uint32_t odd) {
+  sequence.store(odd + 1, std::memory_order_release);
+}
+
+/**
+ * @brief sharedMemoryTryRead - one attempt to copy a slot consistently
+ * @param copy - copies the slot, called once. The copy has to be discarded if false is returned.
+ * @return false if the slot was written meanwhile
+ */
+template <typename Copy>
+bool sharedMemoryTryRead(const std::atomic<uint32_t>& sequence, Copy&& copy) {
+  const uint32_t before = sequence.load(std::memory_order_acquire);
+  if (before & 1u) return false;
+  copy();
+  // keeps the copy before the second load of the sequence
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return sequence.load(std::memory_order_relaxed) == before;
+}
@@ -0,0 +1,99 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "ethercat_device_configurator/TripleBuffer.hpp"
+
+/**
+ * @brief SlaveExchangeBase - part of a SlaveExchange which is executed by the cyclic thread of the slave's master
+ */
+class SlaveExchangeBase {
+ public:
+  virtual ~SlaveExchangeBase() = default;
+  /**
+   * @brief cycle - stages the latest command (if there is a new one) and publishes the current reading. Called after every update.
+   */
+  virtual void cycle() = 0;
+};
+
+/**
+ * @brief SlaveExchange - wait-free command/reading exchange between one user thread and the cyclic thread of a slave.
+ * Commands and readings are passed through triple buffers: the user thread never calls into the slave, the cyclic thread never waits for
+ * the user thread. Only the latest command and the latest reading are kept.
+ * Create it with EthercatDeviceConfigurator::addSlaveExchange before startRuntime.
+ * @tparam Device - slave class, needs getReading() and stageCommand(const Command&) or setCommand(const Command&)
+ * @tparam Command - command type of the slave
+ */
+template <typename Device, typename Command>
+class SlaveExchange : public SlaveExchangeBase {
+ public:
+  typedef std::decay_t<decltype(std::declval<Device&>().getReading())> Reading;
+
+  explicit SlaveExchange(std::shared_ptr<Device> device) : m_device(std::move(device)) {}
+
+  /*User thread*/
+
+  /**
+   * @brief setCommand - the command is staged on the slave after the next update of its master. Never blocks.
+   */
+  void setCommand(const Command& command) { m_commands.write(command); }
+  /**
+   * @brief updateReading - fetches the latest reading published by the cyclic thread. Never blocks.
+   * @return true if there is a new reading since the last call
+   */
+  bool updateReading() { return m_readings.update(); }
+  /**
+   * @brief getReading - latest reading fetched by updateReading
+   */
+  const Reading& getReading() const { return m_readings.readBuffer(); }
+
+  const std::shared_ptr<Device>& getDevice() const { return m_device; }
+
+  /*Cyclic thread*/
+
+  void cycle() override {
+    if (m_commands.update()) {
+      stage(*m_device, m_commands.readBuffer());
+    }
+    m_readings.writeBuffer() = m_device->getReading();
+    m_readings.publish();
+  }
+
+ private:
+  template <typename D>
+  static auto stage(D& device, const Command& command) -> decltype(device.stageCommand(command), void()) {
+    device.stageCommand(command);
+  }
+  template <typename D, typename... Dummy>
+  static auto stage(D& device, const Command& command, Dummy...) -> decltype(device.setCommand(command), void()) {
+    device.setCommand(command);
+  }
+
+  std::shared_ptr<Device> m_device;
+  TripleBuffer<Command> m_commands;
+  TripleBuffer<Reading> m_readings;
+};
@@ -0,0 +1,106 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+#include "ethercat_sdk_master/EthercatMaster.hpp"
+
+/**
+ * @brief SlaveView - non-owning, allocation free view on a contiguous range of slaves which are all known to be of type T.
+ * The view is only valid as long as the EthercatDeviceConfigurator it was obtained from is not reconfigured.
+ * Dereferencing uses a static_cast, the configurator guarantees the type. No RTTI, no reference counting.
+ */
+template <typename T>
+class SlaveView {
+ public:
+  typedef std::shared_ptr<ecat_master::EthercatDevice> DevicePtr;
+
+  class Iterator {
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef T* pointer;
+    typedef T& reference;
+
+    Iterator() = default;
+    explicit Iterator(const DevicePtr* it) : m_it(it) {}
+
+    T& operator*() const { return static_cast<T&>(**m_it); }
+    T* operator->() const { return static_cast<T*>(m_it->get()); }
+    T& operator[](difference_type n) const { return static_cast<T&>(*m_it[n]); }
+    Iterator& operator++() {
+      ++m_it;
+      return *this;
+    }
+    Iterator operator++(int) { return Iterator(m_it++); }
+    Iterator& operator--() {
+      --m_it;
+      return *this;
+    }
+    Iterator operator--(int) { return Iterator(m_it--); }
+    Iterator& operator+=(difference_type n) {
+      m_it += n;
+      return *this;
+    }
+    Iterator& operator-=(difference_type n) {
+      m_it -= n;
+      return *this;
+    }
+    Iterator operator+(difference_type n) const { return Iterator(m_it + n); }
+    Iterator operator-(difference_type n) const { return Iterator(m_it - n); }
+    difference_type operator-(const Iterator& other) const { return m_it - other.m_it; }
+    bool operator==(const Iterator& other) const { return m_it == other.m_it; }
+    bool operator!=(const Iterator& other) const { return m_it != other.m_it; }
+    bool operator<(const Iterator& other) const { return m_it < other.m_it; }
+
+   private:
+    const DevicePtr* m_it{nullptr};
+  };
+
+  SlaveView() = default;
+  SlaveView(const DevicePtr* begin, const DevicePtr* end) : m_begin(begin), m_end(end) {}
+
+  Iterator begin() const { return Iterator(m_begin); }
+  Iterator end() const { return Iterator(m_end); }
+  std::size_t size() const { return static_cast<std::size_t>(m_end - m_begin); }
+  bool empty() const { return m_begin == m_end; }
+
+  T& operator[](std::size_t i) const { return static_cast<T&>(*m_begin[i]); }
+
+  /**
+   * @brief shared - get an owning pointer on the i-th slave (increments the reference count, does not allocate)
+   */
+  std::shared_ptr<T> shared(std::size_t i) const {
+    if (i >= size()) throw std::out_of_range("[SlaveView] Index out of range");
+    return std::static_pointer_cast<T>(m_begin[i]);
+  }
+
+ private:
+  const DevicePtr* m_begin{nullptr};
+  const DevicePtr* m_end{nullptr};
+};
@@ -0,0 +1,131 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief StartupProfile - timing tree of the phases of a configurator initialization and bus startup, e.g.
+ *   initializeFromFile > setup > createSlaves > slave Drive1 > deviceFromFile
+ * Recorded by StartupProfiler, returned by EthercatDeviceConfigurator::getStartupProfile.
+ */
+class StartupProfile {
+ public:
+  struct Phase {
+    std::string name{};
+    // What the phase belongs to: "configurator", "bus" or "slave"
+    std::string category{};
+    // Bus or slave name, empty for configurator phases
+    std::string subject{};
+    // Seconds since the start of the profile
+    double start{0.0};
+    double duration{0.0};
+    // False if the phase ended with an exception or a failed startup
+    bool success{true};
+    std::vector<Phase> children{};
+  };
+
+  std::vector<Phase> phases{};
+
+  /**
+   * @brief total - end of the last phase in seconds
+   */
+  double total() const;
+  /**
+   * @brief writeJson - {"total": s, "phases": [{"name", "category", "subject", "start", "duration", "success", "children": [...]}]}
+   */
+  void writeJson(std::ostream& stream) const;
+  std::string toJson() const;
+};
+
+/**
+ * @brief StartupProfiler - records the phases of a StartupProfile. A phase is a child of the innermost Scope of the same profiler on the
+ * recording thread; phases recorded on other threads, e.g. by the threads creating the slaves, get their parent explicitly. Thread safe.
+ */
+class StartupProfiler {
+ public:
+  typedef std::size_t PhaseId;
+  // Parent of the top level phases
+  static constexpr PhaseId root = static_cast<PhaseId>(-1);
+  // Parent: the innermost Scope of the profiler on this thread, root if there is none
+  static constexpr PhaseId inherit = static_cast<PhaseId>(-2);
+
+  // Records a phase from construction to destruction
+  class Scope {
+   public:
+    Scope(StartupProfiler& profiler, std::string name, std::string category = "configurator", std::string subject = "",
+          PhaseId parent = inherit);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    PhaseId id() const { return m_id; }
+    void fail() { m_success = false; }
+
+   private:
+    StartupProfiler& m_profiler;
+    PhaseId m_id;
+    bool m_success{true};
+    // A scope left by an exception marks the phase as failed
+    int m_exceptions{std::uncaught_exceptions()};
+    // Innermost scope of the thread before this one
+    const StartupProfiler* m_outer_profiler;
+    PhaseId m_outer_id;
+  };
+
+  /**
+   * @brief reset - drops all phases, the next phase starts the profile
+   */
+  void reset();
+  PhaseId begin(std::string name, std::string category = "configurator", std::string subject = "", PhaseId parent = inherit);
+  void end(PhaseId id, bool success = true);
+  /**
+   * @brief profile - tree of all recorded phases, phases which did not end yet end now
+   */
+  StartupProfile profile() const;
+
+ private:
+  struct Record {
+    std::string name;
+    std::string category;
+    std::string subject;
+    // Index in m_records, root for top level phases
+    std::size_t parent;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    bool ended;
+    bool success;
+  };
+
+  mutable std::mutex m_mutex;
+  std::vector<Record> m_records;
+  // Ids stay unique across resets: the id of m_records[i] is m_first_id + i
+  PhaseId m_first_id{0};
+  std::chrono::steady_clock::time_point m_start{};
+};
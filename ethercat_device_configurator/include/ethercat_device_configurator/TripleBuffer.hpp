@@ -0,0 +1,87 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief TripleBuffer - wait-free exchange of the latest value between exactly one producer thread and one consumer thread.
+ * The producer writes into writeBuffer() and publishes it, the consumer fetches the latest published value with update().
+ * Neither side ever blocks or allocates, intermediate values are overwritten if the consumer is slower than the producer.
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const T& initial) : m_buffers{initial, initial, initial} {}
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /*Producer*/
+
+  /**
+   * @brief writeBuffer - buffer owned by the producer until publish is called
+   */
+  T& writeBuffer() { return m_buffers[m_write_index]; }
+  /**
+   * @brief publish - makes the write buffer the latest value, the producer gets a new write buffer
+   */
+  void publish() { m_write_index = m_middle.exchange(m_write_index | freshBit, std::memory_order_acq_rel) & indexMask; }
+  /**
+   * @brief write - copies the value into the write buffer and publishes it
+   */
+  void write(const T& value) {
+    writeBuffer() = value;
+    publish();
+  }
+
+  /*Consumer*/
+
+  /**
+   * @brief update - fetches the latest published value, if there is one which was not fetched yet
+   * @return true if readBuffer changed
+   */
+  bool update() {
+    if ((m_middle.load(std::memory_order_relaxed) & freshBit) == 0) return false;
+    m_read_index = m_middle.exchange(m_read_index, std::memory_order_acq_rel) & indexMask;
+    return true;
+  }
+  /**
+   * @brief readBuffer - latest value fetched by update, owned by the consumer
+   */
+  const T& readBuffer() const { return m_buffers[m_read_index]; }
+
+ private:
+  static constexpr uint8_t indexMask = 0x3;
+  static constexpr uint8_t freshBit = 0x4;
+
+  std::array<T, 3> m_buffers{};
+  // Only touched by the producer
+  alignas(64) uint8_t m_write_index{0};
+  // Index of the middle buffer and whether it holds a value the consumer has not fetched yet
+  alignas(64) std::atomic<uint8_t> m_middle{1};
+  // Only touched by the consumer
+  alignas(64) uint8_t m_read_index{2};
+};
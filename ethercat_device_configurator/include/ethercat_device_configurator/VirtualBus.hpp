@@ -0,0 +1,104 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ethercat_device_configurator/VirtualDevice.hpp"
+
+/**
+ * @brief VirtualBus - loopback replacement of an EtherCAT bus, selected with a virtual_bus entry of a master in the setup.yaml.
+ * Every update() sends one frame to all attached VirtualDevices, with configurable latency, jitter and working counter faults.
+ * In simulated time mode update() never sleeps, the bus time advances by one time step per update instead. Loops can then run faster
+ * than real time and, with a fixed seed, are deterministic.
+ */
+class VirtualBus {
+ public:
+  struct Configuration {
+    // Round trip time of a frame [s]
+    double latency{50e-6};
+    // Standard deviation of the round trip time [s]
+    double jitter{0.0};
+    // Probability that a device does not process a frame
+    double working_counter_error_rate{0.0};
+    // Do not sleep, advance the bus time by time_step per update. The cyclic thread then runs without realtime priority.
+    bool simulated_time{false};
+    // Seed of the latency and fault generator
+    uint64_t seed{0};
+  };
+
+  struct Statistics {
+    uint64_t frames{0};
+    // Frames which were not processed by all devices
+    uint64_t working_counter_errors{0};
+  };
+
+  VirtualBus(std::string name, double time_step, const Configuration& configuration);
+
+  /**
+   * @brief attachDevice - must be called before startup
+   */
+  void attachDevice(const std::shared_ptr<VirtualDevice>& device);
+  /**
+   * @brief startup - calls startup on all devices
+   * @return false if a device failed or the startup was aborted
+   */
+  bool startup(std::atomic<bool>& abort_flag);
+  /**
+   * @brief update - exchanges one frame with all devices. Does not allocate.
+   */
+  void update();
+  void shutdown();
+
+  const std::string& getName() const { return m_name; }
+  const Configuration& getConfiguration() const { return m_configuration; }
+  double getTimeStep() const { return m_time_step; }
+  const std::vector<std::shared_ptr<VirtualDevice>>& getDevices() const { return m_devices; }
+  /**
+   * @brief getTime - bus time in ns: simulated time in simulated time mode, CLOCK_MONOTONIC otherwise
+   */
+  int64_t getTime() const;
+  Statistics getStatistics() const;
+
+ private:
+  // Round trip time of the next frame in ns
+  int64_t sampleLatency();
+
+  std::string m_name;
+  double m_time_step;
+  Configuration m_configuration;
+  std::vector<std::shared_ptr<VirtualDevice>> m_devices;
+
+  std::mt19937_64 m_generator;
+  std::normal_distribution<double> m_jitter_distribution;
+  std::bernoulli_distribution m_fault_distribution;
+
+  std::atomic<int64_t> m_simulated_time{0};
+  std::atomic<uint64_t> m_frames{0};
+  std::atomic<uint64_t> m_working_counter_errors{0};
+};
@@ -0,0 +1,106 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ethercat_sdk_master/EthercatMaster.hpp>
+
+/**
+ * @brief VirtualDevice - simulated slave for hardware free testing, attached to a VirtualBus.
+ * The PDO exchange is a loopback: the reading reports the command which was sent loopback_delay_cycles frames earlier.
+ * Commands and readings can be accessed from any thread, like the ones of the SDK drives.
+ */
+class VirtualDevice : public ecat_master::EthercatDevice {
+ public:
+  // Rx PDO
+  struct Command {
+    double position{0.0};
+    double velocity{0.0};
+    double torque{0.0};
+  };
+  // Tx PDO
+  struct Reading {
+    double position{0.0};
+    double velocity{0.0};
+    double torque{0.0};
+    // Number of frames received by the device
+    uint64_t cycle{0};
+    // Bus time (real or simulated, ns) at which the frame was received
+    int64_t stamp{0};
+  };
+
+  VirtualDevice(const std::string& name, uint32_t address);
+
+  /**
+   * @brief deviceFromFile - creates a device and loads its configuration file
+   * @throw std::runtime_error if the configuration file cannot be loaded
+   */
+  static std::shared_ptr<VirtualDevice> deviceFromFile(const std::string& configFile, const std::string& name, uint32_t address);
+
+  /**
+   * @brief loadConfigFile - optional keys: loopback_delay_cycles (default 1)
+   */
+  bool loadConfigFile(const std::string& fileName) override;
+
+  bool startup() override;
+  void updateWrite() override;
+  void updateRead() override;
+  void shutdown() override;
+  PdoInfo getCurrentPdoInfo() const override;
+
+  void stageCommand(const Command& command);
+  Reading getReading() const;
+  // Command which is sent with the next frame
+  Command getStagedCommand() const;
+
+  /**
+   * @brief transferFrame - called by the VirtualBus between updateWrite and updateRead
+   * @param stamp - bus time at which the frame arrives
+   * @param lost - the device did not process the frame (working counter too low), the reading keeps its old value
+   */
+  void transferFrame(int64_t stamp, bool lost);
+
+  uint64_t getWorkingCounterErrors() const;
+
+ private:
+  mutable std::mutex m_mutex;
+  unsigned int m_loopback_delay_cycles{1};
+
+  // Guarded by m_mutex
+  Command m_staged_command{};
+  Reading m_reading{};
+
+  // Only touched by the bus thread
+  // Commands in flight, ring buffer of loopback_delay_cycles + 1 entries
+  std::vector<Command> m_in_flight{};
+  std::size_t m_in_flight_index{0};
+  Reading m_received{};
+  bool m_received_valid{false};
+  std::atomic<uint64_t> m_working_counter_errors{0};
+};
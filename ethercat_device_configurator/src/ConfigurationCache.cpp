@@ -0,0 +1,190 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/ConfigurationCache.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+/*std*/
+#if __GNUC__ < 8
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+static int64_t modification_time(const std::string& path) {
+  std::error_code error;
+  auto time = fs::last_write_time(path, error);
+  if (error) throw std::runtime_error("[ConfigurationCache] Could not read modification time of: " + path + " (" + error.message() + ")");
+  return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// false if the file does not exist (anymore)
+static bool modification_time(const std::string& path, int64_t& time) {
+  std::error_code error;
+  auto write_time = fs::last_write_time(path, error);
+  if (error) return false;
+  time = static_cast<int64_t>(write_time.time_since_epoch().count());
+  return true;
+}
+
+ConfigurationCache::Document::Document(std::string path, int64_t modificationTime, std::string content)
+    : m_path(std::move(path)),
+      m_modification_time(modificationTime),
+      m_content(std::move(content)),
+      m_hash(ConfigurationCache::hash(m_content)) {}
+
+YAML::Node ConfigurationCache::Document::node() const {
+  std::call_once(m_parse_flag, [this]() { m_node = YAML::Load(m_content); });
+  // Cloning is much cheaper than parsing, and m_node is never accessed by more than a clone
+  return YAML::Clone(m_node);
+}
+
+ConfigurationCache& ConfigurationCache::instance() {
+  static ConfigurationCache cache;
+  return cache;
+}
+
+std::string ConfigurationCache::resolvePath(const std::string& path, const std::string& setup_file_path, std::string* canonical_path) {
+  if (path.empty()) throw std::runtime_error("[ConfigurationCache] Empty configuration file path");
+
+  const std::string setup_directory = setup_file_path.substr(0, setup_file_path.find_last_of("/") + 1);
+  const std::string key = setup_directory + '\n' + path;
+  ResolvedPath cached;
+  if (findResolvedPath(key, cached)) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.path_hits++;
+    if (canonical_path) *canonical_path = std::move(cached.canonical_path);
+    return cached.path;
+  }
+
+  std::string result_path = "";
+  if (path.front() == '/') {
+    result_path = path;
+    // Path to the configuration file is absolute, we can use it as is.
+  } else if (path.front() == '~') {
+    // Path to the configuration file is absolute, we need to replace '~' with the home directory.
+    const char* homeDirectory = getenv("HOME");
+    if (homeDirectory == nullptr) throw std::runtime_error("[ConfigurationCache] Environment variable 'HOME' could not be evaluated.");
+    result_path = path;
+    result_path.erase(result_path.begin());
+    result_path = homeDirectory + result_path;
+  } else {
+    // Path to the configuration file is relative, we need to append it to the path of the setup file.
+    result_path = setup_directory + path;
+  }
+  std::error_code error;
+  std::string canonical = fs::canonical(result_path, error).string();
+  int64_t time = 0;
+  if (error || !modification_time(canonical, time)) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_resolved_paths.erase(key);
+    throw std::runtime_error("Path: " + result_path + " does not exist");
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_statistics.path_misses++;
+  m_resolved_paths[key] = {result_path, canonical, time};
+  if (canonical_path) *canonical_path = std::move(canonical);
+  return result_path;
+}
+
+bool ConfigurationCache::resolvedModificationTime(const std::string& path, const std::string& setup_file_path,
+                                                  int64_t& modification_time) const {
+  const std::string setup_directory = setup_file_path.substr(0, setup_file_path.find_last_of("/") + 1);
+  ResolvedPath resolved;
+  if (!findResolvedPath(setup_directory + '\n' + path, resolved)) return false;
+  modification_time = resolved.modification_time;
+  return true;
+}
+
+bool ConfigurationCache::findResolvedPath(const std::string& key, ResolvedPath& resolved) const {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_resolved_paths.find(key);
+    if (it == m_resolved_paths.end()) return false;
+    resolved = it->second;
+  }
+  // One stat instead of resolving every path component, a deleted or replaced file is resolved again
+  int64_t time = 0;
+  return modification_time(resolved.canonical_path, time) && time == resolved.modification_time;
+}
+
+ConfigurationCache::DocumentPtr ConfigurationCache::load(const std::string& path) {
+  std::error_code error;
+  const std::string canonical_path = fs::canonical(path, error).string();
+  if (error) throw std::runtime_error("[ConfigurationCache] File not found: " + path);
+  // A directory opens and reads like an empty file
+  if (!fs::is_regular_file(canonical_path, error)) throw std::runtime_error("[ConfigurationCache] Not a regular file: " + path);
+  const int64_t time = modification_time(canonical_path);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_documents.find(canonical_path);
+    if (it != m_documents.end() && it->second->modificationTime() == time) {
+      m_statistics.document_hits++;
+      return it->second;
+    }
+  }
+
+  // Read outside of the lock, concurrent misses on the same file read it twice but both get a valid document.
+  std::ifstream file(canonical_path, std::ios::binary);
+  if (!file) throw std::runtime_error("[ConfigurationCache] Could not open: " + canonical_path);
+  std::ostringstream content;
+  content << file.rdbuf();
+  if (file.bad()) throw std::runtime_error("[ConfigurationCache] Could not read: " + canonical_path);
+  auto document = std::make_shared<const Document>(canonical_path, time, content.str());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_statistics.document_misses++;
+  m_documents[canonical_path] = document;
+  return document;
+}
+
+void ConfigurationCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_resolved_paths.clear();
+  m_documents.clear();
+}
+
+ConfigurationCache::Statistics ConfigurationCache::getStatistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_statistics;
+}
+
+uint64_t ConfigurationCache::hash(const std::string& data) {
+  return hash(data.data(), data.size());
+}
+
+uint64_t ConfigurationCache::hash(const char* data, std::size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
@@ -0,0 +1,93 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/CycleHistogram.hpp"
+
+#include <algorithm>
+#include <limits>
+
+void CycleHistogram::reset() {
+  for (auto& bucket : m_buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  m_overflow.store(0, std::memory_order_relaxed);
+  m_count.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+int64_t CycleHistogram::min() const {
+  if (count() == 0) return 0;
+  return static_cast<int64_t>(m_min.load(std::memory_order_relaxed));
+}
+
+int64_t CycleHistogram::max() const {
+  return static_cast<int64_t>(m_max.load(std::memory_order_relaxed));
+}
+
+double CycleHistogram::mean() const {
+  const uint64_t samples = count();
+  if (samples == 0) return 0.0;
+  return static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(samples);
+}
+
+int64_t CycleHistogram::percentile(double percentile) const {
+  // Sum the buckets instead of using m_count, the buckets may be ahead while a value is recorded concurrently.
+  uint64_t total = m_overflow.load(std::memory_order_relaxed);
+  for (const auto& bucket : m_buckets) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  if (total == 0) return 0;
+
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5));
+  uint64_t accumulated = 0;
+  for (std::size_t i = 0; i < numberOfBuckets; i++) {
+    accumulated += m_buckets[i].load(std::memory_order_relaxed);
+    if (accumulated >= rank) {
+      return std::min(static_cast<int64_t>(bucketUpperBound(i)), max());
+    }
+  }
+  // The rank lies in the overflow counter
+  return overflowValue;
+}
+
+uint64_t CycleHistogram::countAbove(int64_t nanoseconds) const {
+  const uint64_t threshold = nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0;
+  const std::size_t threshold_index = bucketIndex(threshold);
+  if (threshold_index == overflowIndex) return 0;
+  uint64_t result = m_overflow.load(std::memory_order_relaxed);
+  for (std::size_t i = threshold_index + 1; i < numberOfBuckets; i++) {
+    result += m_buckets[i].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+uint64_t CycleHistogram::bucketUpperBound(std::size_t index) {
+  if (index < subBucketCount) return index;
+  if (index >= overflowIndex) return std::numeric_limits<uint64_t>::max();
+  const std::size_t exponent = (index - subBucketCount) / subBucketCount + subBucketBits;
+  const uint64_t mantissa = (index - subBucketCount) % subBucketCount;
+  const uint64_t width = uint64_t{1} << (exponent - subBucketBits);
+  return (uint64_t{1} << exponent) + mantissa * width + width - 1;
+}
@@ -0,0 +1,375 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/CycleRecorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+/*std*/
+#if __GNUC__ < 8
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+/*posix*/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t clock_time(clockid_t clock) {
+  timespec now{};
+  clock_gettime(clock, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Local time, names the recordings
+static std::string local_time_stamp() {
+  const std::time_t now = std::time(nullptr);
+  std::tm local{};
+  localtime_r(&now, &local);
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+  return stamp;
+}
+
+// Recorded size of a slave in a frame
+static std::size_t slave_size(const CycleRecordSlave& slave) {
+  return sharedMemoryDataSize(slave.reading_layout) + sharedMemoryDataSize(slave.command_layout);
+}
+
+CycleRecorder::CycleRecorder(const Configuration& configuration, const std::string& ethercat_bus, std::vector<Slave> slaves)
+    : m_configuration(configuration) {
+  if (m_configuration.number_of_files == 0) throw std::runtime_error("[CycleRecorder] number_of_files has to be at least 1");
+  if (m_configuration.buffer_frames == 0) throw std::runtime_error("[CycleRecorder] buffer_frames has to be at least 1");
+  if (!(m_configuration.flush_period > 0.0)) throw std::runtime_error("[CycleRecorder] flush_period has to be positive");
+  if (ethercat_bus.size() >= sizeof(CycleRecordFileHeader::ethercat_bus)) {
+    throw std::runtime_error("[CycleRecorder] Bus name too long: " + ethercat_bus);
+  }
+
+  CycleRecordFileHeader header;
+  std::memcpy(header.ethercat_bus, ethercat_bus.c_str(), ethercat_bus.size() + 1);
+  header.realtime_offset = clock_time(CLOCK_REALTIME) - clock_time(CLOCK_MONOTONIC);
+  std::vector<CycleRecordSlave> table;
+  std::size_t frame_size = sizeof(CycleRecordFrameHeader);
+  for (auto& slave : slaves) {
+    if (slave.adapter.reading_layout == SharedMemoryDataLayout::None) continue;
+    CycleRecordSlave entry;
+    if (slave.name.size() >= sizeof(entry.name) || slave.type_name.size() >= sizeof(entry.type_name)) {
+      throw std::runtime_error("[CycleRecorder] Slave or type name too long: " + slave.name);
+    }
+    std::memcpy(entry.name, slave.name.c_str(), slave.name.size() + 1);
+    std::memcpy(entry.type_name, slave.type_name.c_str(), slave.type_name.size() + 1);
+    entry.ethercat_address = slave.ethercat_address;
+    entry.handle = static_cast<uint32_t>(slave.handle);
+    entry.reading_layout = slave.adapter.reading_layout;
+    if (slave.adapter.staged) entry.command_layout = slave.adapter.command_layout;
+    frame_size += slave_size(entry);
+    table.push_back(entry);
+    m_slaves.push_back(std::move(slave));
+  }
+  m_frame_size = (frame_size + 7) & ~static_cast<std::size_t>(7);
+  m_frames_offset = (sizeof(CycleRecordFileHeader) + table.size() * sizeof(CycleRecordSlave) + 63) & ~static_cast<std::size_t>(63);
+  if (m_configuration.file_size < m_frames_offset + 2 * m_frame_size) {
+    throw std::runtime_error("[CycleRecorder] file_size " + std::to_string(m_configuration.file_size) +
+                             " too small for the frames of bus " + ethercat_bus);
+  }
+  m_frames_per_file = (m_configuration.file_size - m_frames_offset) / m_frame_size;
+  header.slave_count = static_cast<uint32_t>(table.size());
+  header.file_size = m_configuration.file_size;
+  header.frame_size = m_frame_size;
+  header.frames_offset = m_frames_offset;
+
+  // Anonymous memory: once populated, the writes of the cyclic thread never fault (file pages fault again after their writeback)
+  const std::size_t buffer_size = m_configuration.buffer_frames * m_frame_size;
+  void* buffer = ::mmap(nullptr, buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (buffer == MAP_FAILED) {
+    throw std::runtime_error("[CycleRecorder] Could not map the frame buffer: " + std::string(std::strerror(errno)));
+  }
+  m_buffer = std::make_unique<Mapping>(static_cast<char*>(buffer), buffer_size, false);
+  if (m_configuration.lock_memory && ::mlock(buffer, buffer_size) != 0) {
+    throw std::runtime_error("[CycleRecorder] Could not lock the frame buffer in memory: " + std::string(std::strerror(errno)));
+  }
+
+  std::error_code error;
+  fs::create_directories(m_configuration.directory, error);
+  // A new recording per recorder: a process restarted after a failure keeps the recording of the failure
+  const std::string stamp = local_time_stamp();
+  m_recording = stamp;
+  for (unsigned int attempt = 1;; attempt++) {
+    bool exists = false;
+    for (unsigned int index = 0; index < m_configuration.number_of_files && !exists; index++) {
+      exists = fs::exists(filePath(m_configuration.directory, ethercat_bus, m_recording, index), error);
+    }
+    if (!exists) break;
+    m_recording = stamp + "-" + std::to_string(attempt);
+  }
+  try {
+    for (unsigned int index = 0; index < m_configuration.number_of_files; index++) {
+      const auto path = filePath(m_configuration.directory, ethercat_bus, m_recording, index);
+      int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+      if (fd < 0) throw std::runtime_error("[CycleRecorder] Could not create " + path + ": " + std::strerror(errno));
+      m_file_paths.push_back(path);
+      // Allocates the blocks: a full disk fails here instead of with SIGBUS in the flusher thread
+      const int result = ::posix_fallocate(fd, 0, static_cast<off_t>(m_configuration.file_size));
+      if (result != 0) {
+        ::close(fd);
+        throw std::runtime_error("[CycleRecorder] Could not allocate " + path + ": " + std::strerror(result));
+      }
+      void* data = ::mmap(nullptr, m_configuration.file_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) throw std::runtime_error("[CycleRecorder] Could not map " + path);
+      m_files.emplace_back(static_cast<char*>(data), m_configuration.file_size, true);
+      std::memcpy(m_files.back().data, &header, sizeof(header));
+      std::memcpy(m_files.back().data + sizeof(header), table.data(), table.size() * sizeof(CycleRecordSlave));
+    }
+  } catch (...) {
+    // Nothing was recorded into the files created so far, the mappings are released with m_files
+    for (const auto& path : m_file_paths) fs::remove(path, error);
+    throw;
+  }
+  // The first frame starts the first file
+  m_file_index = m_files.size() - 1;
+  m_frame_index = m_frames_per_file;
+
+  m_flusher = std::thread([this]() {
+    const auto period = std::chrono::duration<double>(m_configuration.flush_period);
+    while (!m_stop.load(std::memory_order_acquire)) {
+      flush();
+      std::this_thread::sleep_for(period);
+    }
+    flush();
+  });
+}
+
+std::vector<std::shared_ptr<CycleRecorder>> CycleRecorder::attach(EthercatDeviceConfigurator& configurator,
+                                                                 const Configuration& configuration) {
+  if (configurator.isRuntimeRunning()) throw std::runtime_error("[CycleRecorder] Recorders can only be attached while not running");
+  auto& registry = DeviceFactoryRegistry::instance();
+  const auto& masters = configurator.getMasters();
+  std::vector<std::vector<Slave>> master_slaves(masters.size());
+  for (EthercatDeviceConfigurator::SlaveHandle handle = 0; handle < configurator.getSlaves().size(); handle++) {
+    const auto& entry = configurator.getInfoForSlave(handle);
+    Slave slave;
+    slave.name = entry.name;
+    slave.type_name = entry.type_name;
+    slave.ethercat_address = entry.ethercat_address;
+    slave.handle = handle;
+    slave.device = configurator.getSlaveByHandle(handle);
+    if (auto adapter = registry.getProcessDataAdapter(entry.type_name)) slave.adapter = std::move(*adapter);
+    master_slaves[configurator.getMasterIndex(handle)].push_back(std::move(slave));
+  }
+  std::vector<std::shared_ptr<CycleRecorder>> recorders;
+  for (std::size_t master = 0; master < masters.size(); master++) {
+    const auto& virtual_bus = configurator.getVirtualBus(master);
+    const auto bus = virtual_bus ? virtual_bus->getName() : masters[master]->getConfiguration().networkInterface;
+    recorders.push_back(std::make_shared<CycleRecorder>(configuration, bus, std::move(master_slaves[master])));
+  }
+  // Callbacks only after all files could be created
+  for (std::size_t master = 0; master < masters.size(); master++) {
+    configurator.addCycleCallback(master, [recorder = recorders[master]]() { recorder->cycle(); });
+  }
+  return recorders;
+}
+
+CycleRecorder::Mapping::~Mapping() {
+  if (!data) return;
+  if (file) ::msync(data, size, MS_ASYNC);
+  ::munmap(data, size);
+}
+
+CycleRecorder::~CycleRecorder() {
+  m_stop.store(true, std::memory_order_release);
+  if (m_flusher.joinable()) m_flusher.join();
+}
+
+std::string CycleRecorder::filePath(const std::string& directory, const std::string& ethercat_bus, const std::string& recording,
+                                    unsigned int index) {
+  return (fs::path(directory) / (ethercat_bus + "_" + recording + "_" + std::to_string(index) + ".cyclerec")).string();
+}
+
+void CycleRecorder::rotate() {
+  if (m_sequence > 0) m_rotations.fetch_add(1, std::memory_order_relaxed);
+  m_file_index = (m_file_index + 1) % m_files.size();
+  m_frame_index = 0;
+  char* data = m_files[m_file_index].data;
+  // The old content of the file ends before the first frame
+  reinterpret_cast<CycleRecordFrameHeader*>(data + m_frames_offset)->cycle = 0;
+  reinterpret_cast<CycleRecordFileHeader*>(data)->sequence = ++m_sequence;
+}
+
+void CycleRecorder::cycle() {
+  m_cycle++;
+  const uint64_t buffered = m_buffered.load(std::memory_order_relaxed);
+  if (buffered - m_flushed.load(std::memory_order_acquire) == m_configuration.buffer_frames) {
+    m_frames_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  char* frame = m_buffer->data + (buffered % m_configuration.buffer_frames) * m_frame_size;
+
+  char* payload = frame + sizeof(CycleRecordFrameHeader);
+  for (const auto& slave : m_slaves) {
+    slave.adapter.read(*slave.device, payload);
+    payload += sharedMemoryDataSize(slave.adapter.reading_layout);
+    if (slave.adapter.staged) {
+      slave.adapter.staged(*slave.device, payload);
+      payload += sharedMemoryDataSize(slave.adapter.command_layout);
+    }
+  }
+  auto* header = reinterpret_cast<CycleRecordFrameHeader*>(frame);
+  header->stamp = clock_time(CLOCK_MONOTONIC);
+  header->cycle = m_cycle;
+  // Hands the frame to the flusher
+  m_buffered.store(buffered + 1, std::memory_order_release);
+}
+
+void CycleRecorder::flush() {
+  const uint64_t buffered = m_buffered.load(std::memory_order_acquire);
+  for (uint64_t index = m_flushed.load(std::memory_order_relaxed); index < buffered; index++) {
+    writeFrame(m_buffer->data + (index % m_configuration.buffer_frames) * m_frame_size);
+    // Returns the slot to the cyclic thread
+    m_flushed.store(index + 1, std::memory_order_release);
+  }
+}
+
+void CycleRecorder::writeFrame(const char* frame) {
+  if (m_frame_index == m_frames_per_file) rotate();
+  char* destination = m_files[m_file_index].data + m_frames_offset + m_frame_index * m_frame_size;
+  // End marker first and the frame header last, a crash leaves a readable file
+  if (m_frame_index + 1 < m_frames_per_file) reinterpret_cast<CycleRecordFrameHeader*>(destination + m_frame_size)->cycle = 0;
+  constexpr std::size_t header_size = sizeof(CycleRecordFrameHeader);
+  std::memcpy(destination + header_size, frame + header_size, m_frame_size - header_size);
+  std::memcpy(destination, frame, header_size);
+  m_frame_index++;
+  m_frames_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+CycleRecording CycleRecording::read(const std::vector<std::string>& paths) {
+  CycleRecording recording;
+  // (sequence, frames of the file)
+  std::vector<std::pair<uint64_t, std::vector<char>>> files;
+  bool first = true;
+  for (const auto& path : paths) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) throw std::runtime_error("[CycleRecording] Could not open: " + path);
+    std::vector<char> content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    CycleRecordFileHeader header;
+    if (content.size() < sizeof(header)) throw std::runtime_error("[CycleRecording] No cycle record: " + path);
+    std::memcpy(&header, content.data(), sizeof(header));
+    if (header.magic != CycleRecordFileHeader::formatMagic) throw std::runtime_error("[CycleRecording] No cycle record: " + path);
+    if (header.version != CycleRecordFileHeader::formatVersion) {
+      throw std::runtime_error("[CycleRecording] " + path + " has format version " + std::to_string(header.version) + ", expected " +
+                               std::to_string(CycleRecordFileHeader::formatVersion));
+    }
+    if (header.frame_size < sizeof(CycleRecordFrameHeader) || header.frames_offset > content.size() ||
+        header.frames_offset < sizeof(header) + header.slave_count * sizeof(CycleRecordSlave)) {
+      throw std::runtime_error("[CycleRecording] Corrupt header: " + path);
+    }
+    std::vector<CycleRecordSlave> slaves(header.slave_count);
+    std::memcpy(slaves.data(), content.data() + sizeof(header), slaves.size() * sizeof(CycleRecordSlave));
+    if (first) {
+      recording.ethercat_bus = header.ethercat_bus;
+      recording.realtime_offset = header.realtime_offset;
+      recording.slaves = slaves;
+      recording.frame_size = header.frame_size;
+      first = false;
+    } else if (recording.ethercat_bus != header.ethercat_bus || recording.realtime_offset != header.realtime_offset ||
+               recording.frame_size != header.frame_size) {
+      throw std::runtime_error("[CycleRecording] " + path + " belongs to another recording");
+    }
+    if (header.sequence == 0) continue;
+
+    std::vector<char> frames;
+    for (std::size_t offset = header.frames_offset; offset + header.frame_size <= content.size(); offset += header.frame_size) {
+      CycleRecordFrameHeader frame;
+      std::memcpy(&frame, content.data() + offset, sizeof(frame));
+      if (frame.cycle == 0) break;
+      frames.insert(frames.end(), content.data() + offset, content.data() + offset + header.frame_size);
+    }
+    files.emplace_back(header.sequence, std::move(frames));
+  }
+  std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (const auto& file : files) {
+    recording.frames.insert(recording.frames.end(), file.second.begin(), file.second.end());
+  }
+  return recording;
+}
+
+void CycleRecording::writeCsv(std::ostream& stream) const {
+  static const char* drive_columns[] = {"position", "velocity", "torque", "current", "state"};
+  static const char* command_columns[] = {"command_position", "command_velocity", "command_torque", "command_current", "command_mode"};
+  static const char* force_torque_columns[] = {"force_x", "force_y", "force_z", "torque_x", "torque_y", "torque_z"};
+
+  stream << "cycle,stamp,time";
+  for (const auto& slave : slaves) {
+    const std::string prefix = std::string(",") + slave.name + "/";
+    if (slave.reading_layout == SharedMemoryDataLayout::Drive) {
+      for (const auto* column : drive_columns) stream << prefix << column;
+    } else if (slave.reading_layout == SharedMemoryDataLayout::ForceTorque) {
+      for (const auto* column : force_torque_columns) stream << prefix << column;
+    }
+    if (slave.command_layout == SharedMemoryDataLayout::DriveCommand) {
+      for (const auto* column : command_columns) stream << prefix << column;
+    }
+  }
+  stream << "\n" << std::setprecision(17);
+
+  for (std::size_t i = 0; i < numberOfFrames(); i++) {
+    const char* frame = frames.data() + i * frame_size;
+    CycleRecordFrameHeader header;
+    std::memcpy(&header, frame, sizeof(header));
+    stream << header.cycle << "," << header.stamp << "," << static_cast<double>(header.stamp + realtime_offset) * 1e-9;
+    const char* payload = frame + sizeof(header);
+    for (const auto& slave : slaves) {
+      if (slave.reading_layout == SharedMemoryDataLayout::Drive) {
+        SharedMemoryDriveReading reading;
+        std::memcpy(&reading, payload, sizeof(reading));
+        stream << "," << reading.position << "," << reading.velocity << "," << reading.torque << "," << reading.current << ","
+               << reading.state;
+      } else if (slave.reading_layout == SharedMemoryDataLayout::ForceTorque) {
+        SharedMemoryForceTorqueReading reading;
+        std::memcpy(&reading, payload, sizeof(reading));
+        for (const double value : reading.force) stream << "," << value;
+        for (const double value : reading.torque) stream << "," << value;
+      }
+      payload += sharedMemoryDataSize(slave.reading_layout);
+      if (slave.command_layout == SharedMemoryDataLayout::DriveCommand) {
+        SharedMemoryDriveCommand command;
+        std::memcpy(&command, payload, sizeof(command));
+        stream << "," << command.position << "," << command.velocity << "," << command.torque << "," << command.current << ","
+               << command.mode;
+      }
+      payload += sharedMemoryDataSize(slave.command_layout);
+    }
+    stream << "\n";
+  }
+}
@@ -0,0 +1,266 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+#include "ethercat_device_configurator/VirtualDevice.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+/*posix*/
+#include <dlfcn.h>
+
+#ifdef _STATIC_DEVICE_FACTORIES_
+// The sdk factories are linked into the library instead of being plugins
+#ifdef _ELMO_FOUND_
+void registerElmoFactories(DeviceFactoryRegistry& registry);
+#endif
+#ifdef _MPSDRIVE_FOUND_
+void registerMPSDriveFactories(DeviceFactoryRegistry& registry);
+#endif
+#ifdef _MAXON_FOUND_
+void registerMaxonFactories(DeviceFactoryRegistry& registry);
+#endif
+#ifdef _ANYDRIVE_FOUND_
+void registerAnydriveFactories(DeviceFactoryRegistry& registry);
+#endif
+#ifdef _ROKUBI_FOUND_
+void registerRokubiFactories(DeviceFactoryRegistry& registry);
+#endif
+#ifdef _EK1100_FOUND_
+void registerEK1100Factories(DeviceFactoryRegistry& registry);
+#endif
+#ifdef _EL3102_FOUND_
+void registerEL3102Factories(DeviceFactoryRegistry& registry);
+#endif
+#endif
+
+typedef void (*RegisterFunction)(DeviceFactoryRegistry&);
+
+DeviceFactoryRegistry::DeviceFactoryRegistry() {
+  // Part of this library, always available
+  m_factories.emplace("Virtual", [](const EthercatDeviceConfigurator::EthercatSlaveEntry& entry, const std::string& path) {
+    if (path.empty()) return std::make_shared<VirtualDevice>(entry.name, entry.ethercat_address);
+    return VirtualDevice::deviceFromFile(path, entry.name, entry.ethercat_address);
+  });
+  ProcessDataAdapter virtual_adapter;
+  virtual_adapter.reading_layout = SharedMemoryDataLayout::Drive;
+  virtual_adapter.command_layout = SharedMemoryDataLayout::DriveCommand;
+  virtual_adapter.read = [](ecat_master::EthercatDevice& device, void* data) {
+    const auto reading = static_cast<VirtualDevice&>(device).getReading();
+    auto& drive = *static_cast<SharedMemoryDriveReading*>(data);
+    drive.position = reading.position;
+    drive.velocity = reading.velocity;
+    drive.torque = reading.torque;
+  };
+  virtual_adapter.stage = [](ecat_master::EthercatDevice& device, const void* data) {
+    const auto& drive = *static_cast<const SharedMemoryDriveCommand*>(data);
+    VirtualDevice::Command command;
+    command.position = drive.position;
+    command.velocity = drive.velocity;
+    command.torque = drive.torque;
+    static_cast<VirtualDevice&>(device).stageCommand(command);
+  };
+  virtual_adapter.staged = [](ecat_master::EthercatDevice& device, void* data) {
+    const auto command = static_cast<VirtualDevice&>(device).getStagedCommand();
+    auto& drive = *static_cast<SharedMemoryDriveCommand*>(data);
+    drive.position = command.position;
+    drive.velocity = command.velocity;
+    drive.torque = command.torque;
+  };
+  m_process_data_adapters.emplace("Virtual", std::move(virtual_adapter));
+
+#ifdef _STATIC_DEVICE_FACTORIES_
+#ifdef _ELMO_FOUND_
+  registerElmoFactories(*this);
+#endif
+#ifdef _MPSDRIVE_FOUND_
+  registerMPSDriveFactories(*this);
+#endif
+#ifdef _MAXON_FOUND_
+  registerMaxonFactories(*this);
+#endif
+#ifdef _ANYDRIVE_FOUND_
+  registerAnydriveFactories(*this);
+#endif
+#ifdef _ROKUBI_FOUND_
+  registerRokubiFactories(*this);
+#endif
+#ifdef _EK1100_FOUND_
+  registerEK1100Factories(*this);
+#endif
+#ifdef _EL3102_FOUND_
+  registerEL3102Factories(*this);
+#endif
+#endif
+}
+
+DeviceFactoryRegistry& DeviceFactoryRegistry::instance() {
+  static DeviceFactoryRegistry registry;
+  return registry;
+}
+
+void DeviceFactoryRegistry::registerFactory(const std::string& type_name, Factory factory) {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  if (!m_factories.emplace(type_name, std::move(factory)).second) {
+    throw std::runtime_error("[DeviceFactoryRegistry] Factory for device type " + type_name + " registered twice");
+  }
+}
+
+void DeviceFactoryRegistry::registerDriveStateHandler(const std::string& type_name, DriveStateHandler handler) {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  if (!m_drive_state_handlers.emplace(type_name, std::move(handler)).second) {
+    throw std::runtime_error("[DeviceFactoryRegistry] Drive state handler for device type " + type_name + " registered twice");
+  }
+}
+
+std::optional<DeviceFactoryRegistry::DriveStateHandler> DeviceFactoryRegistry::getDriveStateHandler(const std::string& type_name) const {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  auto it = m_drive_state_handlers.find(type_name);
+  if (it == m_drive_state_handlers.end()) return std::nullopt;
+  return it->second;
+}
+
+void DeviceFactoryRegistry::registerProcessDataAdapter(const std::string& type_name, ProcessDataAdapter adapter) {
+  if ((adapter.reading_layout != SharedMemoryDataLayout::None && !adapter.read) ||
+      (adapter.command_layout != SharedMemoryDataLayout::None && !adapter.stage)) {
+    throw std::runtime_error("[DeviceFactoryRegistry] Process data adapter for device type " + type_name + " incomplete");
+  }
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  if (!m_process_data_adapters.emplace(type_name, std::move(adapter)).second) {
+    throw std::runtime_error("[DeviceFactoryRegistry] Process data adapter for device type " + type_name + " registered twice");
+  }
+}
+
+std::optional<DeviceFactoryRegistry::ProcessDataAdapter> DeviceFactoryRegistry::getProcessDataAdapter(const std::string& type_name) const {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  auto it = m_process_data_adapters.find(type_name);
+  if (it == m_process_data_adapters.end()) return std::nullopt;
+  return it->second;
+}
+
+std::shared_ptr<ecat_master::EthercatDevice> DeviceFactoryRegistry::create(const EthercatDeviceConfigurator::EthercatSlaveEntry& entry,
+                                                                             const std::string& configuration_file_path) {
+  Factory factory;
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    std::string error;
+    auto it = findFactoryLocked(entry.type_name, error);
+    if (it == m_factories.end()) {
+      throw std::runtime_error("[DeviceFactoryRegistry] No factory for device type " + entry.type_name +
+                               (error.empty() ? std::string() : " (" + error + ")"));
+    }
+    factory = it->second;
+  }
+  auto device = factory(entry, configuration_file_path);
+  if (!device) throw std::runtime_error("[DeviceFactoryRegistry] Factory for device type " + entry.type_name + " returned no device");
+  return device;
+}
+
+bool DeviceFactoryRegistry::providesType(const std::string& type_name) {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  std::string error;
+  return findFactoryLocked(type_name, error) != m_factories.end();
+}
+
+std::unordered_map<std::string, DeviceFactoryRegistry::Factory>::const_iterator DeviceFactoryRegistry::findFactoryLocked(
+    const std::string& type_name, std::string& error) {
+  auto it = m_factories.find(type_name);
+  if (it != m_factories.end()) return it;
+  auto plugin_error = m_plugin_errors.find(type_name);
+  if (plugin_error == m_plugin_errors.end()) {
+    // First use of this type, load its plugin
+    try {
+      loadPluginLocked(pluginLibraryName(type_name));
+    } catch (const std::exception& e) {
+      plugin_error = m_plugin_errors.emplace(type_name, e.what()).first;
+    }
+    it = m_factories.find(type_name);
+  }
+  if (it == m_factories.end() && plugin_error != m_plugin_errors.end()) error = plugin_error->second;
+  return it;
+}
+
+void DeviceFactoryRegistry::loadPlugin(const std::string& library) {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  loadPluginLocked(library);
+}
+
+void DeviceFactoryRegistry::loadPluginLocked(const std::string& library) {
+  std::vector<std::string> candidates;
+  if (library.find('/') == std::string::npos) {
+    if (const char* search_path = std::getenv("ETHERCAT_DEVICE_PLUGIN_PATH")) {
+      std::istringstream directories(search_path);
+      std::string directory;
+      while (std::getline(directories, directory, ':')) {
+        if (!directory.empty()) candidates.push_back(directory + "/" + library);
+      }
+    }
+    // Plugins are built and installed next to this library
+    Dl_info info{};
+    if (dladdr(reinterpret_cast<void*>(&DeviceFactoryRegistry::instance), &info) != 0 && info.dli_fname != nullptr) {
+      const std::string self = info.dli_fname;
+      const auto separator = self.find_last_of('/');
+      if (separator != std::string::npos) candidates.push_back(self.substr(0, separator + 1) + library);
+    }
+  }
+  // Default search path (LD_LIBRARY_PATH, rpath, ...)
+  candidates.push_back(library);
+
+  void* handle = nullptr;
+  std::string errors;
+  for (const auto& candidate : candidates) {
+    handle = dlopen(candidate.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle) break;
+    errors += std::string("\n  ") + dlerror();
+  }
+  if (!handle) throw std::runtime_error("[DeviceFactoryRegistry] Could not load device plugin " + library + ":" + errors);
+
+  auto register_function = reinterpret_cast<RegisterFunction>(dlsym(handle, ETHERCAT_DEVICE_PLUGIN_SYMBOL));
+  if (!register_function) {
+    dlclose(handle);
+    throw std::runtime_error("[DeviceFactoryRegistry] " + library + " is no device plugin, " ETHERCAT_DEVICE_PLUGIN_SYMBOL " missing");
+  }
+  m_plugin_handles.push_back(handle);
+  // The plugin calls registerFactory on this thread, m_mutex is recursive.
+  register_function(*this);
+}
+
+std::vector<std::string> DeviceFactoryRegistry::getRegisteredTypes() const {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  std::vector<std::string> types;
+  types.reserve(m_factories.size());
+  for (const auto& factory : m_factories) {
+    types.push_back(factory.first);
+  }
+  std::sort(types.begin(), types.end());
+  return types;
+}
+
+std::string DeviceFactoryRegistry::pluginLibraryName(const std::string& type_name) {
+  std::string lower = type_name;
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return "libethercat_device_configurator_" + lower + "_plugin.so";
+}
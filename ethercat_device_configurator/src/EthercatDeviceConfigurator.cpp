@@ -21,51 +21,66 @@
  */
 
 #include "ethercat_device_configurator/EthercatDeviceConfigurator.hpp"
+#include "ethercat_device_configurator/ConfigurationCache.hpp"
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+#include "ethercat_device_configurator/JointStateSnapshot.hpp"
+#include "ethercat_device_configurator/SetupSnapshot.hpp"
+#include "ethercat_device_configurator/SharedMemoryExport.hpp"
 #include <param_io/get_param.hpp>
 
-/*Anydrives*/
-#ifdef _ANYDRIVE_FOUND_
-#include "anydrive_rsl/Anydrive.hpp"
-#endif
-
-/*Elmo*/
-#ifdef _ELMO_FOUND_
-#include "elmo_ethercat_sdk/Elmo.hpp"
-#endif
-
-/*MPS*/
-#ifdef _MPSDRIVE_FOUND_
-#include "mps_ethercat_sdk/MPSDrive.hpp"
-#endif
-
-/*Maxon*/
-#ifdef _MAXON_FOUND_
-#include "maxon_epos_ethercat_sdk/Maxon.hpp"
-#endif
-
-/*Bota rokubi and SenseOne sensors*/
-#ifdef _ROKUBI_FOUND_
-#include "rokubimini_rsl_ethercat_slave/RokubiminiEthercat.hpp"
-#endif
-
-#ifdef _EK1100_FOUND_
-#include "ek1100/EK1100.hpp"
-#endif
-
-#ifdef _EL3102_FOUND_
-#include "el3102/EL3102.hpp"
-#endif
-
 /*yaml-cpp*/
 #include "yaml-cpp/yaml.h"
 
+/*posix*/
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
 /*std*/
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
 #if __GNUC__ < 8
 #include <experimental/filesystem>
 #else
 #include <filesystem>
 #endif
 
+// Known types map to their EthercatSlaveType, types only provided by a registered factory or a plugin to NA. The parsers reject other
+// types.
+static EthercatDeviceConfigurator::EthercatSlaveType slave_type_from_name(const std::string& type_name) {
+  using EthercatSlaveType = EthercatDeviceConfigurator::EthercatSlaveType;
+  static const std::unordered_map<std::string, EthercatSlaveType> types{{"Elmo", EthercatSlaveType::Elmo},
+                                                                         {"MPSDrive", EthercatSlaveType::MPSDrive},
+                                                                         {"Maxon", EthercatSlaveType::Maxon},
+                                                                         {"Anydrive", EthercatSlaveType::Anydrive},
+                                                                         {"Rokubi", EthercatSlaveType::Rokubi},
+                                                                         {"EK1100", EthercatSlaveType::EK1100},
+                                                                         {"EL3102", EthercatSlaveType::EL3102},
+                                                                         {"Virtual", EthercatSlaveType::Virtual}};
+  auto it = types.find(type_name);
+  return it == types.end() ? EthercatSlaveType::NA : it->second;
+}
+
+// Collects the error if errors are given (validation), throws it otherwise
+static void setup_error(std::vector<std::string>* errors, const std::string& message) {
+  if (!errors) throw std::runtime_error(message);
+  errors->push_back(message);
+}
+
+// Both parsers read the seed of a virtual bus as int: XmlRpc has no unsigned 64 bit integers
+static uint64_t virtual_bus_seed(int seed, const std::string& bus, std::vector<std::string>* errors) {
+  if (seed < 0) setup_error(errors, "[EthercatDeviceConfigurator] The seed of virtual bus " + bus + " has to be positive or 0");
+  return static_cast<uint64_t>(seed);
+}
+
 static bool path_exists(std::string& path) {
 #if __GNUC__ < 8
   return std::experimental::filesystem::exists(path);
@@ -74,40 +89,775 @@ static bool path_exists(std::string& path) {
 #endif
 }
 
-EthercatDeviceConfigurator::EthercatDeviceConfigurator(std::string path, bool startup) : m_setup_file_path(path) {
-  parseFile(path);
-  setup(startup);
+EthercatDeviceConfigurator::EthercatDeviceConfigurator(std::string path, bool startup) {
+  initializeFromFile(path, startup);
+}
+
+EthercatDeviceConfigurator::~EthercatDeviceConfigurator() {
+  stopRuntime(true);
 }
 
 void EthercatDeviceConfigurator::initializeFromFile(std::string path, bool startup) {
-  m_setup_file_path = path;
-  parseFile(path);
-  setup(startup);
+  profileInitialization("initializeFromFile", path, [&]() {
+    m_setup_file_path = path;
+    {
+      StartupProfiler::Scope phase(m_startup_profiler, "parseFile");
+      parseFile(path);
+    }
+    setup(startup);
+  });
 }
 
 void EthercatDeviceConfigurator::initializeFromParameters(XmlRpc::XmlRpcValue& params, bool startup) {
-  parseParameter(params);
-  setup(startup);
+  profileInitialization("initializeFromParameters", "", [&]() {
+    {
+      StartupProfiler::Scope phase(m_startup_profiler, "parseParameter");
+      parseParameter(params);
+    }
+    setup(startup);
+  });
+}
+
+void EthercatDeviceConfigurator::initializeFromSnapshot(const std::string& snapshot_path, bool startup) {
+  SetupSnapshot snapshot;
+  std::string outdated;
+  bool up_to_date = false;
+  profileInitialization("initializeFromSnapshot", snapshot_path, [&]() {
+    {
+      StartupProfiler::Scope phase(m_startup_profiler, "readSnapshot");
+      snapshot = SetupSnapshot::read(snapshot_path);
+      up_to_date = snapshot.sourcesUpToDate(outdated);
+    }
+    if (!up_to_date) return;
+    m_setup_file_path = snapshot.setup_file_path;
+    m_master_configurations = std::move(snapshot.master_configurations);
+    m_master_runtime_configurations = std::move(snapshot.master_runtime_configurations);
+    m_slave_entries = std::move(snapshot.slave_entries);
+    setup(startup);
+  });
+  if (!up_to_date) {
+    MELO_WARN_STREAM("[EthercatDeviceConfigurator] Snapshot " << snapshot_path << " is outdated (" << outdated
+                                                              << " changed), falling back to " << snapshot.setup_file_path)
+    initializeFromFile(snapshot.setup_file_path, startup);
+  }
+}
+
+void EthercatDeviceConfigurator::compileSetupSnapshot(const std::string& setup_file_path, const std::string& snapshot_path) {
+  EthercatDeviceConfigurator configurator;
+  configurator.m_setup_file_path = setup_file_path;
+  configurator.parseFile(setup_file_path);
+
+  SetupSnapshot snapshot;
+  auto setup_document = ConfigurationCache::instance().load(setup_file_path);
+  snapshot.setup_file_path = setup_document->path();
+  snapshot.source_files.push_back({setup_document->path(), setup_document->hash()});
+
+  for (auto& entry : configurator.m_slave_entries) {
+    if (!entry.has_config_file) continue;
+    // Store absolute paths, the snapshot can be moved independently of the setup.yaml.
+    std::string canonical_path;
+    ConfigurationCache::instance().resolvePath(entry.config_file_path, setup_file_path, &canonical_path);
+    entry.config_file_path = std::move(canonical_path);
+    auto document = ConfigurationCache::instance().load(entry.config_file_path);
+    try {
+      document->node();
+    } catch (const YAML::Exception& e) {
+      throw std::runtime_error("[EthercatDeviceConfigurator] Configuration file of " + entry.name + " is no valid yaml: " + e.what());
+    }
+    bool known = false;
+    for (const auto& source_file : snapshot.source_files) {
+      known = known || source_file.path == document->path();
+    }
+    if (!known) snapshot.source_files.push_back({document->path(), document->hash()});
+  }
+
+  snapshot.master_configurations = std::move(configurator.m_master_configurations);
+  snapshot.master_runtime_configurations = std::move(configurator.m_master_runtime_configurations);
+  snapshot.slave_entries = std::move(configurator.m_slave_entries);
+  snapshot.write(snapshot_path);
+}
+
+EthercatDeviceConfigurator::ValidationReport EthercatDeviceConfigurator::validateSetupFile(const std::string& setup_file_path,
+                                                                                            unsigned int threads) {
+  const auto start = std::chrono::steady_clock::now();
+  ValidationReport report;
+  EthercatDeviceConfigurator validator;
+  validator.m_setup_file_path = setup_file_path;
+  validator.m_construction_threads = threads;
+  validator.parseFile(setup_file_path, &report.errors);
+  const std::size_t parse_errors = report.errors.size();
+  validator.validateEntries(report.errors);
+  // Every device has at most one error from validateEntries
+  report.valid_devices = validator.m_slave_entries.size() - (report.errors.size() - parse_errors);
+  report.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+EthercatDeviceConfigurator::ValidationReport EthercatDeviceConfigurator::validateParameters(XmlRpc::XmlRpcValue& params,
+                                                                                             unsigned int threads) {
+  const auto start = std::chrono::steady_clock::now();
+  ValidationReport report;
+  EthercatDeviceConfigurator validator;
+  validator.m_construction_threads = threads;
+  validator.parseParameter(params, &report.errors);
+  const std::size_t parse_errors = report.errors.size();
+  validator.validateEntries(report.errors);
+  report.valid_devices = validator.m_slave_entries.size() - (report.errors.size() - parse_errors);
+  report.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+void EthercatDeviceConfigurator::validateEntries(std::vector<std::string>& errors) const {
+  // Same checks as attachSlave, against the configurations instead of the masters
+  std::unordered_map<std::string, bool> virtual_buses;
+  for (std::size_t index = 0; index < m_master_configurations.size(); index++) {
+    virtual_buses.emplace(m_master_configurations[index].networkInterface, m_master_runtime_configurations[index].is_virtual);
+  }
+  std::vector<SlaveHandle> handles;
+  handles.reserve(m_slave_entries.size());
+  for (SlaveHandle handle = 0; handle < m_slave_entries.size(); handle++) {
+    const auto& entry = m_slave_entries[handle];
+    auto bus_it = virtual_buses.find(entry.ethercat_bus);
+    if (bus_it == virtual_buses.end()) {
+      errors.push_back("[EthercatDeviceConfigurator] No master found for slave " + entry.name +
+                       " check if ethercat bus matches in yaml file");
+    } else if (bus_it->second != (entry.type == EthercatSlaveType::Virtual)) {
+      errors.push_back("[EthercatDeviceConfigurator] Slave: " + entry.name + " on bus: " + entry.ethercat_bus +
+                       ", Virtual devices can only be used on virtual buses and virtual buses only take Virtual devices");
+    } else {
+      handles.push_back(handle);
+    }
+  }
+  // The devices are only created, they are never attached to a master
+  createSlaves(m_slave_entries, handles, &errors);
+}
+
+std::vector<EthercatDeviceConfigurator::MasterStartupReport> EthercatDeviceConfigurator::startupMasters(bool parallel) {
+  std::vector<std::size_t> master_indices(m_masters.size());
+  for (std::size_t index = 0; index < m_masters.size(); index++) {
+    master_indices[index] = index;
+  }
+  std::lock_guard<std::mutex> lock(m_lifecycle_mutex);
+  joinLifecycleThreads();
+  m_shutdown_requested = false;
+  auto reports = startupMasters(master_indices, parallel);
+  writeStartupProfile();
+  return reports;
+}
+
+StartupProfile EthercatDeviceConfigurator::getStartupProfile() const {
+  return m_startup_profiler.profile();
+}
+
+void EthercatDeviceConfigurator::setStartupProfilePath(const std::string& path) {
+  m_startup_profile_path = path;
+}
+
+void EthercatDeviceConfigurator::profileInitialization(const std::string& name, const std::string& subject,
+                                                       const std::function<void()>& body) {
+  m_startup_profiler.reset();
+  try {
+    StartupProfiler::Scope phase(m_startup_profiler, name, "configurator", subject);
+    body();
+  } catch (...) {
+    writeStartupProfile();
+    throw;
+  }
+  writeStartupProfile();
+}
+
+void EthercatDeviceConfigurator::writeStartupProfile() const {
+  std::string path = m_startup_profile_path;
+  if (path.empty()) {
+    const char* environment = std::getenv("ETHERCAT_STARTUP_PROFILE");
+    if (environment) path = environment;
+  }
+  if (path.empty()) return;
+  std::ofstream stream(path);
+  m_startup_profiler.profile().writeJson(stream);
+  if (!stream) MELO_WARN_STREAM("[EthercatDeviceConfigurator] Could not write the startup profile to " << path)
+}
+
+std::vector<EthercatDeviceConfigurator::MasterStartupReport> EthercatDeviceConfigurator::startupMasters(
+    const std::vector<std::size_t>& master_indices, bool parallel) {
+  std::vector<MasterStartupReport> reports(master_indices.size());
+  StartupProfiler::Scope phase(m_startup_profiler, "startupMasters");
+
+  auto startupMaster = [this, &reports, &master_indices, &phase](std::size_t i) {
+    reports[i] = this->startupMaster(master_indices[i], phase.id());
+  };
+
+  if (parallel && master_indices.size() > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(master_indices.size());
+    for (std::size_t i = 0; i < master_indices.size(); i++) {
+      threads.emplace_back(startupMaster, i);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  } else {
+    for (std::size_t i = 0; i < master_indices.size(); i++) {
+      startupMaster(i);
+    }
+  }
+  return reports;
+}
+
+EthercatDeviceConfigurator::MasterStartupReport EthercatDeviceConfigurator::startupMaster(std::size_t master_index,
+                                                                                          StartupProfiler::PhaseId parent) {
+  auto& runtime = *m_master_runtimes[master_index];
+  MasterStartupReport report;
+  report.name = m_master_configurations[master_index].name;
+  report.ethercat_bus = m_master_configurations[master_index].networkInterface;
+  // Slave discovery and the sdo configuration of all slaves of the bus
+  StartupProfiler::Scope bus_phase(m_startup_profiler, "startup", "bus", report.ethercat_bus, parent);
+  MELO_DEBUG("Starting master on: " + report.ethercat_bus)
+  const auto start = std::chrono::steady_clock::now();
+  try {
+    if (runtime.virtual_bus) {
+      report.success = runtime.virtual_bus->startup(m_startup_abort_flag);
+    } else {
+      report.success = runtime.master->startup(m_startup_abort_flag);
+    }
+    if (!report.success) {
+      report.error = m_startup_abort_flag ? "startup aborted" : "startup failed";
+    }
+  } catch (const std::exception& e) {
+    report.success = false;
+    report.error = e.what();
+  }
+  runtime.started = report.success;
+  if (!report.success) bus_phase.fail();
+  report.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  MELO_INFO_STREAM("[EthercatDeviceConfigurator] Startup of master on interface: " << report.ethercat_bus << " took " << report.duration
+                                                                                   << " s" << (report.success ? "" : ", failed"))
+  return report;
+}
+
+std::vector<std::future<EthercatDeviceConfigurator::MasterStartupReport>> EthercatDeviceConfigurator::startupAsync() {
+  std::lock_guard<std::mutex> lock(m_lifecycle_mutex);
+  m_shutdown_requested = false;
+  std::vector<std::future<MasterStartupReport>> futures;
+  futures.reserve(m_master_runtimes.size());
+  // The profile is written once all buses are started
+  auto pending = std::make_shared<std::atomic<std::size_t>>(m_master_runtimes.size());
+  for (std::size_t index = 0; index < m_master_runtimes.size(); index++) {
+    auto& runtime = *m_master_runtimes[index];
+    std::promise<MasterStartupReport> promise;
+    futures.push_back(promise.get_future());
+    // Chained to the pending lifecycle operation of the bus instead of waiting for it here
+    runtime.lifecycle_thread = std::thread(
+        [this, index, pending, promise = std::move(promise), previous = std::move(runtime.lifecycle_thread)]() mutable {
+          if (previous.joinable()) previous.join();
+          promise.set_value(startupMaster(index, StartupProfiler::root));
+          if (--*pending == 0) writeStartupProfile();
+        });
+  }
+  return futures;
+}
+
+namespace {
+// Shared by the bus threads of a shutdownAsync and its deadline thread, the first one to report a bus resolves its future
+struct ShutdownState {
+  std::mutex mutex;
+  std::condition_variable done;
+  std::vector<std::promise<EthercatDeviceConfigurator::MasterShutdownReport>> promises;
+  std::vector<bool> reported;
+  std::size_t remaining{0};
+};
+}  // namespace
+
+std::vector<std::future<EthercatDeviceConfigurator::MasterShutdownReport>> EthercatDeviceConfigurator::shutdownAsync(double timeout) {
+  std::lock_guard<std::mutex> lock(m_lifecycle_mutex);
+  // A startRuntime after this call (e.g. of a startup still running on another thread) does not start the shut down buses again
+  m_shutdown_requested = true;
+  // The deadline thread of a former call returns at its deadline at the latest
+  if (m_shutdown_deadline_thread.joinable()) m_shutdown_deadline_thread.join();
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+  const bool runtime_running = m_runtime_running;
+  auto state = std::make_shared<ShutdownState>();
+  state->promises.resize(m_master_runtimes.size());
+  state->reported.resize(m_master_runtimes.size(), false);
+  state->remaining = m_master_runtimes.size();
+
+  std::vector<std::future<MasterShutdownReport>> futures;
+  std::vector<MasterShutdownReport> reports(m_master_runtimes.size());
+  for (std::size_t index = 0; index < m_master_runtimes.size(); index++) {
+    futures.push_back(state->promises[index].get_future());
+    reports[index].name = m_master_configurations[index].name;
+    reports[index].ethercat_bus = m_master_configurations[index].networkInterface;
+  }
+
+  for (std::size_t index = 0; index < m_master_runtimes.size(); index++) {
+    auto& runtime = *m_master_runtimes[index];
+    runtime.lifecycle_thread = std::thread([this, index, state, start, runtime_running, report = reports[index], &runtime,
+                                            previous = std::move(runtime.lifecycle_thread)]() mutable {
+      if (previous.joinable()) previous.join();
+      try {
+        shutdownMaster(runtime);
+        report.success = true;
+      } catch (const std::exception& e) {
+        report.error = e.what();
+      }
+      report.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (--state->remaining == 0 && runtime_running) {
+        // Without m_lifecycle_mutex, joinLifecycleThreads waits for this thread while holding it. Both are atomic and idempotent, and
+        // startRuntime / stopRuntime only touch them after joining this thread.
+        // after the cyclic threads, the readings queued by them are still dispatched
+        if (m_reading_dispatcher) m_reading_dispatcher->stop();
+        m_runtime_running.store(false);
+      }
+      if (!state->reported[index]) {
+        state->reported[index] = true;
+        state->promises[index].set_value(report);
+      }
+      state->done.notify_all();
+    });
+  }
+
+  m_shutdown_deadline_thread = std::thread([state, deadline, timeout, reports]() {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->done.wait_until(lock, deadline, [&state]() { return state->remaining == 0; })) return;
+    for (std::size_t index = 0; index < reports.size(); index++) {
+      if (state->reported[index]) continue;
+      state->reported[index] = true;
+      MasterShutdownReport report = reports[index];
+      report.error = "deadline exceeded";
+      report.duration = timeout;
+      MELO_WARN_STREAM("[EthercatDeviceConfigurator] Shutdown of master on interface: " << report.ethercat_bus << " exceeded the deadline")
+      state->promises[index].set_value(report);
+    }
+  });
+  return futures;
+}
+
+void EthercatDeviceConfigurator::joinLifecycleThreads() {
+  for (auto& runtime : m_master_runtimes) {
+    if (runtime->lifecycle_thread.joinable()) runtime->lifecycle_thread.join();
+  }
+  // Returns once the bus threads are joined
+  if (m_shutdown_deadline_thread.joinable()) m_shutdown_deadline_thread.join();
+}
+
+static bool set_thread_realtime(int priority, int cpu_core) {
+  bool success = true;
+  if (priority > 0) {
+    sched_param param{};
+    param.sched_priority = priority;
+    success = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0 && success;
+  }
+  if (cpu_core >= 0) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu_core, &cpuset);
+    success = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0 && success;
+  }
+  return success;
+}
+
+static void add_nanoseconds(timespec& time, int64_t nanoseconds) {
+  time.tv_sec += nanoseconds / 1000000000;
+  time.tv_nsec += nanoseconds % 1000000000;
+  if (time.tv_nsec >= 1000000000) {
+    time.tv_sec++;
+    time.tv_nsec -= 1000000000;
+  }
+}
+
+static int64_t to_nanoseconds(const timespec& time) {
+  return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+bool EthercatDeviceConfigurator::startRuntime() {
+  std::lock_guard<std::mutex> lock(m_lifecycle_mutex);
+  joinLifecycleThreads();
+  if (m_runtime_running) throw std::runtime_error("[EthercatDeviceConfigurator] Runtime already running");
+  if (m_shutdown_requested || m_startup_abort_flag) {
+    MELO_WARN_STREAM("[EthercatDeviceConfigurator] Runtime not started, "
+                     << (m_startup_abort_flag ? "the startup was aborted" : "the masters are shut down"))
+    return false;
+  }
+  m_runtime_running = true;
+  if (m_reading_dispatcher) m_reading_dispatcher->start();
+  for (auto& runtime : m_master_runtimes) {
+    if (!runtime->started) {
+      MELO_WARN_STREAM("[EthercatDeviceConfigurator] Master on interface " << runtime->bus << " is not started up, not cycled")
+      continue;
+    }
+    startMasterRuntime(*runtime);
+  }
+  return true;
+}
+
+void EthercatDeviceConfigurator::startMasterRuntime(MasterRuntime& runtime) {
+  runtime.running = true;
+  runtime.thread = std::thread(&EthercatDeviceConfigurator::runMaster, std::ref(runtime));
+}
+
+void EthercatDeviceConfigurator::shutdownMaster(MasterRuntime& runtime) {
+  if (runtime.running) {
+    // call preShutdown before terminating the cyclic PDO communication
+    if (!runtime.virtual_bus) runtime.master->preShutdown(true);
+    runtime.running = false;
+  }
+  if (runtime.thread.joinable()) runtime.thread.join();
+  if (!runtime.started) return;
+  if (runtime.virtual_bus) {
+    runtime.virtual_bus->shutdown();
+  } else {
+    runtime.master->shutdown();
+  }
+  runtime.started = false;
+}
+
+void EthercatDeviceConfigurator::stopRuntime(bool shutdown) {
+  std::lock_guard<std::mutex> lock(m_lifecycle_mutex);
+  joinLifecycleThreads();
+  if (m_runtime_running) {
+    // call preShutdown before terminating the cyclic PDO communication
+    for (auto& runtime : m_master_runtimes) {
+      if (runtime->running && !runtime->virtual_bus) runtime->master->preShutdown(true);
+    }
+    for (auto& runtime : m_master_runtimes) {
+      runtime->running = false;
+    }
+    for (auto& runtime : m_master_runtimes) {
+      if (runtime->thread.joinable()) runtime->thread.join();
+    }
+    // after the cyclic threads, the readings queued by them are still dispatched
+    if (m_reading_dispatcher) m_reading_dispatcher->stop();
+    m_runtime_running = false;
+  }
+  if (shutdown) {
+    // Also the masters started up without a runtime, e.g. by startupAsync. The threads are joined, only shuts down the started masters
+    for (auto& runtime : m_master_runtimes) {
+      shutdownMaster(*runtime);
+    }
+  }
+}
+
+bool EthercatDeviceConfigurator::isRuntimeRunning() const {
+  return m_runtime_running;
+}
+
+void EthercatDeviceConfigurator::addCycleCallback(std::size_t master_index, std::function<void()> callback) {
+  if (m_runtime_running) throw std::runtime_error("[EthercatDeviceConfigurator] Cycle callbacks can only be added while not running");
+  m_master_runtimes.at(master_index)->cycle_callbacks.push_back(std::move(callback));
+}
+
+void EthercatDeviceConfigurator::setReadingDispatcherConfiguration(const ReadingDispatcher::Configuration& configuration) {
+  if (m_reading_dispatcher && !m_reading_dispatcher->getChannels().empty()) {
+    throw std::runtime_error("[EthercatDeviceConfigurator] Reading dispatcher already in use, configure it before adding callbacks");
+  }
+  m_reading_dispatcher = std::make_unique<ReadingDispatcher>(configuration);
+}
+
+ReadingDispatcher& EthercatDeviceConfigurator::getReadingDispatcher() {
+  if (!m_reading_dispatcher) m_reading_dispatcher = std::make_unique<ReadingDispatcher>();
+  return *m_reading_dispatcher;
+}
+
+std::shared_ptr<SharedMemoryExport> EthercatDeviceConfigurator::exportSharedMemory(const std::string& name) {
+  if (m_runtime_running) throw std::runtime_error("[EthercatDeviceConfigurator] Shared memory can only be exported while not running");
+  auto& registry = DeviceFactoryRegistry::instance();
+  std::vector<SharedMemoryExport::Slave> slaves(m_slaves.size());
+  // Slave table indices per master
+  std::vector<std::vector<std::size_t>> master_slaves(m_masters.size());
+  for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+    const auto& entry = m_slave_entries[handle];
+    auto& slave = slaves[handle];
+    slave.name = entry.name;
+    slave.type_name = entry.type_name;
+    slave.ethercat_bus = entry.ethercat_bus;
+    slave.ethercat_address = entry.ethercat_address;
+    slave.device = m_slaves[handle];
+    if (auto adapter = registry.getProcessDataAdapter(entry.type_name)) {
+      slave.adapter = std::move(*adapter);
+      master_slaves[getMasterIndex(handle)].push_back(handle);
+    }
+  }
+  auto shared_memory = std::make_shared<SharedMemoryExport>(name, std::move(slaves));
+  m_shared_memory_exports.push_back(shared_memory);
+  for (std::size_t master = 0; master < master_slaves.size(); master++) {
+    if (master_slaves[master].empty()) continue;
+    addCycleCallback(master, [shared_memory, indices = std::move(master_slaves[master])]() {
+      for (const auto index : indices) {
+        shared_memory->cycle(index);
+      }
+    });
+  }
+  return shared_memory;
+}
+
+std::shared_ptr<JointStateSnapshot> EthercatDeviceConfigurator::addJointStateSnapshot() {
+  if (m_runtime_running) throw std::runtime_error("[EthercatDeviceConfigurator] Joint state snapshots can only be added while not running");
+  auto& registry = DeviceFactoryRegistry::instance();
+  std::vector<JointStateSnapshot::Slave> slaves(m_slaves.size());
+  for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+    slaves[handle].device = m_slaves[handle];
+    slaves[handle].master = getMasterIndex(handle);
+    if (auto adapter = registry.getProcessDataAdapter(m_slave_entries[handle].type_name)) slaves[handle].adapter = std::move(*adapter);
+  }
+  auto snapshot = std::make_shared<JointStateSnapshot>(std::move(slaves), m_masters.size());
+  m_joint_state_snapshots.push_back(snapshot);
+  for (std::size_t master = 0; master < m_masters.size(); master++) {
+    addCycleCallback(master, [snapshot, master]() { snapshot->cycle(master); });
+  }
+  return snapshot;
+}
+
+std::size_t EthercatDeviceConfigurator::getMasterIndex(SlaveHandle handle) const {
+  return m_bus_indices.at(getInfoForSlave(handle).ethercat_bus);
+}
+
+const std::shared_ptr<VirtualBus>& EthercatDeviceConfigurator::getVirtualBus(std::size_t master_index) const {
+  return m_virtual_buses.at(master_index);
+}
+
+EthercatDeviceConfigurator::CycleTiming& EthercatDeviceConfigurator::getCycleTiming(std::size_t master_index) {
+  return m_master_runtimes.at(master_index)->timing;
+}
+
+const EthercatDeviceConfigurator::CycleTiming& EthercatDeviceConfigurator::getCycleTiming(std::size_t master_index) const {
+  return m_master_runtimes.at(master_index)->timing;
+}
+
+void EthercatDeviceConfigurator::resetCycleTiming() {
+  for (auto& runtime : m_master_runtimes) {
+    runtime->timing.reset();
+  }
+}
+
+const RealtimeViolations& EthercatDeviceConfigurator::getRealtimeViolations(std::size_t master_index) const {
+  return m_master_runtimes.at(master_index)->realtime_violations;
 }
 
-std::vector<std::shared_ptr<ecat_master::EthercatMaster>> EthercatDeviceConfigurator::getMasters() {
+void EthercatDeviceConfigurator::resetRealtimeViolations() {
+  for (auto& runtime : m_master_runtimes) {
+    runtime->realtime_violations.reset();
+  }
+}
+
+std::vector<EthercatDeviceConfigurator::DriveTransitionResult> EthercatDeviceConfigurator::setDriveStates(
+    DriveTarget target, const std::vector<std::string>& types, const std::vector<std::string>& buses, double timeout) const {
+  auto& registry = DeviceFactoryRegistry::instance();
+  // Handler per type name, std::nullopt for types without one (no drives, e.g. EK1100)
+  std::unordered_map<std::string, std::optional<DeviceFactoryRegistry::DriveStateHandler>> handlers;
+  for (const auto& type : types) {
+    auto handler = registry.getDriveStateHandler(type);
+    if (!handler) throw std::runtime_error("[EthercatDeviceConfigurator] No drive state handler for device type: " + type);
+    handlers.emplace(type, std::move(handler));
+  }
+
+  std::vector<DriveTransition> transitions;
+  for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+    const auto& entry = m_slave_entries[handle];
+    if (!buses.empty() && std::find(buses.begin(), buses.end(), entry.ethercat_bus) == buses.end()) continue;
+    auto it = handlers.find(entry.type_name);
+    if (it == handlers.end()) {
+      if (!types.empty()) continue;
+      it = handlers.emplace(entry.type_name, registry.getDriveStateHandler(entry.type_name)).first;
+    }
+    if (!it->second) continue;
+    const auto& slave = m_slaves[handle];
+    transitions.push_back({slave, [slave, target, request = it->second->request]() { request(*slave, target); },
+                           [slave, target, reached = it->second->reached]() { return reached(*slave, target); }});
+  }
+  return transitionDrives(transitions, timeout);
+}
+
+// Polling the readings more often only contends with the cyclic threads for the reading locks of the drives
+static constexpr std::chrono::milliseconds drive_state_poll_period{5};
+
+std::vector<EthercatDeviceConfigurator::DriveTransitionResult> EthercatDeviceConfigurator::transitionDrives(
+    const std::vector<DriveTransition>& transitions, double timeout) const {
+  std::vector<DriveTransitionResult> results(transitions.size());
+  std::vector<std::size_t> pending;
+  pending.reserve(transitions.size());
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+
+  // Request all transitions first, the state machines of all drives then advance in the same bus cycles.
+  for (std::size_t i = 0; i < transitions.size(); i++) {
+    auto& result = results[i];
+    result.name = transitions[i].drive->getName();
+    result.handle = getSlaveHandle(transitions[i].drive);
+    try {
+      transitions[i].request();
+      pending.push_back(i);
+    } catch (const std::exception& e) {
+      result.error = e.what();
+    }
+  }
+
+  while (!pending.empty()) {
+    const auto now = std::chrono::steady_clock::now();
+    auto reached = [&](std::size_t i) {
+      auto& result = results[i];
+      try {
+        result.success = transitions[i].reached();
+      } catch (const std::exception& e) {
+        result.error = e.what();
+        return true;
+      }
+      if (result.success) result.duration = std::chrono::duration<double>(now - start).count();
+      return result.success;
+    };
+    pending.erase(std::remove_if(pending.begin(), pending.end(), reached), pending.end());
+    if (pending.empty() || now >= deadline) break;
+    std::this_thread::sleep_for(drive_state_poll_period);
+  }
+
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (std::size_t i : pending) {
+    results[i].duration = elapsed;
+    results[i].error = "target state not reached within " + std::to_string(timeout) + " s";
+  }
+  for (const auto& result : results) {
+    if (!result.success) {
+      MELO_WARN_STREAM("[EthercatDeviceConfigurator] Drive state transition of " << result.name << " failed: " << result.error)
+    }
+  }
+  return results;
+}
+
+const EthercatDeviceConfigurator::MasterRuntimeConfiguration& EthercatDeviceConfigurator::getMasterRuntimeConfiguration(
+    std::size_t master_index) const {
+  return m_master_runtime_configurations.at(master_index);
+}
+
+void EthercatDeviceConfigurator::runMaster(MasterRuntime& runtime) {
+  const auto& master = runtime.master;
+  const auto& configuration = runtime.configuration;
+  const std::string& bus = runtime.bus;
+
+  VirtualBus* virtual_bus = runtime.virtual_bus.get();
+  // Simulated time: cycle as fast as possible, the virtual bus advances its own clock.
+  const bool simulated_time = virtual_bus && virtual_bus->getConfiguration().simulated_time;
+  // A thread which never sleeps must not run with SCHED_FIFO, it would starve the kernel threads of its core.
+  const int priority = simulated_time ? 0 : configuration.rt_priority;
+  if (simulated_time && configuration.rt_priority > 0) {
+    MELO_INFO_STREAM("[EthercatDeviceConfigurator] Bus " << bus << " runs in simulated time, rt_priority ignored")
+  }
+  if (!set_thread_realtime(priority, configuration.cpu_core)) {
+    MELO_WARN_STREAM("[EthercatDeviceConfigurator] Could not set priority " << priority << " / cpu core " << configuration.cpu_core
+                                                                            << " for bus " << bus << " - check user privileges.")
+  }
+
+  if (!virtual_bus && master->activate()) {
+    MELO_INFO_STREAM("[EthercatDeviceConfigurator] Activated the bus: " << bus)
+  }
+
+  // The thread does the timing itself, the master is updated in NonStandalone mode.
+  const int64_t period = runtime.timing.nominal_period;
+  auto& timing = runtime.timing;
+  timespec next{};
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  int64_t last_wakeup = 0;
+  while (runtime.running) {
+    timespec now{};
+    if (simulated_time) {
+      // Leaves the core to the other threads between the cycles
+      sched_yield();
+    } else {
+      add_nanoseconds(next, period);
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t wakeup = to_nanoseconds(now);
+    if (!simulated_time) timing.wakeup_latency.record(wakeup - to_nanoseconds(next));
+    if (last_wakeup != 0) timing.period.record(wakeup - last_wakeup);
+    last_wakeup = wakeup;
+
+    {
+      // Allocations, lock waits and blocking calls in here are counted if the realtime detector is preloaded
+      RealtimeSection section(runtime.realtime_violations);
+      if (virtual_bus) {
+        virtual_bus->update();
+      } else {
+        master->update(ecat_master::UpdateMode::NonStandalone);
+      }
+      for (const auto& callback : runtime.cycle_callbacks) {
+        callback();
+      }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t end = to_nanoseconds(now);
+    timing.execution.record(end - wakeup);
+    const int64_t behind = end - to_nanoseconds(next);
+    if (!simulated_time && behind > period) {
+      // More than one period behind: skip the missed cycles instead of updating back to back.
+      timing.overruns.fetch_add(1, std::memory_order_relaxed);
+      next = now;
+    }
+  }
+
+  // make sure that bus is in SAFE_OP state, preShutdown(true) should already do it.
+  if (!virtual_bus) master->deactivate();
+}
+
+void EthercatDeviceConfigurator::setParallelStartup(bool parallel) {
+  m_parallel_startup = parallel;
+}
+
+void EthercatDeviceConfigurator::setMaxConstructionThreads(unsigned int threads) {
+  m_construction_threads = threads;
+}
+
+void EthercatDeviceConfigurator::abortStartup() {
+  m_startup_abort_flag = true;
+}
+
+bool EthercatDeviceConfigurator::isStartupAborted() const {
+  return m_startup_abort_flag;
+}
+
+const std::vector<std::shared_ptr<ecat_master::EthercatMaster>>& EthercatDeviceConfigurator::getMasters() const {
   return m_masters;
 }
 
-std::vector<std::shared_ptr<ecat_master::EthercatDevice>> EthercatDeviceConfigurator::getSlaves() {
+const std::vector<std::shared_ptr<ecat_master::EthercatDevice>>& EthercatDeviceConfigurator::getSlaves() const {
   return m_slaves;
 }
 
-std::shared_ptr<ecat_master::EthercatDevice> EthercatDeviceConfigurator::getSlave(std::string name) {
-  for (auto& slave : m_slaves) {
-    if (slave->getName() == name) return slave;
+const std::shared_ptr<ecat_master::EthercatDevice>& EthercatDeviceConfigurator::getSlave(std::string_view name) const {
+  auto it = m_slave_name_indices.find(name);
+  if (it == m_slave_name_indices.end()) {
+    throw std::runtime_error("[EthercatDeviceConfigurator] Slave: " + std::string(name) + " not found");
   }
-  throw std::runtime_error("[EthercatDeviceConfigurator] Slave: " + name + " not found");
+  return m_slaves[it->second];
+}
+
+std::shared_ptr<ecat_master::EthercatDevice> EthercatDeviceConfigurator::tryGetSlave(std::string_view name) const noexcept {
+  auto it = m_slave_name_indices.find(name);
+  if (it == m_slave_name_indices.end()) return nullptr;
+  return m_slaves[it->second];
+}
+
+const std::shared_ptr<ecat_master::EthercatDevice>& EthercatDeviceConfigurator::getSlaveByHandle(SlaveHandle handle) const {
+  if (handle >= m_slaves.size()) throw std::out_of_range("[EthercatDeviceConfigurator] Invalid slave handle");
+  return m_slaves[handle];
+}
+
+EthercatDeviceConfigurator::SlaveHandle EthercatDeviceConfigurator::getSlaveHandle(
+    const std::shared_ptr<ecat_master::EthercatDevice>& slave) const {
+  auto it = m_slave_handles.find(slave.get());
+  if (it == m_slave_handles.end()) throw std::out_of_range("[EthercatDeviceConfigurator] Slave not managed by this configurator");
+  return it->second;
 }
 
 const EthercatDeviceConfigurator::EthercatSlaveEntry& EthercatDeviceConfigurator::getInfoForSlave(
-    const std::shared_ptr<ecat_master::EthercatDevice>& slave) {
-  return m_slave_to_entry_map[slave];
+    const std::shared_ptr<ecat_master::EthercatDevice>& slave) const {
+  return m_slave_entries[getSlaveHandle(slave)];
+}
+
+const EthercatDeviceConfigurator::EthercatSlaveEntry& EthercatDeviceConfigurator::getInfoForSlave(SlaveHandle handle) const {
+  if (handle >= m_slaves.size()) throw std::out_of_range("[EthercatDeviceConfigurator] Invalid slave handle");
+  return m_slave_entries[handle];
 }
 
 std::shared_ptr<ecat_master::EthercatMaster> EthercatDeviceConfigurator::master() {
@@ -115,6 +865,7 @@ std::shared_ptr<ecat_master::EthercatMaster> EthercatDeviceConfigurator::master(
     throw std::runtime_error("[EthercatDeviceConfigurator] More than one master configured, use getMasters instead of master");
 
   if (m_masters.empty()) throw std::out_of_range("[EthercatDeviceConfigurator] No master configured");
+  if (!m_masters[0]) throw std::runtime_error("[EthercatDeviceConfigurator] The bus is virtual and has no master, use getVirtualBus");
 
   return m_masters[0];
 }
@@ -123,7 +874,7 @@ const std::string& EthercatDeviceConfigurator::getSetupFilePath() {
   return m_setup_file_path;
 }
 
-void EthercatDeviceConfigurator::parseParameter(XmlRpc::XmlRpcValue& params) {
+void EthercatDeviceConfigurator::parseParameter(XmlRpc::XmlRpcValue& params, std::vector<std::string>* errors) {
   // Ethercat master configuration
   if (params.hasMember("ethercat_master_s")) {
     XmlRpc::XmlRpcValue ethercatMastersParam = param_io::getMember<XmlRpc::XmlRpcValue>(params, "ethercat_master_s");
@@ -134,42 +885,68 @@ void EthercatDeviceConfigurator::parseParameter(XmlRpc::XmlRpcValue& params) {
       //        masterConfiguration.name = param_io::getMember<std::string>(ethercatMasterParam.second, "name");
       //      }
       //      MELO_INFO_STREAM("[EthercatDeviceConfigurator] Found master: " << masterConfiguration.name);
-      if (ethercatMasterParam.second.hasMember("ethercat_bus")) {
-        masterConfiguration.networkInterface = param_io::getMember<std::string>(ethercatMasterParam.second, "ethercat_bus");
-      }
-      if (ethercatMasterParam.second.hasMember("time_step")) {
-        masterConfiguration.timeStep = param_io::getMember<double>(ethercatMasterParam.second, "time_step");
-      }
-      if (ethercatMasterParam.second.hasMember("update_rate_too_low_warn_threshold")) {
-        masterConfiguration.updateRateTooLowWarnThreshold =
-            param_io::getMember<int>(ethercatMasterParam.second, "update_rate_too_low_warn_threshold");
-      }
-      if (ethercatMasterParam.second.hasMember("pdo_size_check")) {
-        masterConfiguration.pdoSizeCheck = param_io::getMember<bool>(ethercatMasterParam.second, "pdo_size_check");
-      }
-      if (ethercatMasterParam.second.hasMember("slave_discover_retries")) {
-        masterConfiguration.slaveDiscoverRetries = param_io::getMember<int>(ethercatMasterParam.second, "slave_discover_retries");
-      }
-      if (ethercatMasterParam.second.hasMember("bus_diagnosis")) {
-        masterConfiguration.doBusDiagnosis = param_io::getMember<bool>(ethercatMasterParam.second, "bus_diagnosis");
-      }
-      if (ethercatMasterParam.second.hasMember("error_counter_log")) {
-        masterConfiguration.logErrorCounters = param_io::getMember<bool>(ethercatMasterParam.second, "error_counter_log");
-        if (masterConfiguration.doBusDiagnosis && !masterConfiguration.logErrorCounters) {
-          throw std::runtime_error("[EthercatDeviceConfigurator] Bus diagnosis has to be enabled to log the error counters.");
+      MasterRuntimeConfiguration runtimeConfiguration{};
+      try {
+        if (ethercatMasterParam.second.hasMember("ethercat_bus")) {
+          masterConfiguration.networkInterface = param_io::getMember<std::string>(ethercatMasterParam.second, "ethercat_bus");
         }
-      }
-      for (const auto& master_config : m_master_configurations) {  // check all previous master config for duplicate bus. throw.
-        if (master_config.networkInterface == masterConfiguration.networkInterface) {
-          throw std::runtime_error(
-              "[EthercatDeviceConfigurator] Two master configurations with the same interface / ethercatbus name defined. Check "
-              "Parameters");
+        if (ethercatMasterParam.second.hasMember("time_step")) {
+          masterConfiguration.timeStep = param_io::getMember<double>(ethercatMasterParam.second, "time_step");
+          if (!(masterConfiguration.timeStep > 0.0)) {
+            setup_error(errors, "[EthercatDeviceConfigurator] time_step of master " + masterConfiguration.name + " has to be positive");
+          }
+        }
+        if (ethercatMasterParam.second.hasMember("update_rate_too_low_warn_threshold")) {
+          masterConfiguration.updateRateTooLowWarnThreshold =
+              param_io::getMember<int>(ethercatMasterParam.second, "update_rate_too_low_warn_threshold");
+        }
+        if (ethercatMasterParam.second.hasMember("pdo_size_check")) {
+          masterConfiguration.pdoSizeCheck = param_io::getMember<bool>(ethercatMasterParam.second, "pdo_size_check");
+        }
+        if (ethercatMasterParam.second.hasMember("slave_discover_retries")) {
+          masterConfiguration.slaveDiscoverRetries = param_io::getMember<int>(ethercatMasterParam.second, "slave_discover_retries");
         }
+        if (ethercatMasterParam.second.hasMember("bus_diagnosis")) {
+          masterConfiguration.doBusDiagnosis = param_io::getMember<bool>(ethercatMasterParam.second, "bus_diagnosis");
+        }
+        if (ethercatMasterParam.second.hasMember("error_counter_log")) {
+          masterConfiguration.logErrorCounters = param_io::getMember<bool>(ethercatMasterParam.second, "error_counter_log");
+          if (masterConfiguration.logErrorCounters && !masterConfiguration.doBusDiagnosis) {
+            setup_error(errors, "[EthercatDeviceConfigurator] Bus diagnosis has to be enabled to log the error counters.");
+          }
+        }
+        if (ethercatMasterParam.second.hasMember("rt_priority")) {
+          runtimeConfiguration.rt_priority = param_io::getMember<int>(ethercatMasterParam.second, "rt_priority");
+        }
+        if (ethercatMasterParam.second.hasMember("cpu_core")) {
+          runtimeConfiguration.cpu_core = param_io::getMember<int>(ethercatMasterParam.second, "cpu_core");
+        }
+        if (ethercatMasterParam.second.hasMember("virtual_bus")) {
+          XmlRpc::XmlRpcValue virtualParams = param_io::getMember<XmlRpc::XmlRpcValue>(ethercatMasterParam.second, "virtual_bus");
+          auto& virtual_bus = runtimeConfiguration.virtual_bus;
+          runtimeConfiguration.is_virtual = true;
+          if (virtualParams.hasMember("latency")) virtual_bus.latency = param_io::getMember<double>(virtualParams, "latency");
+          if (virtualParams.hasMember("jitter")) virtual_bus.jitter = param_io::getMember<double>(virtualParams, "jitter");
+          if (virtualParams.hasMember("working_counter_error_rate")) {
+            virtual_bus.working_counter_error_rate = param_io::getMember<double>(virtualParams, "working_counter_error_rate");
+          }
+          if (virtualParams.hasMember("simulated_time")) {
+            virtual_bus.simulated_time = param_io::getMember<bool>(virtualParams, "simulated_time");
+          }
+          if (virtualParams.hasMember("seed")) {
+            const int seed = param_io::getMember<int>(virtualParams, "seed");
+            virtual_bus.seed = virtual_bus_seed(seed, masterConfiguration.networkInterface, errors);
+          }
+        }
+      } catch (const XmlRpc::XmlRpcException& e) {
+        if (!errors) throw;
+        errors->push_back("[EthercatDeviceConfigurator] Invalid master " + masterConfiguration.name + ": " + e.getMessage());
       }
       m_master_configurations.push_back(masterConfiguration);
+      m_master_runtime_configurations.push_back(runtimeConfiguration);
     }
   } else {
-    throw std::runtime_error("[EthercatDeviceConfigurator] Node ethercat_master_s is missing in parameter");
+    setup_error(errors, "[EthercatDeviceConfigurator] Node ethercat_master_s is missing in parameter");
   }
 
   if (params.hasMember("ethercat_devices")) {
@@ -179,403 +956,780 @@ void EthercatDeviceConfigurator::parseParameter(XmlRpc::XmlRpcValue& params) {
 
       // name - entry
       entry.name = deviceParam.first;
+      const std::size_t error_count = errors ? errors->size() : 0;
+      try {
 
-      if (deviceParam.second.hasMember("type")) {
-        auto type_str = param_io::getMember<std::string>(deviceParam.second, "type");
-        if (type_str == "Elmo") {
-          entry.type = EthercatSlaveType::Elmo;
-        } else if (type_str == "MPSDrive") {
-          entry.type = EthercatSlaveType::MPSDrive;
-        } else if (type_str == "Maxon") {
-          entry.type = EthercatSlaveType::Maxon;
-        } else if (type_str == "Anydrive") {
-          entry.type = EthercatSlaveType::Anydrive;
-        } else if (type_str == "Rokubi") {
-          entry.type = EthercatSlaveType::Rokubi;
-        } else if (type_str == "EK1100") {
-          entry.type = EthercatSlaveType::EK1100;
-        } else if (type_str == "EL3102") {
-          entry.type = EthercatSlaveType::EL3102;
+        if (deviceParam.second.hasMember("type")) {
+          entry.type_name = param_io::getMember<std::string>(deviceParam.second, "type");
+          entry.type = slave_type_from_name(entry.type_name);
+          if (entry.type == EthercatSlaveType::NA && !DeviceFactoryRegistry::instance().providesType(entry.type_name)) {
+            setup_error(errors, "[EthercatDeviceConfigurator] " + entry.type_name + " is an undefined type of ethercat device");
+          }
         } else {
-          throw std::runtime_error("[EthercatDeviceConfigurator] " + entry.name + " is an undefined type of ethercat device");
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + entry.name + " has no entry type");
         }
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + entry.name + " has no entry type");
-      }
-
-      entry.config_file_path = "";
-      entry.has_config_file = false;
 
-      if (deviceParam.second.hasMember("configuration")) {
-        entry.config_params = param_io::getMember<XmlRpc::XmlRpcValue>(deviceParam.second, "configuration");
-      }
+        entry.config_file_path = "";
+        entry.has_config_file = false;
 
-      if (entry.type == EthercatSlaveType::Rokubi) {
-        if (deviceParam.second.hasMember("configuration_file")) {
-          entry.config_file_path = param_io::getMember<std::string>(deviceParam.second, "configuration_file");
+        if (deviceParam.second.hasMember("configuration")) {
+          entry.config_params = param_io::getMember<XmlRpc::XmlRpcValue>(deviceParam.second, "configuration");
         }
-      }
 
-      if (deviceParam.second.hasMember("communication")) {
-        XmlRpc::XmlRpcValue communicationParams = param_io::getMember<XmlRpc::XmlRpcValue>(deviceParam.second, "communication");
-        if (communicationParams.hasMember("ethercat_address")) {
-          entry.ethercat_address = param_io::getMember<int>(communicationParams, "ethercat_address");
-        }
-        if (communicationParams.hasMember("ethercat_bus")) {
-          entry.ethercat_bus = param_io::getMember<std::string>(communicationParams, "ethercat_bus");
+        if (entry.type == EthercatSlaveType::Rokubi) {
+          if (deviceParam.second.hasMember("configuration_file")) {
+            entry.config_file_path = param_io::getMember<std::string>(deviceParam.second, "configuration_file");
+          }
         }
-        // ethercat_pdo_type - entry
-        if (entry.type == EthercatSlaveType::Anydrive || entry.type == EthercatSlaveType::Rokubi) {
+
+        if (deviceParam.second.hasMember("communication")) {
+          XmlRpc::XmlRpcValue communicationParams = param_io::getMember<XmlRpc::XmlRpcValue>(deviceParam.second, "communication");
+          if (communicationParams.hasMember("ethercat_address")) {
+            entry.ethercat_address = param_io::getMember<int>(communicationParams, "ethercat_address");
+          }
+          if (communicationParams.hasMember("ethercat_bus")) {
+            entry.ethercat_bus = param_io::getMember<std::string>(communicationParams, "ethercat_bus");
+          }
+          // ethercat_pdo_type - entry
           if (communicationParams.hasMember("ethercat_pdo_type")) {
             entry.ethercat_pdo_type = param_io::getMember<std::string>(communicationParams, "ethercat_pdo_type");
           }
         }
+
+      } catch (const XmlRpc::XmlRpcException& e) {
+        if (!errors) throw;
+        errors->push_back("[EthercatDeviceConfigurator] Invalid device " + entry.name + ": " + e.getMessage());
       }
 
-      m_slave_entries.push_back(entry);
+      // When validating, devices with errors are not checked further
+      if (errors && errors->size() != error_count) continue;
+      m_slave_entries.push_back(std::move(entry));
     }
   } else {
-    throw std::runtime_error("[EthercatDeviceConfigurator] Node ethercat_devices missing in yaml");
+    setup_error(errors, "[EthercatDeviceConfigurator] Node ethercat_devices missing in yaml");
   }
+  checkUniqueness(errors);
 }
 
-void EthercatDeviceConfigurator::parseFile(std::string path) {
+void EthercatDeviceConfigurator::parseFile(std::string path, std::vector<std::string>* errors) {
   // Check if file exists
-  if (!path_exists(path)) throw std::runtime_error("[EthercatDeviceConfigurator] File not found: " + path);
-  // Load into yaml
-  YAML::Node node = YAML::LoadFile(path);
+  if (!path_exists(path)) {
+    setup_error(errors, "[EthercatDeviceConfigurator] File not found: " + path);
+    return;
+  }
+  // Load into yaml, the cache only reparses the file if it was modified since the last initialization
+  YAML::Node node;
+  try {
+    node = ConfigurationCache::instance().load(path)->node();
+  } catch (const YAML::Exception& e) {
+    if (!errors) throw;
+    errors->push_back("[EthercatDeviceConfigurator] " + path + " is no valid yaml: " + e.what());
+    return;
+  } catch (const std::exception& e) {
+    // e.g. a directory or a file without read permission
+    setup_error(errors, std::string("[EthercatDeviceConfigurator] Could not read ") + path + ": " + e.what());
+    return;
+  }
 
   // Ethercat master configuration
   if (node["ethercat_master_s"]) {
     const YAML::Node& ecat_master_nodes = node["ethercat_master_s"];
     if (ecat_master_nodes.size() == 0) {
-      throw std::runtime_error("[EthercatDeviceConfigurator] Minimum one master must be defined.");
+      setup_error(errors, "[EthercatDeviceConfigurator] Minimum one master must be defined.");
     }
     for (const auto& ecat_master_node : ecat_master_nodes) {
       ecat_master::EthercatMasterConfiguration masterConfiguration{};
-      if (ecat_master_node["name"]) {
-        masterConfiguration.name = ecat_master_node["name"].as<std::string>();
-      }
-      if (ecat_master_node["ethercat_bus"]) {
-        masterConfiguration.networkInterface = ecat_master_node["ethercat_bus"].as<std::string>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] No ethercat_bus defined in master node.");
-      }
-      if (ecat_master_node["time_step"]) {
-        masterConfiguration.timeStep = ecat_master_node["time_step"].as<double>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node time_step missing in ethercat_master");
-      }
-      if (ecat_master_node["update_rate_too_low_warn_threshold"]) {
-        masterConfiguration.updateRateTooLowWarnThreshold = ecat_master_node["update_rate_too_low_warn_threshold"].as<int>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node update_rate_too_low_warn_threshold missing in ethercat_master");
-      }
-      if (ecat_master_node["pdo_size_check"]) {
-        masterConfiguration.pdoSizeCheck = ecat_master_node["pdo_size_check"].as<bool>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node pdo_size_check missing in ethercat_master");
-      }
-      if (ecat_master_node["slave_discover_retries"]) {
-        masterConfiguration.slaveDiscoverRetries = ecat_master_node["slave_discover_retries"].as<unsigned int>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node slave_discover_retries missing in ethercat_master");
-      }
-      if (ecat_master_node["bus_diagnosis"]) {
-        masterConfiguration.doBusDiagnosis = ecat_master_node["bus_diagnosis"].as<bool>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Busdiagnosis filed not defined.");
-      }
-      if (ecat_master_node["error_counter_log"]) {
-        masterConfiguration.logErrorCounters = ecat_master_node["error_counter_log"].as<bool>();
-        if (masterConfiguration.logErrorCounters && !masterConfiguration.doBusDiagnosis) {
-          throw std::runtime_error("[EthercatDeviceConfigurator] Bus diagnosis has to be enabled to log the error counters.");
+      MasterRuntimeConfiguration runtimeConfiguration{};
+      try {
+        if (ecat_master_node["name"]) {
+          masterConfiguration.name = ecat_master_node["name"].as<std::string>();
         }
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] error counter not defined.");
-      }
-      for (const auto& master_config : m_master_configurations) {  // check all previous master config for duplicate bus. throw.
-        if (master_config.networkInterface == masterConfiguration.networkInterface) {
-          throw std::runtime_error(
-              "[EthercatDeviceConfigurator] Two master configurations with the same interface / ethercatbus name defined. Check yaml "
-              "config file");
+        if (ecat_master_node["ethercat_bus"]) {
+          masterConfiguration.networkInterface = ecat_master_node["ethercat_bus"].as<std::string>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] No ethercat_bus defined in master node.");
+        }
+        if (ecat_master_node["time_step"]) {
+          masterConfiguration.timeStep = ecat_master_node["time_step"].as<double>();
+          if (!(masterConfiguration.timeStep > 0.0)) {
+            setup_error(errors, "[EthercatDeviceConfigurator] time_step of master " + masterConfiguration.name + " has to be positive");
+          }
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node time_step missing in ethercat_master");
         }
+        if (ecat_master_node["update_rate_too_low_warn_threshold"]) {
+          masterConfiguration.updateRateTooLowWarnThreshold = ecat_master_node["update_rate_too_low_warn_threshold"].as<int>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node update_rate_too_low_warn_threshold missing in ethercat_master");
+        }
+        if (ecat_master_node["pdo_size_check"]) {
+          masterConfiguration.pdoSizeCheck = ecat_master_node["pdo_size_check"].as<bool>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node pdo_size_check missing in ethercat_master");
+        }
+        if (ecat_master_node["slave_discover_retries"]) {
+          masterConfiguration.slaveDiscoverRetries = ecat_master_node["slave_discover_retries"].as<unsigned int>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node slave_discover_retries missing in ethercat_master");
+        }
+        if (ecat_master_node["bus_diagnosis"]) {
+          masterConfiguration.doBusDiagnosis = ecat_master_node["bus_diagnosis"].as<bool>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Busdiagnosis filed not defined.");
+        }
+        if (ecat_master_node["error_counter_log"]) {
+          masterConfiguration.logErrorCounters = ecat_master_node["error_counter_log"].as<bool>();
+          if (masterConfiguration.logErrorCounters && !masterConfiguration.doBusDiagnosis) {
+            setup_error(errors, "[EthercatDeviceConfigurator] Bus diagnosis has to be enabled to log the error counters.");
+          }
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] error counter not defined.");
+        }
+        // optional, configuration of the cyclic thread used by startRuntime
+        if (ecat_master_node["rt_priority"]) {
+          runtimeConfiguration.rt_priority = ecat_master_node["rt_priority"].as<int>();
+        }
+        if (ecat_master_node["cpu_core"]) {
+          runtimeConfiguration.cpu_core = ecat_master_node["cpu_core"].as<int>();
+        }
+        // optional, replaces the bus with a loopback bus for Virtual devices
+        if (ecat_master_node["virtual_bus"]) {
+          const YAML::Node& virtual_node = ecat_master_node["virtual_bus"];
+          auto& virtual_bus = runtimeConfiguration.virtual_bus;
+          runtimeConfiguration.is_virtual = true;
+          if (virtual_node["latency"]) virtual_bus.latency = virtual_node["latency"].as<double>();
+          if (virtual_node["jitter"]) virtual_bus.jitter = virtual_node["jitter"].as<double>();
+          if (virtual_node["working_counter_error_rate"]) {
+            virtual_bus.working_counter_error_rate = virtual_node["working_counter_error_rate"].as<double>();
+          }
+          if (virtual_node["simulated_time"]) virtual_bus.simulated_time = virtual_node["simulated_time"].as<bool>();
+          if (virtual_node["seed"]) {
+            virtual_bus.seed = virtual_bus_seed(virtual_node["seed"].as<int>(), masterConfiguration.networkInterface, errors);
+          }
+        }
+      } catch (const YAML::Exception& e) {
+        if (!errors) throw;
+        errors->push_back("[EthercatDeviceConfigurator] Invalid master node " + masterConfiguration.networkInterface + ": " + e.what());
       }
+      // When validating, a master with errors is still used to check its devices, unless it has no bus
+      if (masterConfiguration.networkInterface.empty()) continue;
       m_master_configurations.push_back(masterConfiguration);
+      m_master_runtime_configurations.push_back(runtimeConfiguration);
     }
   } else {
-    throw std::runtime_error("[EthercatDeviceConfigurator] Node ethercat_master_s is missing in yaml");
+    setup_error(errors, "[EthercatDeviceConfigurator] Node ethercat_master_s is missing in yaml");
   }
 
   // Check if node is ethercat_devices
   if (node["ethercat_devices"]) {
     // Get all children
     const YAML::Node& nodes = node["ethercat_devices"];
-    if (nodes.size() == 0) throw std::runtime_error("[EthercatDeviceConfigurator] No devices defined in yaml");
+    if (nodes.size() == 0) setup_error(errors, "[EthercatDeviceConfigurator] No devices defined in yaml");
 
     // Iterate through child nodes
     for (YAML::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
       const YAML::Node& child = *it;
       EthercatSlaveEntry entry{};
-      // type - entry
-      if (child["type"]) {
-        auto type_str = child["type"].as<std::string>();
-
-        if (type_str == "Elmo") {
-          entry.type = EthercatSlaveType::Elmo;
-        } else if (type_str == "MPSDrive") {
-          entry.type = EthercatSlaveType::MPSDrive;
-        } else if (type_str == "Maxon") {
-          entry.type = EthercatSlaveType::Maxon;
-        } else if (type_str == "Anydrive") {
-          entry.type = EthercatSlaveType::Anydrive;
-        } else if (type_str == "Rokubi") {
-          entry.type = EthercatSlaveType::Rokubi;
-        } else if (type_str == "EK1100") {
-          entry.type = EthercatSlaveType::EK1100;
-        } else if (type_str == "EL3102") {
-          entry.type = EthercatSlaveType::EL3102;
+      const std::size_t error_count = errors ? errors->size() : 0;
+      try {
+        // type - entry
+        if (child["type"]) {
+          entry.type_name = child["type"].as<std::string>();
+          entry.type = slave_type_from_name(entry.type_name);
+          if (entry.type == EthercatSlaveType::NA && !DeviceFactoryRegistry::instance().providesType(entry.type_name)) {
+            setup_error(errors, "[EthercatDeviceConfigurator] " + entry.type_name + " is an undefined type of ethercat device");
+          }
         } else {
-          throw std::runtime_error("[EthercatDeviceConfigurator] " + type_str + " is an undefined type of ethercat device");
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry type");
         }
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry type");
-      }
 
-      // name - entry
-      if (child["name"]) {
-        entry.name = child["name"].as<std::string>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry name");
-      }
+        // name - entry
+        if (child["name"]) {
+          entry.name = child["name"].as<std::string>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry name");
+        }
 
-      // configuration_file - entry
-      if (child["configuration_file"]) {
-        entry.config_file_path = child["configuration_file"].as<std::string>();
-        entry.has_config_file = true;
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry configuration_file");
-      }
+        // configuration_file - entry
+        if (child["configuration_file"]) {
+          entry.config_file_path = child["configuration_file"].as<std::string>();
+          entry.has_config_file = true;
+        } else if (entry.type != EthercatSlaveType::Virtual) {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry configuration_file");
+        }
 
-      // ethercat_bus_address - entry
-      if (child["ethercat_address"]) {
-        entry.ethercat_address = child["ethercat_address"].as<int>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry ethercat_bus_address");
-      }
+        // ethercat_bus_address - entry
+        if (child["ethercat_address"]) {
+          entry.ethercat_address = child["ethercat_address"].as<int>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry ethercat_bus_address");
+        }
 
-      // ethercat_bus - entry
-      if (child["ethercat_bus"]) {
-        entry.ethercat_bus = child["ethercat_bus"].as<std::string>();
-      } else {
-        throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry ethercat_bus");
-      }
+        // ethercat_bus - entry
+        if (child["ethercat_bus"]) {
+          entry.ethercat_bus = child["ethercat_bus"].as<std::string>();
+        } else {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry ethercat_bus");
+        }
 
-      // ethercat_pdo_type - entry
-      if (entry.type == EthercatSlaveType::Anydrive || entry.type == EthercatSlaveType::Rokubi) {
+        // ethercat_pdo_type - entry, required for the types which support several pdo mappings
         if (child["ethercat_pdo_type"]) {
           entry.ethercat_pdo_type = child["ethercat_pdo_type"].as<std::string>();
-        } else {
-          throw std::runtime_error("[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry ethercat_pdo_type");
+        } else if (entry.type == EthercatSlaveType::Anydrive || entry.type == EthercatSlaveType::Rokubi) {
+          setup_error(errors, "[EthercatDeviceConfigurator] Node: " + child.Tag() + " has no entry ethercat_pdo_type");
         }
+      } catch (const YAML::Exception& e) {
+        if (!errors) throw;
+        errors->push_back("[EthercatDeviceConfigurator] Invalid device node " + entry.name + ": " + e.what());
       }
 
-      m_slave_entries.push_back(entry);
+      // When validating, devices with errors are not checked further
+      if (errors && errors->size() != error_count) continue;
+      m_slave_entries.push_back(std::move(entry));
     }
   } else {
-    throw std::runtime_error("[EthercatDeviceConfigurator] Node ethercat_devices missing in yaml");
+    setup_error(errors, "[EthercatDeviceConfigurator] Node ethercat_devices missing in yaml");
   }
+  checkUniqueness(errors);
 }
 
-void EthercatDeviceConfigurator::setup(bool startup) {
-  for (auto& entry : m_slave_entries) {
-    MELO_DEBUG_STREAM("[EthercatDeviceConfigurator] Creating slave: " << entry.name);
+void EthercatDeviceConfigurator::checkUniqueness(std::vector<std::string>* errors) const {
+  // One pass over the masters and one over the devices with hashed indices, linear in the size of the setup
+  std::unordered_set<std::string_view> interfaces;
+  interfaces.reserve(m_master_configurations.size());
+  for (const auto& master_config : m_master_configurations) {
+    if (!interfaces.insert(master_config.networkInterface).second) {
+      setup_error(errors, "[EthercatDeviceConfigurator] Two master configurations with the same interface / ethercatbus name defined: " +
+                              master_config.networkInterface);
+    }
+  }
+  std::unordered_map<std::string_view, SlaveHandle> names;
+  names.reserve(m_slave_entries.size());
+  // Per bus: address -> first slave with it
+  std::unordered_map<std::string_view, std::unordered_map<uint32_t, SlaveHandle>> addresses;
+  addresses.reserve(m_master_configurations.size());
+  for (SlaveHandle handle = 0; handle < m_slave_entries.size(); handle++) {
+    const auto& entry = m_slave_entries[handle];
+    auto name_it = names.emplace(entry.name, handle);
+    if (!name_it.second) {
+      setup_error(errors, "[EthercatDeviceConfigurator] Two slaves with the same name defined: " + entry.name);
+    }
+    // 0 is no slave position: the parameter server setup leaves the address unset (0) if it is not given
+    if (entry.ethercat_address == 0) continue;
+    auto address_it = addresses[entry.ethercat_bus].emplace(entry.ethercat_address, handle);
+    if (!address_it.second) {
+      setup_error(errors, "[EthercatDeviceConfigurator] Slaves: " + m_slave_entries[address_it.first->second].name + " and " +
+                              entry.name + " have the same ethercat_address " + std::to_string(entry.ethercat_address) +
+                              " on bus: " + entry.ethercat_bus);
+    }
+  }
+}
 
-    std::shared_ptr<ecat_master::EthercatDevice> slave = nullptr;
+std::shared_ptr<ecat_master::EthercatDevice> EthercatDeviceConfigurator::createSlave(const EthercatSlaveEntry& entry) const {
+  MELO_DEBUG_STREAM("[EthercatDeviceConfigurator] Creating slave: " << entry.name);
 
-    switch (entry.type) {
-      case EthercatSlaveType::Elmo: {
-#ifdef _ELMO_FOUND_
-        std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-        slave = elmo::Elmo::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address);
-#else
-        throw std::runtime_error("elmo_ethercat_sdk not availabe.");
-#endif
-      } break;
-      case EthercatSlaveType::MPSDrive: {
-#ifdef _MPSDRIVE_FOUND_
-        std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-        slave = mps_ethercat_sdk::MPSDrive::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address);
-#else
-        throw std::runtime_error("mps_ethercat_sdk configured in ethercat setup.yaml but dependency not found.");
-#endif
+  // handleFilePath takes care of creating an absolute path from the path in the setup.yaml
+  std::string configuration_file_path;
+  if (entry.has_config_file) {
+    StartupProfiler::Scope phase(m_startup_profiler, "handleFilePath", "slave", entry.name);
+    configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
+  }
+  // The factory of the sdk is loaded on first use if it is a plugin
+  StartupProfiler::Scope phase(m_startup_profiler, entry.has_config_file ? "deviceFromFile" : "createDevice", "slave", entry.name);
+  return DeviceFactoryRegistry::instance().create(entry, configuration_file_path);
+}
 
-      } break;
-      case EthercatSlaveType::Maxon: {
-#ifdef _MAXON_FOUND_
-        std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-        slave = maxon::Maxon::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address);
-#else
-        throw std::runtime_error("maxon_epos_ethercat_sdk not availabe.");
-#endif
+std::vector<std::shared_ptr<ecat_master::EthercatDevice>> EthercatDeviceConfigurator::createSlaves(
+    const std::vector<EthercatSlaveEntry>& entries, const std::vector<SlaveHandle>& handles, std::vector<std::string>* errors) const {
+  // Every slave parses its own configuration file. Each thread only writes the slots of the entries it took, therefore the slaves keep
+  // the order of the entries.
+  std::vector<std::shared_ptr<ecat_master::EthercatDevice>> slaves(entries.size());
+  // A failure is marked separately from its message, which may be empty
+  std::vector<char> slave_failed(entries.size(), 0);
+  std::vector<std::string> slave_errors(entries.size());
+  std::atomic<std::size_t> next_handle{0};
+  StartupProfiler::Scope phase(m_startup_profiler, "createSlaves");
+  auto createNext = [&]() {
+    for (std::size_t i = next_handle++; i < handles.size(); i = next_handle++) {
+      const SlaveHandle handle = handles[i];
+      StartupProfiler::Scope slave_phase(m_startup_profiler, "createSlave", "slave", entries[handle].name, phase.id());
+      // Nothing may escape the worker threads
+      try {
+        slaves[handle] = createSlave(entries[handle]);
+        if (!slaves[handle]) slave_errors[handle] = "the device factory returned no device";
+      } catch (const std::exception& e) {
+        slave_errors[handle] = *e.what() ? e.what() : "exception without message";
+      } catch (...) {
+        slave_errors[handle] = "unknown exception";
+      }
+      if (!slaves[handle]) {
+        slave_failed[handle] = 1;
+        slave_phase.fail();
+      }
+    }
+  };
 
-      } break;
-      case EthercatSlaveType::Anydrive: {
-#ifdef _ANYDRIVE_FOUND_
-        anydrive_rsl::PdoTypeEnum pdo = anydrive_rsl::PdoTypeEnum::NA;
-
-        if (entry.ethercat_pdo_type == "A") {
-          pdo = anydrive_rsl::PdoTypeEnum::A;
-        } else if (entry.ethercat_pdo_type == "B") {
-          pdo = anydrive_rsl::PdoTypeEnum::B;
-        } else if (entry.ethercat_pdo_type == "C") {
-          pdo = anydrive_rsl::PdoTypeEnum::C;
-        } else if (entry.ethercat_pdo_type == "D") {
-          pdo = anydrive_rsl::PdoTypeEnum::D;
-        } else if (entry.ethercat_pdo_type == "E") {
-          pdo = anydrive_rsl::PdoTypeEnum::E;
-        } else {
-          throw std::runtime_error("[EthercatDeviceConfigurator] PDO unknown: " + entry.ethercat_pdo_type);
-        }
+  // Serial unless more threads were requested, the sdks do not guarantee that their parsing is thread safe
+  std::size_t number_of_threads = m_construction_threads;
+  if (number_of_threads == 0) number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+  number_of_threads = std::min(number_of_threads, handles.size());
+  if (number_of_threads > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(number_of_threads);
+    for (std::size_t i = 0; i < number_of_threads; i++) {
+      threads.emplace_back(createNext);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  } else {
+    createNext();
+  }
 
-        if (entry.has_config_file) {
-          // handleFilePath takes care of creating an absolute path from the path in the setup.yaml
-          std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-          slave = anydrive_rsl::AnydriveEthercatSlave::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address, pdo);
-        } else {
-          slave = anydrive_rsl::AnydriveEthercatSlave::deviceFromRosParameterServer(entry.config_params, entry.name, entry.ethercat_address,
-                                                                                    pdo);
-        }
-#else
-        throw std::runtime_error("anydrive_sdk configured in ethercat setup.yaml but dependency not found.");
-#endif
-      } break;
-
-      case EthercatSlaveType::Rokubi: {
-#ifdef _ROKUBI_FOUND_
-        rokubimini::ethercat::PdoTypeEnum pdo = rokubimini::ethercat::PdoTypeEnum::NA;
-        if (entry.ethercat_pdo_type == "A") {
-          pdo = rokubimini::ethercat::PdoTypeEnum::A;
-        } else if (entry.ethercat_pdo_type == "B") {
-          pdo = rokubimini::ethercat::PdoTypeEnum::B;
-        } else if (entry.ethercat_pdo_type == "C") {
-          pdo = rokubimini::ethercat::PdoTypeEnum::C;
-        } else if (entry.ethercat_pdo_type == "Z") {
-          pdo = rokubimini::ethercat::PdoTypeEnum::Z;
-        } else if (entry.ethercat_pdo_type == "EXTIMU") {
-          pdo = rokubimini::ethercat::PdoTypeEnum::EXTIMU;
-        } else {
-          throw std::runtime_error("[EthercatDeviceConfigurator] PDO unknown: " + entry.ethercat_pdo_type);
-        }
+  std::string error_message;
+  for (SlaveHandle handle : handles) {
+    if (!slave_failed[handle]) continue;
+    if (errors) {
+      errors->push_back("[EthercatDeviceConfigurator] Could not create slave " + entries[handle].name + ": " + slave_errors[handle]);
+    } else {
+      error_message += "\n  " + entries[handle].name + ": " + slave_errors[handle];
+    }
+  }
+  if (!error_message.empty()) {
+    throw std::runtime_error("[EthercatDeviceConfigurator] Could not create slave(s):" + error_message);
+  }
+  return slaves;
+}
 
-        // Handle configuration file path
-        if (entry.has_config_file) {
-          // handleFilePath takes care of creating an absolute path from the path in the setup.yaml
-          std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-          slave =
-              rokubimini::ethercat::RokubiminiEthercat::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address, pdo);
-        } else {
-          slave = rokubimini::ethercat::RokubiminiEthercat::deviceFromRosParameterServer(entry.config_params, entry.name,
-                                                                                         entry.ethercat_address, pdo);
-        }
-#else
-        throw std::runtime_error("rokubimini_ethercat_sdk configured in ethercat setup.yaml but dependency not found.");
-#endif
-      } break;
-      case EthercatSlaveType::EK1100: {
-#ifdef _EK1100_FOUND_
-        if (entry.has_config_file) {
-          std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-          slave = beckhoff::ek1100::EK1100::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address);
-        } else {
-          throw std::runtime_error("EK1100 configuring from ros1 parameter server not supported yet.");
-        }
-#else
-        throw std::runtime_error("EK1100 configured in ethercat setup.yaml but dependency not found.");
-#endif
-      } break;
-      case EthercatSlaveType::EL3102: {
-#ifdef _EL3102_FOUND_
-        if (entry.has_config_file) {
-          std::string configuration_file_path = handleFilePath(entry.config_file_path, m_setup_file_path);
-          slave = beckhoff::el3102::EL3102::deviceFromFile(configuration_file_path, entry.name, entry.ethercat_address);
-        } else {
-          throw std::runtime_error("EL3102 configuring from ros1 parameter server not supported yet.");
-        }
-#else
-        throw std::runtime_error("EL3102 configured in ethercat setup.yaml but dependency not found.");
-#endif
-      } break;
-      default:
-        throw std::runtime_error("[EthercatDeviceConfigurator] Not existing EthercatSlaveType passed");
-        break;
+std::unique_ptr<EthercatDeviceConfigurator::MasterRuntime> EthercatDeviceConfigurator::createMaster(
+    const ecat_master::EthercatMasterConfiguration& master_config, const MasterRuntimeConfiguration& runtime_configuration) const {
+  StartupProfiler::Scope phase(m_startup_profiler, "createMaster", "bus", master_config.networkInterface);
+  auto runtime = std::make_unique<MasterRuntime>();
+  runtime->configuration = runtime_configuration;
+  if (runtime->configuration.is_virtual) {
+    // No master: an update of a master whose interface was never opened would reach SOEM
+    runtime->virtual_bus =
+        std::make_shared<VirtualBus>(master_config.networkInterface, master_config.timeStep, runtime->configuration.virtual_bus);
+  } else {
+    runtime->master = std::make_shared<ecat_master::EthercatMaster>();
+    runtime->master->loadEthercatMasterConfiguration(master_config);
+  }
+  runtime->bus = master_config.networkInterface;
+  runtime->timing.nominal_period = static_cast<int64_t>(master_config.timeStep * 1e9);
+  return runtime;
+}
+
+void EthercatDeviceConfigurator::attachSlave(const std::shared_ptr<ecat_master::EthercatDevice>& slave, const EthercatSlaveEntry& entry,
+                                             MasterRuntime& runtime) const {
+  StartupProfiler::Scope phase(m_startup_profiler, "attachDevice", "slave", entry.name);
+
+  // Virtual devices only run on virtual buses and vice versa
+  const auto& virtual_bus = runtime.virtual_bus;
+  if (virtual_bus || entry.type == EthercatSlaveType::Virtual) {
+    auto virtual_device = std::dynamic_pointer_cast<VirtualDevice>(slave);
+    if (!virtual_bus || !virtual_device) {
+      throw std::runtime_error("[EthercatDeviceConfigurator] Slave: " + slave->getName() + " on bus: " + entry.ethercat_bus +
+                               ", Virtual devices can only be used on virtual buses and virtual buses only take Virtual devices");
+    }
+    virtual_bus->attachDevice(virtual_device);
+    return;
+  }
+  // Yes we attach the slave
+  if (!runtime.master->attachDevice(slave)) {
+    throw std::runtime_error("[EthercatDeviceConfigurator] could not attach slave: " + slave->getName() +
+                             " to master on interface: " + entry.ethercat_bus);
+  }
+}
+
+// Canonical path of the configuration file of an entry, empty if it has none. Falls back to the path as written if it cannot be resolved.
+static std::string resolved_configuration_path(const EthercatDeviceConfigurator::EthercatSlaveEntry& entry,
+                                               const std::string& setup_file_path) {
+  if (!entry.has_config_file) return "";
+  try {
+    std::string canonical_path;
+    ConfigurationCache::instance().resolvePath(entry.config_file_path, setup_file_path, &canonical_path);
+    return canonical_path;
+  } catch (const std::exception&) {
+    return entry.config_file_path;
+  }
+}
+
+// Content hash of the configuration file of every entry as it was created, from its modification time at creation. std::nullopt if the
+// file was modified (or the time is unknown), 0 if the entry has none or it cannot be read.
+static std::vector<std::optional<uint64_t>> creation_configuration_hashes(
+    const std::vector<EthercatDeviceConfigurator::EthercatSlaveEntry>& entries, const std::vector<int64_t>& modification_times,
+    const std::string& setup_file_path) {
+  std::vector<std::optional<uint64_t>> hashes(entries.size(), uint64_t{0});
+  for (std::size_t index = 0; index < entries.size(); index++) {
+    if (!entries[index].has_config_file) continue;
+    try {
+      // Mostly the cached document read by the device creation (Virtual devices) or a validation
+      auto document = ConfigurationCache::instance().load(resolved_configuration_path(entries[index], setup_file_path));
+      hashes[index] = document->modificationTime() == modification_times[index] ? std::optional<uint64_t>(document->hash()) : std::nullopt;
+    } catch (const std::exception&) {
+      hashes[index] = std::nullopt;
     }
-    m_slaves.push_back(slave);
-    m_slave_to_entry_map.insert({slave, entry});
+  }
+  return hashes;
+}
+
+// Content hash of the configuration file of every entry, 0 if an entry has none or it cannot be read.
+static std::vector<uint64_t> configuration_hashes(const std::vector<EthercatDeviceConfigurator::EthercatSlaveEntry>& entries,
+                                                  const std::string& setup_file_path) {
+  std::vector<uint64_t> hashes(entries.size(), 0);
+  for (std::size_t index = 0; index < entries.size(); index++) {
+    if (!entries[index].has_config_file) continue;
+    try {
+      hashes[index] = ConfigurationCache::instance().load(resolved_configuration_path(entries[index], setup_file_path))->hash();
+    } catch (const std::exception&) {
+      hashes[index] = 0;
+    }
+  }
+  return hashes;
+}
+
+void EthercatDeviceConfigurator::setup(bool startup) {
+  StartupProfiler::Scope phase(m_startup_profiler, "setup");
+  std::vector<SlaveHandle> handles(m_slave_entries.size());
+  for (SlaveHandle handle = 0; handle < handles.size(); handle++) {
+    handles[handle] = handle;
+  }
+  std::vector<std::shared_ptr<ecat_master::EthercatDevice>> slaves = createSlaves(m_slave_entries, handles);
+  // Compared by the first applyConfiguration to detect modified configuration files. Only the modification times recorded when the
+  // paths were resolved, the files are not read again.
+  m_slave_configuration_times.assign(m_slave_entries.size(), 0);
+  for (SlaveHandle handle = 0; handle < m_slave_entries.size(); handle++) {
+    const auto& entry = m_slave_entries[handle];
+    if (!entry.has_config_file) continue;
+    auto& time = m_slave_configuration_times[handle];
+    ConfigurationCache::instance().resolvedModificationTime(entry.config_file_path, m_setup_file_path, time);
+  }
+  m_slave_configuration_hashes.clear();
+
+  m_slaves.reserve(m_slaves.size() + slaves.size());
+  m_slave_handles.reserve(m_slaves.size() + slaves.size());
+  for (auto& slave : slaves) {
+    // The handle of a slave is its index in m_slaves, which matches the index of its entry in m_slave_entries.
+    m_slave_handles.emplace(slave.get(), m_slaves.size());
+    m_slaves.push_back(std::move(slave));
   }
 
   // Create the defined master
-  for (const auto& master_config : m_master_configurations) {
-    std::shared_ptr<ecat_master::EthercatMaster> master = std::make_shared<ecat_master::EthercatMaster>();
-    master->loadEthercatMasterConfiguration(master_config);
-    m_masters.push_back(master);
+  for (std::size_t index = 0; index < m_master_configurations.size(); index++) {
+    auto runtime = createMaster(m_master_configurations[index], m_master_runtime_configurations[index]);
+    m_bus_indices.emplace(runtime->bus, m_masters.size());
+    m_masters.push_back(runtime->master);
+    m_virtual_buses.push_back(runtime->virtual_bus);
+    m_master_runtimes.push_back(std::move(runtime));
   }
 
   // Add the slave to the masters, throws if there is not a suited master or if there is a master without slaves
   // (this adds a cross check to the yaml file)
-  for (auto& slave : m_slaves) {
-    // Find entry object for each slave because the slave base class does not provide info about the interface name
-    EthercatSlaveEntry entry = m_slave_to_entry_map[slave];
-
-    // See if we already have a master for that interface
-    bool master_found = false;
-    for (auto& master : m_masters) {
-      if (master->getConfiguration().networkInterface == entry.ethercat_bus) {
-        master_found = true;
-        // Yes we attach the slave
-        if (!master->attachDevice(slave)) {
-          throw std::runtime_error("[EthercatDeviceConfigurator] could not attach slave: " + slave->getName() +
-                                   " to master on interface: " + master->getConfiguration().networkInterface);
-        }
-        break;
+  {
+    StartupProfiler::Scope attach_phase(m_startup_profiler, "attachSlaves");
+    for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+      // Find entry object for each slave because the slave base class does not provide info about the interface name
+      const auto& entry = m_slave_entries[handle];
+      auto bus_it = m_bus_indices.find(entry.ethercat_bus);
+      if (bus_it == m_bus_indices.end()) {
+        throw std::runtime_error("[EthercatDeviceConfigurator] No master found for slave " + entry.name +
+                                 " check if ethercat bus matches in yaml file");
       }
+      attachSlave(m_slaves[handle], entry, *m_master_runtimes[bus_it->second]);
+    }
+  }
+
+  buildSlaveIndices();
+
+  if (startup) {
+    std::string errors;
+    std::vector<std::size_t> master_indices(m_masters.size());
+    for (std::size_t index = 0; index < m_masters.size(); index++) {
+      master_indices[index] = index;
+    }
+    for (const auto& report : startupMasters(master_indices, m_parallel_startup)) {
+      if (!report.success) {
+        errors += "\n  " + report.ethercat_bus + ": " + report.error;
+      }
+    }
+    if (!errors.empty()) {
+      throw std::runtime_error("[EthercatDeviceConfigurator] could not start master on interface(s):" + errors);
+    }
+  }
+}
+
+static bool same_master_configuration(const ecat_master::EthercatMasterConfiguration& a,
+                                      const ecat_master::EthercatMasterConfiguration& b) {
+  return a.name == b.name && a.networkInterface == b.networkInterface && a.timeStep == b.timeStep &&
+         a.updateRateTooLowWarnThreshold == b.updateRateTooLowWarnThreshold && a.slaveDiscoverRetries == b.slaveDiscoverRetries &&
+         a.pdoSizeCheck == b.pdoSizeCheck && a.doBusDiagnosis == b.doBusDiagnosis && a.logErrorCounters == b.logErrorCounters;
+}
+
+static bool same_runtime_configuration(const EthercatDeviceConfigurator::MasterRuntimeConfiguration& a,
+                                       const EthercatDeviceConfigurator::MasterRuntimeConfiguration& b) {
+  return a.rt_priority == b.rt_priority && a.cpu_core == b.cpu_core && a.is_virtual == b.is_virtual &&
+         (!a.is_virtual || (a.virtual_bus.latency == b.virtual_bus.latency && a.virtual_bus.jitter == b.virtual_bus.jitter &&
+                            a.virtual_bus.working_counter_error_rate == b.virtual_bus.working_counter_error_rate &&
+                            a.virtual_bus.simulated_time == b.virtual_bus.simulated_time && a.virtual_bus.seed == b.virtual_bus.seed));
+}
+
+// Compares everything but the configuration file, which is compared by its resolved path and content hash
+static bool same_slave_entry(const EthercatDeviceConfigurator::EthercatSlaveEntry& a,
+                             const EthercatDeviceConfigurator::EthercatSlaveEntry& b) {
+  return a.type_name == b.type_name && a.name == b.name && a.has_config_file == b.has_config_file &&
+         a.ethercat_address == b.ethercat_address && a.ethercat_bus == b.ethercat_bus && a.ethercat_pdo_type == b.ethercat_pdo_type;
+}
+
+EthercatDeviceConfigurator::ReconfigurationReport EthercatDeviceConfigurator::applyConfiguration(const std::string& path, bool startup) {
+  ReconfigurationReport report;
+  profileInitialization("applyConfiguration", path, [&]() { report = reconfigure(path, startup); });
+  return report;
+}
+
+EthercatDeviceConfigurator::ReconfigurationReport EthercatDeviceConfigurator::reconfigure(const std::string& path, bool startup) {
+  // Parse into a scratch configurator, an invalid setup leaves this one untouched.
+  EthercatDeviceConfigurator next;
+  next.m_setup_file_path = path;
+  {
+    StartupProfiler::Scope phase(m_startup_profiler, "parseFile");
+    next.parseFile(path);
+  }
+  const auto& next_masters = next.m_master_configurations;
+  const auto& next_entries = next.m_slave_entries;
+  std::vector<uint64_t> next_hashes;
+  {
+    StartupProfiler::Scope phase(m_startup_profiler, "configurationHashes");
+    next_hashes = configuration_hashes(next_entries, path);
+    if (m_slave_configuration_hashes.size() != m_slave_entries.size()) {
+      m_slave_configuration_hashes = creation_configuration_hashes(m_slave_entries, m_slave_configuration_times, m_setup_file_path);
     }
+  }
 
-    // No we create new master
-    if (!master_found) {
-      throw std::runtime_error("[EthercatDeviceConfigurator] No master found for slave " + slave->getName() +
+  std::unordered_map<std::string, std::size_t> next_bus_indices;
+  for (std::size_t index = 0; index < next_masters.size(); index++) {
+    next_bus_indices.emplace(next_masters[index].networkInterface, index);
+  }
+  // Handles of the slaves of every bus in setup order, for the current and the new entries
+  std::vector<std::vector<SlaveHandle>> next_bus_handles(next_masters.size());
+  for (SlaveHandle handle = 0; handle < next_entries.size(); handle++) {
+    const auto& entry = next_entries[handle];
+    auto bus_it = next_bus_indices.find(entry.ethercat_bus);
+    if (bus_it == next_bus_indices.end()) {
+      throw std::runtime_error("[EthercatDeviceConfigurator] No master found for slave " + entry.name +
                                " check if ethercat bus matches in yaml file");
     }
+    if (next.m_master_runtime_configurations[bus_it->second].is_virtual != (entry.type == EthercatSlaveType::Virtual)) {
+      throw std::runtime_error("[EthercatDeviceConfigurator] Slave: " + entry.name + " on bus: " + entry.ethercat_bus +
+                               ", Virtual devices can only be used on virtual buses and virtual buses only take Virtual devices");
+    }
+    next_bus_handles[bus_it->second].push_back(handle);
+  }
+  std::vector<std::vector<SlaveHandle>> bus_handles(m_masters.size());
+  for (SlaveHandle handle = 0; handle < m_slave_entries.size(); handle++) {
+    bus_handles[m_bus_indices.at(m_slave_entries[handle].ethercat_bus)].push_back(handle);
   }
 
-  if (startup) {
-    for (auto& master : m_masters) {
-      MELO_DEBUG("Starting master on: " + master->getConfiguration().networkInterface)
-      if (!master->startup()) {  // no abort when started like this..
-        throw std::runtime_error("[EthercatDeviceConfigurator] could not start master on interface: " +
-                                 master->getConfiguration().networkInterface);
+  // A bus is kept if its master, its runtime configuration and its ordered slave entries including their configuration files are equal
+  ReconfigurationReport report;
+  constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+  // Per new master: index of the current master it keeps, none if it is (re)built
+  std::vector<std::size_t> kept(next_masters.size(), none);
+  std::vector<bool> is_kept(m_masters.size(), false);
+  for (std::size_t index = 0; index < next_masters.size(); index++) {
+    const std::string& bus = next_masters[index].networkInterface;
+    auto bus_it = m_bus_indices.find(bus);
+    if (bus_it == m_bus_indices.end()) {
+      report.added_buses.push_back(bus);
+      continue;
+    }
+    const std::size_t current = bus_it->second;
+    const auto& handles = bus_handles[current];
+    const auto& new_handles = next_bus_handles[index];
+    bool unchanged = same_master_configuration(m_master_configurations[current], next_masters[index]) &&
+                     same_runtime_configuration(m_master_runtime_configurations[current], next.m_master_runtime_configurations[index]) &&
+                     handles.size() == new_handles.size();
+    for (std::size_t i = 0; unchanged && i < handles.size(); i++) {
+      const auto& entry = m_slave_entries[handles[i]];
+      const auto& new_entry = next_entries[new_handles[i]];
+      unchanged = same_slave_entry(entry, new_entry) && m_slave_configuration_hashes[handles[i]] == next_hashes[new_handles[i]] &&
+                  resolved_configuration_path(entry, m_setup_file_path) == resolved_configuration_path(new_entry, path);
+    }
+    if (unchanged) {
+      kept[index] = current;
+      is_kept[current] = true;
+      report.unchanged_buses.push_back(bus);
+    } else {
+      report.restarted_buses.push_back(bus);
+    }
+  }
+  for (std::size_t current = 0; current < m_masters.size(); current++) {
+    if (next_bus_indices.count(m_master_configurations[current].networkInterface) == 0) {
+      report.removed_buses.push_back(m_master_configurations[current].networkInterface);
+    }
+  }
+
+  // Create the slaves of the rebuilt buses before anything is shut down, createSlave resolves their files relative to the new setup.
+  std::vector<SlaveHandle> created_handles;
+  for (std::size_t index = 0; index < next_masters.size(); index++) {
+    if (kept[index] == none) created_handles.insert(created_handles.end(), next_bus_handles[index].begin(), next_bus_handles[index].end());
+  }
+  std::sort(created_handles.begin(), created_handles.end());
+  const std::string current_setup_file_path = m_setup_file_path;
+  m_setup_file_path = path;
+  // Build the complete new state in the scratch configurator and the new runtimes, this one is only touched after everything succeeded.
+  std::vector<std::unique_ptr<MasterRuntime>> runtimes(next_masters.size());
+  std::vector<std::size_t> rebuilt_masters;
+  try {
+    next.m_slaves = createSlaves(next_entries, created_handles);
+    for (std::size_t index = 0; index < next_masters.size(); index++) {
+      if (kept[index] == none) {
+        runtimes[index] = createMaster(next_masters[index], next.m_master_runtime_configurations[index]);
+        rebuilt_masters.push_back(index);
+      }
+      const MasterRuntime& runtime = kept[index] == none ? *runtimes[index] : *m_master_runtimes[kept[index]];
+      next.m_bus_indices.emplace(runtime.bus, index);
+      next.m_masters.push_back(runtime.master);
+      next.m_virtual_buses.push_back(runtime.virtual_bus);
+      // The kept slaves move to the handles of their new entries
+      for (std::size_t i = 0; kept[index] != none && i < next_bus_handles[index].size(); i++) {
+        next.m_slaves[next_bus_handles[index][i]] = m_slaves[bus_handles[kept[index]][i]];
       }
     }
+    {
+      StartupProfiler::Scope phase(m_startup_profiler, "attachSlaves");
+      for (SlaveHandle handle : created_handles) {
+        attachSlave(next.m_slaves[handle], next_entries[handle], *runtimes[next_bus_indices.at(next_entries[handle].ethercat_bus)]);
+      }
+    }
+    next.m_slave_handles.reserve(next.m_slaves.size());
+    for (SlaveHandle handle = 0; handle < next.m_slaves.size(); handle++) {
+      next.m_slave_handles.emplace(next.m_slaves[handle].get(), handle);
+    }
+    next.buildSlaveIndices();
+    next.m_slave_configuration_hashes.assign(next_hashes.begin(), next_hashes.end());
+  } catch (...) {
+    m_setup_file_path = current_setup_file_path;
+    throw;
   }
+
+  // The handles and master indices only stay valid if every bus is kept at its index with its slaves at their handles
+  bool same_handles = next_masters.size() == m_masters.size() && next_entries.size() == m_slave_entries.size();
+  for (std::size_t index = 0; same_handles && index < next_masters.size(); index++) {
+    same_handles = kept[index] == index;
+  }
+  for (SlaveHandle handle = 0; same_handles && handle < next_entries.size(); handle++) {
+    same_handles = next_entries[handle].name == m_slave_entries[handle].name;
+  }
+
+  // From here on the new configuration is applied. Shut down the changed and removed buses, the others keep cycling.
+  std::lock_guard<std::mutex> lock(m_lifecycle_mutex);
+  joinLifecycleThreads();
+  if (!same_handles) {
+    // Their callbacks stay on the kept buses but return immediately from now on
+    for (const auto& snapshot : m_joint_state_snapshots) {
+      if (auto locked = snapshot.lock()) locked->detach();
+    }
+    for (const auto& shared_memory : m_shared_memory_exports) {
+      if (auto locked = shared_memory.lock()) locked->detach();
+    }
+    m_joint_state_snapshots.clear();
+    m_shared_memory_exports.clear();
+  }
+  for (std::size_t current = 0; current < m_masters.size(); current++) {
+    if (is_kept[current]) continue;
+    auto& runtime = *m_master_runtimes[current];
+    MELO_INFO_STREAM("[EthercatDeviceConfigurator] Shutting down bus: " << runtime.bus)
+    try {
+      shutdownMaster(runtime);
+    } catch (const std::exception& exception) {
+      // The bus is dropped regardless, the cyclic thread has to be gone before its runtime is destroyed
+      runtime.running = false;
+      if (runtime.thread.joinable()) runtime.thread.join();
+      MELO_WARN_STREAM("[EthercatDeviceConfigurator] Shutdown of bus: " << runtime.bus << " failed: " << exception.what())
+    }
+  }
+  for (std::size_t index = 0; index < next_masters.size(); index++) {
+    if (kept[index] != none) runtimes[index] = std::move(m_master_runtimes[kept[index]]);
+  }
+
+  m_master_configurations = std::move(next.m_master_configurations);
+  m_master_runtime_configurations = std::move(next.m_master_runtime_configurations);
+  m_slave_entries = std::move(next.m_slave_entries);
+  m_slave_configuration_hashes = std::move(next.m_slave_configuration_hashes);
+  m_slaves = std::move(next.m_slaves);
+  m_slave_handles = std::move(next.m_slave_handles);
+  m_slave_name_indices = std::move(next.m_slave_name_indices);
+  m_master_runtimes = std::move(runtimes);
+  m_masters = std::move(next.m_masters);
+  m_virtual_buses = std::move(next.m_virtual_buses);
+  m_bus_indices = std::move(next.m_bus_indices);
+  m_bus_slaves = std::move(next.m_bus_slaves);
+  m_typed_slaves = std::move(next.m_typed_slaves);
+  m_typed_bus_slaves = std::move(next.m_typed_bus_slaves);
+  m_typed_bus_offsets = std::move(next.m_typed_bus_offsets);
+
+  if (startup && !rebuilt_masters.empty()) {
+    std::string errors;
+    for (const auto& startup_report : startupMasters(rebuilt_masters, m_parallel_startup)) {
+      if (!startup_report.success) {
+        errors += "\n  " + startup_report.ethercat_bus + ": " + startup_report.error;
+      }
+    }
+    if (m_runtime_running) {
+      for (std::size_t index : rebuilt_masters) {
+        if (m_master_runtimes[index]->started) startMasterRuntime(*m_master_runtimes[index]);
+      }
+    }
+    if (!errors.empty()) {
+      throw std::runtime_error("[EthercatDeviceConfigurator] could not start master on interface(s):" + errors);
+    }
+  }
+  return report;
 }
 
-std::string EthercatDeviceConfigurator::handleFilePath(const std::string& path, const std::string& setup_file_path) const {
-  std::string result_path = "";
-  if (path.front() == '/') {
-    result_path = path;
-    // Path to the configuration file is absolute, we can use it as is.
-  } else if (path.front() == '~') {
-    // Path to the configuration file is absolute, we need to replace '~' with the home directory.
-    const char* homeDirectory = getenv("HOME");
-    if (homeDirectory == nullptr)
-      throw std::runtime_error("[EthercatDeviceConfigurator] Environment variable 'HOME' could not be evaluated.");
-    result_path = path;
-    result_path.erase(result_path.begin());
-    result_path = homeDirectory + result_path;
-  } else {
-    // Path to the configuration file is relative, we need to append it to the path of the setup file.
-    result_path = setup_file_path.substr(0, setup_file_path.find_last_of("/") + 1) + path;
+void EthercatDeviceConfigurator::buildSlaveIndices() {
+  StartupProfiler::Scope phase(m_startup_profiler, "buildSlaveIndices");
+  // Names are unique, checked by the parsers.
+  m_slave_name_indices.clear();
+  m_slave_name_indices.reserve(m_slaves.size());
+  for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+    m_slave_name_indices.emplace(m_slave_entries[handle].name, handle);
+  }
+
+  // setup guarantees that every slave has a master, so m_bus_indices contains every bus of the slave entries.
+  m_bus_slaves.assign(m_masters.size(), {});
+  for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+    m_bus_slaves[m_bus_indices.at(m_slave_entries[handle].ethercat_bus)].push_back(m_slaves[handle]);
   }
-  if (!path_exists(result_path)) throw std::runtime_error("Path: " + result_path + " does not exist");
-  return result_path;
+
+  // Per type in setup order, and by a stable counting sort by bus for contiguous (type, bus) ranges.
+  for (std::size_t type = 0; type < numberOfSlaveTypes; type++) {
+    auto& offsets = m_typed_bus_offsets[type];
+    offsets.assign(m_masters.size() + 1, 0);
+    for (const auto& entry : m_slave_entries) {
+      if (static_cast<std::size_t>(entry.type) == type) offsets[m_bus_indices.at(entry.ethercat_bus) + 1]++;
+    }
+    for (std::size_t bus = 0; bus < m_masters.size(); bus++) {
+      offsets[bus + 1] += offsets[bus];
+    }
+
+    auto& typed = m_typed_slaves[type];
+    typed.clear();
+    typed.reserve(offsets.back());
+    auto& typed_by_bus = m_typed_bus_slaves[type];
+    typed_by_bus.assign(offsets.back(), nullptr);
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (SlaveHandle handle = 0; handle < m_slaves.size(); handle++) {
+      const auto& entry = m_slave_entries[handle];
+      if (static_cast<std::size_t>(entry.type) != type) continue;
+      typed.push_back(m_slaves[handle]);
+      typed_by_bus[fill[m_bus_indices.at(entry.ethercat_bus)]++] = m_slaves[handle];
+    }
+  }
+}
+
+std::string EthercatDeviceConfigurator::handleFilePath(const std::string& path, const std::string& setup_file_path) const {
+  // Resolved once per process for every (path, setup file) pair, e.g. multiple drives sharing one configuration file. The device sdks
+  // still parse the file once per device.
+  return ConfigurationCache::instance().resolvePath(path, setup_file_path);
 }
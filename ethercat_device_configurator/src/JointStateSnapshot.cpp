@@ -0,0 +1,122 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/JointStateSnapshot.hpp"
+
+JointStateSnapshot::JointStateSnapshot(std::vector<Slave> slaves, std::size_t number_of_masters)
+    : m_slaves(std::move(slaves)), m_states(number_of_masters > 1 ? m_slaves.size() : 0), m_commands(m_slaves.size()) {
+  for (std::size_t master = 0; master < number_of_masters; master++) {
+    m_masters.push_back(std::make_unique<MasterExchange>(m_slaves.size()));
+  }
+  for (std::size_t handle = 0; handle < m_slaves.size(); handle++) {
+    const auto& adapter = m_slaves[handle].adapter;
+    if (adapter.reading_layout == SharedMemoryDataLayout::None && adapter.command_layout == SharedMemoryDataLayout::None) continue;
+    m_masters.at(m_slaves[handle].master)->handles.push_back(handle);
+  }
+}
+
+bool JointStateSnapshot::update() {
+  bool fresh = false;
+  for (auto& master : m_masters) {
+    if (!master->states.update()) continue;
+    fresh = true;
+    if (m_masters.size() == 1) break;
+    const auto& states = master->states.readBuffer();
+    for (const auto handle : master->handles) {
+      m_states.position[handle] = states.position[handle];
+      m_states.velocity[handle] = states.velocity[handle];
+      m_states.torque[handle] = states.torque[handle];
+      m_states.current[handle] = states.current[handle];
+      m_states.state[handle] = states.state[handle];
+      for (std::size_t axis = 0; axis < 3; axis++) {
+        m_states.force[axis][handle] = states.force[axis][handle];
+        m_states.moment[axis][handle] = states.moment[axis][handle];
+      }
+      m_states.cycle[handle] = states.cycle[handle];
+    }
+  }
+  return fresh;
+}
+
+const JointStates& JointStateSnapshot::getStates() const {
+  if (m_masters.size() == 1) return m_masters.front()->states.readBuffer();
+  return m_states;
+}
+
+void JointStateSnapshot::publishCommands() {
+  for (auto& master : m_masters) {
+    auto& commands = master->commands.writeBuffer();
+    for (const auto handle : master->handles) {
+      commands.position[handle] = m_commands.position[handle];
+      commands.velocity[handle] = m_commands.velocity[handle];
+      commands.torque[handle] = m_commands.torque[handle];
+      commands.current[handle] = m_commands.current[handle];
+      commands.mode[handle] = m_commands.mode[handle];
+      commands.enabled[handle] = m_commands.enabled[handle];
+    }
+    master->commands.publish();
+  }
+}
+
+void JointStateSnapshot::cycle(std::size_t master_index) {
+  if (!m_attached.load(std::memory_order_acquire)) return;
+  auto& master = *m_masters[master_index];
+  if (master.commands.update()) {
+    const auto& commands = master.commands.readBuffer();
+    for (const auto handle : master.handles) {
+      const auto& slave = m_slaves[handle];
+      if (!commands.enabled[handle] || slave.adapter.command_layout != SharedMemoryDataLayout::DriveCommand) continue;
+      SharedMemoryDriveCommand command;
+      command.position = commands.position[handle];
+      command.velocity = commands.velocity[handle];
+      command.torque = commands.torque[handle];
+      command.current = commands.current[handle];
+      command.mode = commands.mode[handle];
+      sharedMemoryKeepDriveMode(command, master.modes[handle]);
+      slave.adapter.stage(*slave.device, &command);
+    }
+  }
+
+  master.cycle++;
+  auto& states = master.states.writeBuffer();
+  for (const auto handle : master.handles) {
+    const auto& slave = m_slaves[handle];
+    if (slave.adapter.reading_layout == SharedMemoryDataLayout::Drive) {
+      SharedMemoryDriveReading reading;
+      slave.adapter.read(*slave.device, &reading);
+      states.position[handle] = reading.position;
+      states.velocity[handle] = reading.velocity;
+      states.torque[handle] = reading.torque;
+      states.current[handle] = reading.current;
+      states.state[handle] = reading.state;
+    } else if (slave.adapter.reading_layout == SharedMemoryDataLayout::ForceTorque) {
+      SharedMemoryForceTorqueReading reading;
+      slave.adapter.read(*slave.device, &reading);
+      for (std::size_t axis = 0; axis < 3; axis++) {
+        states.force[axis][handle] = reading.force[axis];
+        states.moment[axis][handle] = reading.torque[axis];
+      }
+    }
+    states.cycle[handle] = master.cycle;
+  }
+  master.states.publish();
+}
@@ -0,0 +1,97 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/ReadingDispatcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+ReadingDispatcher::ReadingDispatcher() : ReadingDispatcher(Configuration()) {}
+
+ReadingDispatcher::ReadingDispatcher(const Configuration& configuration) : m_configuration(configuration) {
+  m_configuration.worker_threads = std::max(1u, m_configuration.worker_threads);
+}
+
+ReadingDispatcher::~ReadingDispatcher() {
+  stop();
+}
+
+void ReadingDispatcher::addChannel(std::shared_ptr<ReadingChannelBase> channel) {
+  if (m_running) throw std::runtime_error("[ReadingDispatcher] Channels can only be added while not running");
+  m_channels.push_back(std::move(channel));
+}
+
+void ReadingDispatcher::start() {
+  if (m_running.exchange(true)) return;
+  for (std::size_t index = 0; index < m_configuration.worker_threads; index++) {
+    m_workers.emplace_back(&ReadingDispatcher::runWorker, this, index);
+  }
+}
+
+void ReadingDispatcher::stop() {
+  // Only the first of concurrent calls joins the workers
+  if (!m_running.exchange(false)) return;
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+  m_workers.clear();
+  // Deliver what was queued before the producers stopped
+  while (dispatchChannels(0) > 0) {
+  }
+}
+
+ReadingChannelBase::Statistics ReadingDispatcher::getStatistics() const {
+  ReadingChannelBase::Statistics sum;
+  for (const auto& channel : m_channels) {
+    const auto statistics = channel->getStatistics();
+    sum.pushed += statistics.pushed;
+    sum.dropped += statistics.dropped;
+    sum.dispatched += statistics.dispatched;
+    sum.failed += statistics.failed;
+  }
+  return sum;
+}
+
+void ReadingDispatcher::runWorker(std::size_t worker_index) {
+  const auto poll_period = std::chrono::duration<double>(m_configuration.poll_period);
+  // The workers start at different channels, a busy channel is skipped instead of waited for.
+  const std::size_t first_channel = m_channels.empty() ? 0 : worker_index * m_channels.size() / m_configuration.worker_threads;
+  while (m_running) {
+    if (dispatchChannels(first_channel) == 0) {
+      std::this_thread::sleep_for(poll_period);
+    }
+  }
+}
+
+std::size_t ReadingDispatcher::dispatchChannels(std::size_t first_channel) {
+  std::size_t dispatched = 0;
+  for (std::size_t i = 0; i < m_channels.size(); i++) {
+    auto& channel = *m_channels[(first_channel + i) % m_channels.size()];
+    bool expected = false;
+    if (!channel.m_busy.compare_exchange_strong(expected, true, std::memory_order_acquire)) continue;
+    // At most one queue length per visit, a channel with a fast producer does not starve the others
+    dispatched += channel.dispatch(m_configuration.queue_capacity);
+    channel.m_busy.store(false, std::memory_order_release);
+  }
+  return dispatched;
+}
@@ -0,0 +1,289 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/SetupSnapshot.hpp"
+#include "ethercat_device_configurator/ConfigurationCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+/*posix*/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// File layout: header | payload. All values in host byte order, checked with the byte order marker.
+constexpr char snapshotMagic[8] = {'E', 'C', 'D', 'C', 'S', 'N', 'A', 'P'};
+constexpr uint32_t byteOrderMarker = 0x01020304;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t payload_size;
+  uint64_t payload_hash;
+};
+
+class Writer {
+ public:
+  template <typename T>
+  void pod(T value) {
+    static_assert(std::is_trivially_copyable_v<T>, "pod: only trivially copyable types");
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    m_buffer.append(bytes, sizeof(T));
+  }
+  void string(const std::string& value) {
+    pod<uint64_t>(value.size());
+    m_buffer.append(value);
+  }
+  const std::string& buffer() const { return m_buffer; }
+
+ private:
+  std::string m_buffer;
+};
+
+class Reader {
+ public:
+  Reader(const char* data, std::size_t size) : m_data(data), m_size(size) {}
+  template <typename T>
+  T pod() {
+    static_assert(std::is_trivially_copyable_v<T>, "pod: only trivially copyable types");
+    check(sizeof(T));
+    T value;
+    std::memcpy(&value, m_data + m_offset, sizeof(T));
+    m_offset += sizeof(T);
+    return value;
+  }
+  std::string string() {
+    const auto size = pod<uint64_t>();
+    check(size);
+    std::string value(m_data + m_offset, size);
+    m_offset += size;
+    return value;
+  }
+  bool done() const { return m_offset == m_size; }
+
+ private:
+  void check(std::size_t size) const {
+    if (size > m_size - m_offset) throw std::runtime_error("[SetupSnapshot] Snapshot truncated");
+  }
+  const char* m_data;
+  std::size_t m_size;
+  std::size_t m_offset{0};
+};
+
+// Read only memory mapping of a whole file, unmapped on destruction.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("[SetupSnapshot] Could not open: " + path);
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("[SetupSnapshot] Could not stat: " + path);
+    }
+    m_size = static_cast<std::size_t>(info.st_size);
+    if (m_size > 0) {
+      void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) throw std::runtime_error("[SetupSnapshot] Could not map: " + path);
+      m_data = static_cast<const char*>(data);
+    } else {
+      ::close(fd);
+    }
+  }
+  ~MappedFile() {
+    if (m_data) ::munmap(const_cast<char*>(m_data), m_size);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+
+ private:
+  const char* m_data{nullptr};
+  std::size_t m_size{0};
+};
+
+}  // namespace
+
+void SetupSnapshot::write(const std::string& path) const {
+  if (master_runtime_configurations.size() != master_configurations.size()) {
+    throw std::runtime_error("[SetupSnapshot] Number of master runtime configurations does not match the master configurations");
+  }
+  Writer writer;
+  writer.string(setup_file_path);
+
+  writer.pod<uint64_t>(master_configurations.size());
+  for (const auto& configuration : master_configurations) {
+    writer.string(configuration.name);
+    writer.string(configuration.networkInterface);
+    writer.pod<double>(configuration.timeStep);
+    writer.pod<int64_t>(configuration.updateRateTooLowWarnThreshold);
+    writer.pod<int64_t>(configuration.slaveDiscoverRetries);
+    writer.pod<uint8_t>(configuration.pdoSizeCheck);
+    writer.pod<uint8_t>(configuration.doBusDiagnosis);
+    writer.pod<uint8_t>(configuration.logErrorCounters);
+  }
+  for (const auto& configuration : master_runtime_configurations) {
+    writer.pod<int32_t>(configuration.rt_priority);
+    writer.pod<int32_t>(configuration.cpu_core);
+    writer.pod<uint8_t>(configuration.is_virtual);
+    writer.pod<double>(configuration.virtual_bus.latency);
+    writer.pod<double>(configuration.virtual_bus.jitter);
+    writer.pod<double>(configuration.virtual_bus.working_counter_error_rate);
+    writer.pod<uint8_t>(configuration.virtual_bus.simulated_time);
+    writer.pod<uint64_t>(configuration.virtual_bus.seed);
+  }
+
+  writer.pod<uint64_t>(slave_entries.size());
+  for (const auto& entry : slave_entries) {
+    writer.pod<uint32_t>(static_cast<uint32_t>(entry.type));
+    writer.string(entry.type_name);
+    writer.string(entry.name);
+    writer.pod<uint8_t>(entry.has_config_file);
+    writer.string(entry.config_file_path);
+    writer.pod<uint32_t>(entry.ethercat_address);
+    writer.string(entry.ethercat_bus);
+    writer.string(entry.ethercat_pdo_type);
+  }
+
+  writer.pod<uint64_t>(source_files.size());
+  for (const auto& source_file : source_files) {
+    writer.string(source_file.path);
+    writer.pod<uint64_t>(source_file.hash);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+  header.version = formatVersion;
+  header.byte_order = byteOrderMarker;
+  header.payload_size = writer.buffer().size();
+  header.payload_hash = ConfigurationCache::hash(writer.buffer());
+
+  // Write to a temporary file and rename, a process mapping the old snapshot keeps a consistent file.
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("[SetupSnapshot] Could not open for writing: " + temporary_path);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(writer.buffer().data(), static_cast<std::streamsize>(writer.buffer().size()));
+    if (!file) throw std::runtime_error("[SetupSnapshot] Could not write: " + temporary_path);
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("[SetupSnapshot] Could not rename " + temporary_path + " to " + path);
+  }
+}
+
+SetupSnapshot SetupSnapshot::read(const std::string& path) {
+  MappedFile file(path);
+  if (file.size() < sizeof(Header)) throw std::runtime_error("[SetupSnapshot] Not a snapshot: " + path);
+
+  Header header{};
+  std::memcpy(&header, file.data(), sizeof(Header));
+  if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+    throw std::runtime_error("[SetupSnapshot] Not a snapshot: " + path);
+  }
+  if (header.byte_order != byteOrderMarker) throw std::runtime_error("[SetupSnapshot] Snapshot was written with other byte order");
+  if (header.version != formatVersion) {
+    throw std::runtime_error("[SetupSnapshot] Snapshot format version " + std::to_string(header.version) + " not supported, expected " +
+                             std::to_string(formatVersion));
+  }
+  if (header.payload_size != file.size() - sizeof(Header)) throw std::runtime_error("[SetupSnapshot] Snapshot truncated: " + path);
+  const char* payload = file.data() + sizeof(Header);
+  if (header.payload_hash != ConfigurationCache::hash(payload, header.payload_size)) {
+    throw std::runtime_error("[SetupSnapshot] Snapshot corrupt: " + path);
+  }
+
+  Reader reader(payload, header.payload_size);
+  SetupSnapshot snapshot;
+  snapshot.setup_file_path = reader.string();
+
+  snapshot.master_configurations.resize(reader.pod<uint64_t>());
+  for (auto& configuration : snapshot.master_configurations) {
+    configuration.name = reader.string();
+    configuration.networkInterface = reader.string();
+    configuration.timeStep = reader.pod<double>();
+    configuration.updateRateTooLowWarnThreshold =
+        static_cast<decltype(configuration.updateRateTooLowWarnThreshold)>(reader.pod<int64_t>());
+    configuration.slaveDiscoverRetries = static_cast<decltype(configuration.slaveDiscoverRetries)>(reader.pod<int64_t>());
+    configuration.pdoSizeCheck = reader.pod<uint8_t>();
+    configuration.doBusDiagnosis = reader.pod<uint8_t>();
+    configuration.logErrorCounters = reader.pod<uint8_t>();
+  }
+  snapshot.master_runtime_configurations.resize(snapshot.master_configurations.size());
+  for (auto& configuration : snapshot.master_runtime_configurations) {
+    configuration.rt_priority = reader.pod<int32_t>();
+    configuration.cpu_core = reader.pod<int32_t>();
+    configuration.is_virtual = reader.pod<uint8_t>();
+    configuration.virtual_bus.latency = reader.pod<double>();
+    configuration.virtual_bus.jitter = reader.pod<double>();
+    configuration.virtual_bus.working_counter_error_rate = reader.pod<double>();
+    configuration.virtual_bus.simulated_time = reader.pod<uint8_t>();
+    configuration.virtual_bus.seed = reader.pod<uint64_t>();
+  }
+
+  snapshot.slave_entries.resize(reader.pod<uint64_t>());
+  for (auto& entry : snapshot.slave_entries) {
+    const auto type = reader.pod<uint32_t>();
+    if (type >= EthercatDeviceConfigurator::numberOfSlaveTypes) throw std::runtime_error("[SetupSnapshot] Invalid slave type");
+    entry.type = static_cast<EthercatDeviceConfigurator::EthercatSlaveType>(type);
+    entry.type_name = reader.string();
+    entry.name = reader.string();
+    entry.has_config_file = reader.pod<uint8_t>();
+    entry.config_file_path = reader.string();
+    entry.ethercat_address = reader.pod<uint32_t>();
+    entry.ethercat_bus = reader.string();
+    entry.ethercat_pdo_type = reader.string();
+  }
+
+  snapshot.source_files.resize(reader.pod<uint64_t>());
+  for (auto& source_file : snapshot.source_files) {
+    source_file.path = reader.string();
+    source_file.hash = reader.pod<uint64_t>();
+  }
+
+  if (!reader.done()) throw std::runtime_error("[SetupSnapshot] Trailing data in snapshot: " + path);
+  return snapshot;
+}
+
+bool SetupSnapshot::sourcesUpToDate(std::string& outdated) const {
+  for (const auto& source_file : source_files) {
+    try {
+      if (ConfigurationCache::instance().load(source_file.path)->hash() != source_file.hash) {
+        outdated = source_file.path;
+        return false;
+      }
+    } catch (const std::exception&) {
+      outdated = source_file.path;
+      return false;
+    }
+  }
+  return true;
+}
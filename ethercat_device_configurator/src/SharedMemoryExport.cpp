@@ -0,0 +1,292 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/SharedMemoryExport.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <thread>
+
+/*posix*/
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Attempts of a client before a slot which is written all the time (or by a crashed writer) is given up
+static constexpr int max_read_attempts = 1000;
+static constexpr int max_write_attempts = 1000000;
+
+static std::size_t cache_line_aligned(std::size_t size) {
+  return (size + 63) & ~static_cast<std::size_t>(63);
+}
+
+static int64_t monotonic_time() {
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+template <std::size_t N>
+static void copy_name(char (&destination)[N], const std::string& source, const char* what) {
+  if (source.size() >= N) {
+    throw std::runtime_error(std::string("[SharedMemoryExport] ") + what + " too long for the shared memory layout (max " +
+                             std::to_string(N - 1) + " characters): " + source);
+  }
+  std::memcpy(destination, source.c_str(), source.size() + 1);
+}
+
+// Unlinks a stale segment with the name and marks it Closed for the clients still mapping it. Leaves a missing segment alone.
+static void remove_stale_segment(const std::string& name) {
+  int fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0) return;
+  struct stat info {};
+  void* data = MAP_FAILED;
+  if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) >= sizeof(SharedMemoryHeader)) {
+    data = ::mmap(nullptr, sizeof(SharedMemoryHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (data == MAP_FAILED) throw std::runtime_error("[SharedMemoryExport] Shared memory " + name + " exists and is no device export");
+  auto* header = static_cast<SharedMemoryHeader*>(data);
+  std::string error;
+  if (header->magic != sharedMemoryMagic) {
+    error = " exists and is no device export";
+  } else if (header->state.load(std::memory_order_acquire) != SharedMemoryHeader::Closed && header->owner_pid > 0 &&
+             (::kill(header->owner_pid, 0) == 0 || errno == EPERM)) {
+    // EPERM: the process exists, it belongs to another user
+    error = " is exported by the running process " + std::to_string(header->owner_pid);
+  } else {
+    header->state.store(SharedMemoryHeader::Closed, std::memory_order_release);
+  }
+  ::munmap(data, sizeof(SharedMemoryHeader));
+  if (!error.empty()) throw std::runtime_error("[SharedMemoryExport] Shared memory " + name + error);
+  ::shm_unlink(name.c_str());
+}
+
+SharedMemoryExport::SharedMemoryExport(std::string name, std::vector<Slave> slaves)
+    : m_name(std::move(name)), m_slaves(std::move(slaves)), m_states(m_slaves.size()) {
+  std::vector<SharedMemorySlaveInfo> infos(m_slaves.size());
+  std::size_t offset = cache_line_aligned(sizeof(SharedMemoryHeader) + m_slaves.size() * sizeof(SharedMemorySlaveInfo));
+  for (std::size_t i = 0; i < m_slaves.size(); i++) {
+    const auto& slave = m_slaves[i];
+    auto& info = infos[i];
+    copy_name(info.name, slave.name, "Slave name");
+    copy_name(info.type_name, slave.type_name, "Type name");
+    copy_name(info.ethercat_bus, slave.ethercat_bus, "Bus name");
+    info.ethercat_address = slave.ethercat_address;
+    info.reading_layout = slave.adapter.reading_layout;
+    info.command_layout = slave.adapter.command_layout;
+    if (info.reading_layout != SharedMemoryDataLayout::None) {
+      info.reading_offset = offset;
+      m_states[i].reading_size = sharedMemoryDataSize(info.reading_layout);
+      offset += cache_line_aligned(sizeof(SharedMemoryReadingSlot) + m_states[i].reading_size);
+    }
+    if (info.command_layout != SharedMemoryDataLayout::None) {
+      info.command_offset = offset;
+      m_states[i].command_size = sharedMemoryDataSize(info.command_layout);
+      offset += cache_line_aligned(sizeof(SharedMemoryCommandSlot) + m_states[i].command_size);
+    }
+  }
+  m_size = offset;
+
+  // A segment left behind by a crashed process is replaced, never reused with a possibly different layout
+  remove_stale_segment(m_name);
+  // Fails if another process created the name meanwhile
+  int fd = ::shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0660);
+  if (fd < 0) throw std::runtime_error("[SharedMemoryExport] Could not create shared memory " + m_name + ": " + std::strerror(errno));
+  if (::ftruncate(fd, static_cast<off_t>(m_size)) != 0) {
+    const int error = errno;
+    ::close(fd);
+    ::shm_unlink(m_name.c_str());
+    throw std::runtime_error("[SharedMemoryExport] Could not size shared memory " + m_name + ": " + std::strerror(error));
+  }
+  // Populated: the cyclic threads never page fault on the segment
+  m_data = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+  ::close(fd);
+  if (m_data == MAP_FAILED) {
+    m_data = nullptr;
+    ::shm_unlink(m_name.c_str());
+    throw std::runtime_error("[SharedMemoryExport] Could not map shared memory " + m_name);
+  }
+
+  auto* base = static_cast<char*>(m_data);
+  auto* header = new (base) SharedMemoryHeader();
+  header->slave_count = static_cast<uint32_t>(m_slaves.size());
+  header->size = m_size;
+  header->owner_pid = static_cast<int32_t>(::getpid());
+  auto* slave_infos = reinterpret_cast<SharedMemorySlaveInfo*>(base + sizeof(SharedMemoryHeader));
+  for (std::size_t i = 0; i < infos.size(); i++) {
+    new (slave_infos + i) SharedMemorySlaveInfo(infos[i]);
+    if (infos[i].reading_offset != 0) m_states[i].reading = new (base + infos[i].reading_offset) SharedMemoryReadingSlot();
+    if (infos[i].command_offset != 0) m_states[i].command = new (base + infos[i].command_offset) SharedMemoryCommandSlot();
+  }
+  header->state.store(SharedMemoryHeader::Active, std::memory_order_release);
+}
+
+SharedMemoryExport::~SharedMemoryExport() {
+  if (!m_data) return;
+  detach();
+  ::munmap(m_data, m_size);
+}
+
+void SharedMemoryExport::detach() {
+  if (!m_attached.exchange(false, std::memory_order_acq_rel)) return;
+  static_cast<SharedMemoryHeader*>(m_data)->state.store(SharedMemoryHeader::Closed, std::memory_order_release);
+  ::shm_unlink(m_name.c_str());
+}
+
+void SharedMemoryExport::cycle(std::size_t index) {
+  if (!m_attached.load(std::memory_order_acquire)) return;
+  auto& slave = m_slaves[index];
+  auto& state = m_states[index];
+  if (state.reading) {
+    auto* slot = state.reading;
+    const uint32_t odd = sharedMemoryWriteBegin(slot->sequence);
+    slot->cycle = ++state.cycle;
+    slot->stamp = monotonic_time();
+    // In place
+    slave.adapter.read(*slave.device, sharedMemorySlotData(slot));
+    sharedMemoryWriteEnd(slot->sequence, odd);
+  }
+  if (state.command) {
+    const auto* slot = state.command;
+    alignas(8) unsigned char command[sharedMemoryMaxDataSize];
+    uint64_t count = 0;
+    // One attempt, a command written just now is staged in the next cycle
+    const bool consistent = sharedMemoryTryRead(slot->sequence, [&]() {
+      count = slot->count;
+      std::memcpy(command, sharedMemorySlotData(slot), state.command_size);
+    });
+    if (consistent && count != state.applied) {
+      if (slave.adapter.command_layout == SharedMemoryDataLayout::DriveCommand) {
+        sharedMemoryKeepDriveMode(*reinterpret_cast<SharedMemoryDriveCommand*>(command), state.mode);
+      }
+      slave.adapter.stage(*slave.device, command);
+      state.applied = count;
+      state.command->applied.store(count, std::memory_order_release);
+    }
+  }
+}
+
+SharedMemoryClient::SharedMemoryClient(const std::string& name) : m_name(name) {
+  int fd = ::shm_open(m_name.c_str(), O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0) throw std::runtime_error("[SharedMemoryClient] Could not open shared memory " + m_name + ": " + std::strerror(errno));
+  struct stat info {};
+  if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(SharedMemoryHeader)) {
+    ::close(fd);
+    throw std::runtime_error("[SharedMemoryClient] Shared memory " + m_name + " is no device export");
+  }
+  m_size = static_cast<std::size_t>(info.st_size);
+  m_data = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (m_data == MAP_FAILED) {
+    m_data = nullptr;
+    throw std::runtime_error("[SharedMemoryClient] Could not map shared memory " + m_name);
+  }
+  m_header = static_cast<const SharedMemoryHeader*>(m_data);
+  std::string error;
+  if (m_header->magic != sharedMemoryMagic) {
+    error = " is no device export";
+  } else if (m_header->version != sharedMemoryLayoutVersion) {
+    error = " has layout version " + std::to_string(m_header->version) + ", expected " + std::to_string(sharedMemoryLayoutVersion);
+  } else if (m_header->size > m_size || sizeof(SharedMemoryHeader) + m_header->slave_count * sizeof(SharedMemorySlaveInfo) > m_size) {
+    error = " is truncated";
+  }
+  if (!error.empty()) {
+    ::munmap(m_data, m_size);
+    throw std::runtime_error("[SharedMemoryClient] Shared memory " + m_name + error);
+  }
+  m_slave_infos = reinterpret_cast<const SharedMemorySlaveInfo*>(static_cast<const char*>(m_data) + sizeof(SharedMemoryHeader));
+}
+
+SharedMemoryClient::~SharedMemoryClient() {
+  ::munmap(m_data, m_size);
+}
+
+bool SharedMemoryClient::isActive() const {
+  return m_header->state.load(std::memory_order_acquire) == SharedMemoryHeader::Active;
+}
+
+const SharedMemorySlaveInfo& SharedMemoryClient::getSlaveInfo(std::size_t index) const {
+  if (index >= m_header->slave_count) throw std::out_of_range("[SharedMemoryClient] Slave index out of range");
+  return m_slave_infos[index];
+}
+
+std::size_t SharedMemoryClient::getSlaveIndex(const std::string& name) const {
+  for (std::size_t i = 0; i < m_header->slave_count; i++) {
+    if (name == m_slave_infos[i].name) return i;
+  }
+  throw std::out_of_range("[SharedMemoryClient] No slave named " + name + " in " + m_name);
+}
+
+bool SharedMemoryClient::readSlot(std::size_t index, SharedMemoryDataLayout layout, void* data, uint64_t& cycle, int64_t& stamp) const {
+  const auto& info = getSlaveInfo(index);
+  if (info.reading_layout != layout) {
+    throw std::invalid_argument("[SharedMemoryClient] Reading layout of slave " + std::string(info.name) + " does not match");
+  }
+  const auto* slot = reinterpret_cast<const SharedMemoryReadingSlot*>(static_cast<const char*>(m_data) + info.reading_offset);
+  const std::size_t size = sharedMemoryDataSize(layout);
+  for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+    const bool consistent = sharedMemoryTryRead(slot->sequence, [&]() {
+      cycle = slot->cycle;
+      stamp = slot->stamp;
+      std::memcpy(data, sharedMemorySlotData(slot), size);
+    });
+    if (consistent) return true;
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+uint64_t SharedMemoryClient::writeSlot(std::size_t index, SharedMemoryDataLayout layout, const void* data) {
+  const auto& info = getSlaveInfo(index);
+  if (info.command_layout != layout) {
+    throw std::invalid_argument("[SharedMemoryClient] Command layout of slave " + std::string(info.name) + " does not match");
+  }
+  auto* slot = reinterpret_cast<SharedMemoryCommandSlot*>(static_cast<char*>(m_data) + info.command_offset);
+  // Several clients may write the slot: the one which makes the sequence odd writes, the others wait
+  uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+  for (int attempt = 0;; attempt++) {
+    if (attempt == max_write_attempts) {
+      throw std::runtime_error("[SharedMemoryClient] Command slot of slave " + std::string(info.name) + " is locked");
+    }
+    if (!(sequence & 1u) && slot->sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire)) break;
+    std::this_thread::yield();
+    sequence = slot->sequence.load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  const uint64_t count = slot->count + 1;
+  slot->count = count;
+  std::memcpy(sharedMemorySlotData(slot), data, sharedMemoryDataSize(layout));
+  sharedMemoryWriteEnd(slot->sequence, sequence + 1);
+  return count;
+}
+
+uint64_t SharedMemoryClient::getAppliedCommandCount(std::size_t index) const {
+  const auto& info = getSlaveInfo(index);
+  if (info.command_offset == 0) return 0;
+  const auto* slot = reinterpret_cast<const SharedMemoryCommandSlot*>(static_cast<const char*>(m_data) + info.command_offset);
+  return slot->applied.load(std::memory_order_acquire);
+}
@@ -0,0 +1,166 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/StartupProfile.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+static void write_json_string(std::ostream& stream, const std::string& value) {
+  stream << '"';
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      stream << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+    } else {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+
+static void write_json_phases(std::ostream& stream, const std::vector<StartupProfile::Phase>& phases, int indent) {
+  const std::string padding(indent, ' ');
+  stream << "[";
+  for (std::size_t i = 0; i < phases.size(); i++) {
+    const auto& phase = phases[i];
+    stream << (i == 0 ? "\n" : ",\n") << padding << "  {\"name\": ";
+    write_json_string(stream, phase.name);
+    stream << ", \"category\": ";
+    write_json_string(stream, phase.category);
+    stream << ", \"subject\": ";
+    write_json_string(stream, phase.subject);
+    stream << ", \"start\": " << phase.start << ", \"duration\": " << phase.duration
+           << ", \"success\": " << (phase.success ? "true" : "false") << ", \"children\": ";
+    write_json_phases(stream, phase.children, indent + 2);
+    stream << "}";
+  }
+  if (!phases.empty()) stream << "\n" << padding;
+  stream << "]";
+}
+
+static double phases_end(const std::vector<StartupProfile::Phase>& phases) {
+  double end = 0.0;
+  for (const auto& phase : phases) {
+    end = std::max(end, phase.start + phase.duration);
+  }
+  return end;
+}
+
+double StartupProfile::total() const {
+  return phases_end(phases);
+}
+
+void StartupProfile::writeJson(std::ostream& stream) const {
+  const auto precision = stream.precision(9);
+  stream << "{\"total\": " << total() << ", \"phases\": ";
+  write_json_phases(stream, phases, 0);
+  stream << "}\n";
+  stream.precision(precision);
+}
+
+std::string StartupProfile::toJson() const {
+  std::ostringstream stream;
+  writeJson(stream);
+  return stream.str();
+}
+
+namespace {
+// Innermost Scope of the thread
+struct CurrentScope {
+  const StartupProfiler* profiler{nullptr};
+  StartupProfiler::PhaseId id{StartupProfiler::root};
+};
+thread_local CurrentScope current_scope;
+}  // namespace
+
+StartupProfiler::Scope::Scope(StartupProfiler& profiler, std::string name, std::string category, std::string subject, PhaseId parent)
+    : m_profiler(profiler),
+      m_id(profiler.begin(std::move(name), std::move(category), std::move(subject), parent)),
+      m_outer_profiler(current_scope.profiler),
+      m_outer_id(current_scope.id) {
+  current_scope = CurrentScope{&m_profiler, m_id};
+}
+
+StartupProfiler::Scope::~Scope() {
+  current_scope = CurrentScope{m_outer_profiler, m_outer_id};
+  m_profiler.end(m_id, m_success && std::uncaught_exceptions() == m_exceptions);
+}
+
+void StartupProfiler::reset() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_first_id += m_records.size();
+  m_records.clear();
+}
+
+StartupProfiler::PhaseId StartupProfiler::begin(std::string name, std::string category, std::string subject, PhaseId parent) {
+  if (parent == inherit) parent = current_scope.profiler == this ? current_scope.id : root;
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Children of a phase recorded before a reset become top level phases
+  const std::size_t parent_index = parent != root && parent >= m_first_id ? parent - m_first_id : root;
+  if (m_records.empty()) m_start = now;
+  m_records.push_back(Record{std::move(name), std::move(category), std::move(subject), parent_index, now, now, false, true});
+  return m_first_id + m_records.size() - 1;
+}
+
+void StartupProfiler::end(PhaseId id, bool success) {
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Phases recorded before a reset are dropped
+  if (id < m_first_id || id - m_first_id >= m_records.size()) return;
+  auto& record = m_records[id - m_first_id];
+  if (record.ended) return;
+  record.end = now;
+  record.ended = true;
+  record.success = success;
+}
+
+StartupProfile StartupProfiler::profile() const {
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<StartupProfile::Phase> phases(m_records.size());
+  for (std::size_t id = 0; id < m_records.size(); id++) {
+    const auto& record = m_records[id];
+    auto& phase = phases[id];
+    phase.name = record.name;
+    phase.category = record.category;
+    phase.subject = record.subject;
+    phase.start = std::chrono::duration<double>(record.begin - m_start).count();
+    phase.duration = std::chrono::duration<double>((record.ended ? record.end : now) - record.begin).count();
+    phase.success = record.success;
+  }
+  // Parents are recorded before their children: moving the children into their parents from the back builds the tree
+  StartupProfile profile;
+  for (std::size_t id = m_records.size(); id-- > 0;) {
+    auto& siblings = m_records[id].parent == root ? profile.phases : phases[m_records[id].parent].children;
+    siblings.push_back(std::move(phases[id]));
+  }
+  auto sort = [](std::vector<StartupProfile::Phase>& siblings, auto& self) -> void {
+    std::sort(siblings.begin(), siblings.end(), [](const auto& a, const auto& b) { return a.start < b.start; });
+    for (auto& phase : siblings) self(phase.children, self);
+  };
+  sort(profile.phases, sort);
+  return profile;
+}
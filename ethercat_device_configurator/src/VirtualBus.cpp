@@ -0,0 +1,112 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/VirtualBus.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/*posix*/
+#include <time.h>
+
+static int64_t monotonic_time() {
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+VirtualBus::VirtualBus(std::string name, double time_step, const Configuration& configuration)
+    : m_name(std::move(name)),
+      m_time_step(time_step),
+      m_configuration(configuration),
+      m_generator(configuration.seed),
+      m_jitter_distribution(0.0, std::max(0.0, configuration.jitter)),
+      m_fault_distribution(std::min(1.0, std::max(0.0, configuration.working_counter_error_rate))) {}
+
+void VirtualBus::attachDevice(const std::shared_ptr<VirtualDevice>& device) {
+  m_devices.push_back(device);
+}
+
+bool VirtualBus::startup(std::atomic<bool>& abort_flag) {
+  for (const auto& device : m_devices) {
+    if (abort_flag) return false;
+    if (!device->startup()) return false;
+  }
+  return true;
+}
+
+int64_t VirtualBus::sampleLatency() {
+  double latency = m_configuration.latency;
+  if (m_configuration.jitter > 0.0) latency += m_jitter_distribution(m_generator);
+  return static_cast<int64_t>(std::max(0.0, latency) * 1e9);
+}
+
+void VirtualBus::update() {
+  for (const auto& device : m_devices) {
+    device->updateWrite();
+  }
+
+  const int64_t latency = sampleLatency();
+  int64_t arrival = 0;
+  if (m_configuration.simulated_time) {
+    arrival = m_simulated_time.load(std::memory_order_relaxed) + latency;
+  } else {
+    // The frame is on the wire, the cyclic thread waits for it like for a real bus.
+    timespec wait{};
+    wait.tv_sec = latency / 1000000000;
+    wait.tv_nsec = latency % 1000000000;
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &wait, nullptr);
+    arrival = monotonic_time();
+  }
+
+  bool complete = true;
+  for (const auto& device : m_devices) {
+    const bool lost = m_configuration.working_counter_error_rate > 0.0 && m_fault_distribution(m_generator);
+    complete = complete && !lost;
+    device->transferFrame(arrival, lost);
+    device->updateRead();
+  }
+
+  m_frames.fetch_add(1, std::memory_order_relaxed);
+  if (!complete) m_working_counter_errors.fetch_add(1, std::memory_order_relaxed);
+  if (m_configuration.simulated_time) {
+    m_simulated_time.fetch_add(static_cast<int64_t>(std::llround(m_time_step * 1e9)), std::memory_order_relaxed);
+  }
+}
+
+void VirtualBus::shutdown() {
+  for (const auto& device : m_devices) {
+    device->shutdown();
+  }
+}
+
+int64_t VirtualBus::getTime() const {
+  if (m_configuration.simulated_time) return m_simulated_time.load(std::memory_order_relaxed);
+  return monotonic_time();
+}
+
+VirtualBus::Statistics VirtualBus::getStatistics() const {
+  Statistics statistics;
+  statistics.frames = m_frames.load(std::memory_order_relaxed);
+  statistics.working_counter_errors = m_working_counter_errors.load(std::memory_order_relaxed);
+  return statistics;
+}
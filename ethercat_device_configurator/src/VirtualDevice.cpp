@@ -0,0 +1,116 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/VirtualDevice.hpp"
+#include "ethercat_device_configurator/ConfigurationCache.hpp"
+#include "message_logger/message_logger.hpp"
+
+#include <stdexcept>
+
+VirtualDevice::VirtualDevice(const std::string& name, uint32_t address) {
+  name_ = name;
+  address_ = address;
+  m_in_flight.resize(m_loopback_delay_cycles + 1);
+}
+
+std::shared_ptr<VirtualDevice> VirtualDevice::deviceFromFile(const std::string& configFile, const std::string& name, uint32_t address) {
+  auto device = std::make_shared<VirtualDevice>(name, address);
+  if (!device->loadConfigFile(configFile)) {
+    throw std::runtime_error("[VirtualDevice] Could not load configuration file: " + configFile);
+  }
+  return device;
+}
+
+bool VirtualDevice::loadConfigFile(const std::string& fileName) {
+  try {
+    const YAML::Node node = ConfigurationCache::instance().load(fileName)->node();
+    if (node["loopback_delay_cycles"]) {
+      m_loopback_delay_cycles = node["loopback_delay_cycles"].as<unsigned int>();
+    }
+  } catch (const std::exception& e) {
+    MELO_ERROR_STREAM("[VirtualDevice] " << name_ << ": " << e.what())
+    return false;
+  }
+  m_in_flight.assign(m_loopback_delay_cycles + 1, Command{});
+  m_in_flight_index = 0;
+  return true;
+}
+
+bool VirtualDevice::startup() {
+  return true;
+}
+
+void VirtualDevice::updateWrite() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_in_flight[m_in_flight_index] = m_staged_command;
+}
+
+void VirtualDevice::transferFrame(int64_t stamp, bool lost) {
+  // The slot after the one just written holds the command sent loopback_delay_cycles frames ago.
+  m_in_flight_index = (m_in_flight_index + 1) % m_in_flight.size();
+  if (lost) {
+    m_working_counter_errors.fetch_add(1, std::memory_order_relaxed);
+    m_received_valid = false;
+    return;
+  }
+  const Command& command = m_in_flight[m_in_flight_index];
+  m_received.position = command.position;
+  m_received.velocity = command.velocity;
+  m_received.torque = command.torque;
+  m_received.cycle++;
+  m_received.stamp = stamp;
+  m_received_valid = true;
+}
+
+void VirtualDevice::updateRead() {
+  if (!m_received_valid) return;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_reading = m_received;
+}
+
+void VirtualDevice::shutdown() {}
+
+VirtualDevice::PdoInfo VirtualDevice::getCurrentPdoInfo() const {
+  PdoInfo info{};
+  info.rxPdoSize_ = sizeof(Command);
+  info.txPdoSize_ = sizeof(Reading);
+  return info;
+}
+
+void VirtualDevice::stageCommand(const Command& command) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_staged_command = command;
+}
+
+VirtualDevice::Command VirtualDevice::getStagedCommand() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_staged_command;
+}
+
+VirtualDevice::Reading VirtualDevice::getReading() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_reading;
+}
+
+uint64_t VirtualDevice::getWorkingCounterErrors() const {
+  return m_working_counter_errors.load(std::memory_order_relaxed);
+}
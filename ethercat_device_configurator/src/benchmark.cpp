@@ -0,0 +1,425 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+** Benchmark of the configuration parsing, setup and slave lookups for
+** synthetic setups with 10 to 5000 devices on 1 to 64 buses. The devices
+** are stub devices, created by stub factories registered for the device
+** types in the DeviceFactoryRegistry: no SDK or hardware is needed, the
+** SDK factories have to be plugins (BUILD_DEVICE_PLUGINS) or not built.
+** Reports the latency and the number of heap allocations per operation.
+**   ┌────
+**   │ benchmark [max number of devices]
+**   └────
+**   Exits with failure if the cyclic access path (getMasters, getSlaves,
+**   getSlaveByHandle, slavesOfType views) allocates, or if a setup with a
+**   duplicate name, address or interface is not rejected.
+*/
+#include "ethercat_device_configurator/ConfigurationCache.hpp"
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+#include "ethercat_device_configurator/EthercatDeviceConfigurator.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+/*posix*/
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+}  // namespace
+
+// Count every heap allocation of the process: all replaceable forms of operator new, plain, nothrow and aligned. The deallocation
+// functions are replaced alongside, they all free what these return.
+namespace {
+void* allocate(std::size_t size, std::size_t alignment) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+  void* pointer = nullptr;
+  return posix_memalign(&pointer, alignment, size) == 0 ? pointer : nullptr;
+}
+void* allocateOrThrow(std::size_t size, std::size_t alignment) {
+  if (void* pointer = allocate(size, alignment)) return pointer;
+  throw std::bad_alloc();
+}
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return allocateOrThrow(size, 0);
+}
+void* operator new[](std::size_t size) {
+  return allocateOrThrow(size, 0);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, 0);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, 0);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+namespace benchmark {
+
+// Device without SDK and configuration file, only has a name and an address
+class StubDevice : public ecat_master::EthercatDevice {
+ public:
+  StubDevice(const std::string& name, uint32_t address) {
+    name_ = name;
+    address_ = address;
+  }
+  bool loadConfigFile(const std::string& /*fileName*/) override { return true; }
+  bool startup() override { return true; }
+  void updateRead() override {}
+  void updateWrite() override {}
+  void shutdown() override {}
+  PdoInfo getCurrentPdoInfo() const override { return PdoInfo{}; }
+};
+
+// Gives access to the parsing and setup steps
+class StubConfigurator : public EthercatDeviceConfigurator {
+ public:
+  using EthercatDeviceConfigurator::checkUniqueness;
+  using EthercatDeviceConfigurator::parseFile;
+  using EthercatDeviceConfigurator::parseParameter;
+  using EthercatDeviceConfigurator::setup;
+};
+
+struct Setup {
+  std::size_t devices;
+  std::size_t buses;
+};
+
+// Device types used round robin, all created as stub devices
+const char* const deviceTypes[] = {"Elmo", "Maxon", "Anydrive", "EK1100"};
+
+/**
+ * @brief registerStubFactories - registers a factory creating stub devices for every device type of the setups. The configurator
+ * resolves the configuration files like for the sdk devices, the stubs do not parse them.
+ * @throw std::runtime_error if an sdk factory is linked into the library for one of the types
+ */
+void registerStubFactories() {
+  for (const char* type : deviceTypes) {
+    DeviceFactoryRegistry::instance().registerFactory(type, [](const EthercatDeviceConfigurator::EthercatSlaveEntry& entry,
+                                                               const std::string& /*configuration_file_path*/) {
+      return std::make_shared<StubDevice>(entry.name, entry.ethercat_address);
+    });
+  }
+}
+
+// The configuration file of a type referenced by the generated setups, relative to the benchmark directory
+std::string configurationFile(const char* type) {
+  return std::string("device_configurations/") + type + ".yaml";
+}
+
+std::string busName(std::size_t bus) {
+  return "bench" + std::to_string(bus);
+}
+
+std::string deviceName(std::size_t device) {
+  return "device_" + std::to_string(device);
+}
+
+// Which entry of a generated setup is duplicated, the last device gets the name / address of the first one, the last bus the interface
+// of the first one
+enum class Duplicate { None, Name, Address, Interface };
+
+// The configuration files are referenced by absolute path: parseFile and setup do not know the path of the setup file
+std::string generateSetupYaml(const Setup& setup, const std::string& directory, Duplicate duplicate = Duplicate::None) {
+  std::ostringstream yaml;
+  yaml << "ethercat_master_s:\n";
+  for (std::size_t bus = 0; bus < setup.buses; bus++) {
+    const bool duplicated = duplicate == Duplicate::Interface && bus + 1 == setup.buses;
+    yaml << "  - name: master_" << bus << "\n"
+         << "    ethercat_bus: " << busName(duplicated ? 0 : bus) << "\n"
+         << "    time_step: 0.0025\n"
+         << "    update_rate_too_low_warn_threshold: 50\n"
+         << "    pdo_size_check: false\n"
+         << "    slave_discover_retries: 10\n"
+         << "    bus_diagnosis: false\n"
+         << "    error_counter_log: false\n";
+  }
+  yaml << "ethercat_devices:\n";
+  for (std::size_t device = 0; device < setup.devices; device++) {
+    const char* type = deviceTypes[device % 4];
+    const bool last = device + 1 == setup.devices;
+    yaml << "  - type: " << type << "\n"
+         << "    name: " << deviceName(last && duplicate == Duplicate::Name ? 0 : device) << "\n"
+         << "    configuration_file: " << directory << "/" << configurationFile(type) << "\n"
+         << "    ethercat_bus: " << busName(last && duplicate == Duplicate::Address ? 0 : device % setup.buses) << "\n"
+         << "    ethercat_address: " << (last && duplicate == Duplicate::Address ? 1 : device / setup.buses + 1) << "\n";
+    if (device % 4 == 2) yaml << "    ethercat_pdo_type: A\n";
+  }
+  return yaml.str();
+}
+
+XmlRpc::XmlRpcValue generateParameters(const Setup& setup) {
+  XmlRpc::XmlRpcValue params;
+  for (std::size_t bus = 0; bus < setup.buses; bus++) {
+    XmlRpc::XmlRpcValue& master = params["ethercat_master_s"]["master_" + std::to_string(bus)];
+    master["ethercat_bus"] = busName(bus);
+    master["time_step"] = 0.0025;
+    master["update_rate_too_low_warn_threshold"] = 50;
+    master["pdo_size_check"] = false;
+    master["slave_discover_retries"] = 10;
+    master["bus_diagnosis"] = false;
+    master["error_counter_log"] = false;
+  }
+  for (std::size_t device = 0; device < setup.devices; device++) {
+    XmlRpc::XmlRpcValue& entry = params["ethercat_devices"][deviceName(device)];
+    entry["type"] = std::string(deviceTypes[device % 4]);
+    entry["configuration_file"] = configurationFile(deviceTypes[device % 4]);
+    entry["communication"]["ethercat_bus"] = busName(device % setup.buses);
+    entry["communication"]["ethercat_address"] = static_cast<int>(device / setup.buses + 1);
+    if (device % 4 == 2) entry["communication"]["ethercat_pdo_type"] = std::string("A");
+  }
+  return params;
+}
+
+struct Result {
+  double nanoseconds{0.0};
+  double allocations{0.0};
+};
+
+/**
+ * @brief measure - runs prepare (not measured) and operation for a number of iterations
+ * @param operations_per_iteration - divides the result, for operations which loop over all slaves
+ */
+template <typename Prepare, typename Operation>
+Result measure(std::size_t iterations, std::size_t operations_per_iteration, Prepare&& prepare, Operation&& operation) {
+  std::chrono::nanoseconds duration{0};
+  std::size_t allocated = 0;
+  for (std::size_t i = 0; i < iterations; i++) {
+    prepare();
+    const std::size_t allocations_before = allocations.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    operation();
+    const auto end = std::chrono::steady_clock::now();
+    allocated += allocations.load(std::memory_order_relaxed) - allocations_before;
+    duration += end - start;
+  }
+  const double operations = static_cast<double>(iterations * operations_per_iteration);
+  return Result{static_cast<double>(duration.count()) / operations, static_cast<double>(allocated) / operations};
+}
+
+void report(const std::string& operation, const Setup& setup, const Result& result) {
+  std::printf("%-28s %8zu %6zu %16.1f %14.2f\n", operation.c_str(), setup.devices, setup.buses, result.nanoseconds, result.allocations);
+}
+
+// Prevents the compiler from dropping the benchmarked calls
+template <typename T>
+void keep(T&& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief run - benchmarks all operations of one setup
+ * @return number of allocations of the cyclic access path
+ */
+std::size_t run(const Setup& setup, const std::string& directory) {
+  const std::string setup_path = directory + "/setup_" + std::to_string(setup.devices) + "_" + std::to_string(setup.buses) + ".yaml";
+  {
+    std::ofstream file(setup_path);
+    file << generateSetupYaml(setup, directory);
+  }
+  XmlRpc::XmlRpcValue params = generateParameters(setup);
+
+  const std::size_t iterations = std::max<std::size_t>(5, 20000 / setup.devices);
+  const auto nothing = []() {};
+  std::unique_ptr<StubConfigurator> configurator;
+  const auto fresh = [&]() { configurator = std::make_unique<StubConfigurator>(); };
+
+  report("parseFile (cold cache)", setup,
+         measure(iterations, 1,
+                 [&]() {
+                   fresh();
+                   ConfigurationCache::instance().clear();
+                 },
+                 [&]() { configurator->parseFile(setup_path); }));
+  report("parseFile (cached)", setup, measure(iterations, 1, fresh, [&]() { configurator->parseFile(setup_path); }));
+  report("parseParameter", setup, measure(iterations, 1, fresh, [&]() { configurator->parseParameter(params); }));
+  // Per device, stays flat if setup is linear in the number of devices
+  report("setup (per device)", setup,
+         measure(iterations, setup.devices,
+                 [&]() {
+                   fresh();
+                   configurator->parseFile(setup_path);
+                 },
+                 [&]() { configurator->setup(false); }));
+  report("checkUniqueness (per device)", setup, measure(iterations, setup.devices, nothing, [&]() { configurator->checkUniqueness(); }));
+
+  // Lookups on a set up configurator
+  fresh();
+  configurator->parseFile(setup_path);
+  configurator->setup(false);
+  std::vector<std::string> names;
+  for (std::size_t device = 0; device < setup.devices; device++) {
+    names.push_back(deviceName(device));
+  }
+  const auto& slaves = configurator->getSlaves();
+  const std::size_t lookups = std::max<std::size_t>(10, 200000 / setup.devices);
+
+  report("getSlave", setup, measure(lookups, setup.devices, nothing, [&]() {
+           for (const auto& name : names) keep(configurator->getSlave(name));
+         }));
+  report("getInfoForSlave", setup, measure(lookups, setup.devices, nothing, [&]() {
+           for (const auto& slave : slaves) keep(configurator->getInfoForSlave(slave));
+         }));
+  report("getSlavesOfType", setup, measure(lookups / 10 + 1, 1, nothing, [&]() {
+           keep(configurator->getSlavesOfType<StubDevice>(EthercatDeviceConfigurator::EthercatSlaveType::Elmo));
+         }));
+  report("getSlavesOfTypeOnBus", setup, measure(lookups / 10 + 1, 1, nothing, [&]() {
+           keep(configurator->getSlavesOfTypeOnBus<StubDevice>(busName(0)));
+         }));
+
+  // What a cyclic thread does every cycle, has to be allocation free
+  const Result cyclic = measure(lookups, setup.devices, nothing, [&]() {
+    for (const auto& master : configurator->getMasters()) keep(master.get());
+    for (EthercatDeviceConfigurator::SlaveHandle handle = 0; handle < configurator->getSlaves().size(); handle++) {
+      keep(configurator->getSlaveByHandle(handle).get());
+    }
+    keep(configurator->slavesOfType<elmo::Elmo>().size());
+  });
+  report("cyclic access (per slave)", setup, cyclic);
+  std::remove(setup_path.c_str());
+
+  // The generated topology with one duplicate has to be rejected by the parser
+  for (auto duplicate : {Duplicate::Name, Duplicate::Address, Duplicate::Interface}) {
+    if (duplicate == Duplicate::Interface && setup.buses < 2) continue;
+    {
+      std::ofstream file(setup_path);
+      file << generateSetupYaml(setup, directory, duplicate);
+    }
+    bool rejected = false;
+    try {
+      fresh();
+      configurator->parseFile(setup_path);
+    } catch (const std::runtime_error&) {
+      rejected = true;
+    }
+    std::remove(setup_path.c_str());
+    if (!rejected) throw std::runtime_error("Duplicate in setup with " + std::to_string(setup.devices) + " devices not detected");
+  }
+  return static_cast<std::size_t>(cyclic.allocations * static_cast<double>(lookups * setup.devices) + 0.5);
+}
+
+}  // namespace benchmark
+
+int main(int argc, char** argv) {
+  std::size_t max_devices = 5000;
+  if (argc > 1) max_devices = std::strtoul(argv[1], nullptr, 10);
+
+  char directory_template[] = "/tmp/ethercat_device_configurator_benchmark_XXXXXX";
+  if (mkdtemp(directory_template) == nullptr) {
+    std::cerr << "Could not create a temporary directory" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string directory = directory_template;
+  // The configuration files referenced by the setups exist, setup measures the path resolution of the real devices
+  const std::string configuration_directory = directory + "/device_configurations";
+  mkdir(configuration_directory.c_str(), 0700);
+  for (const char* type : benchmark::deviceTypes) {
+    std::ofstream(directory + "/" + benchmark::configurationFile(type)) << "# " << type << "\n";
+  }
+
+  std::printf("%-28s %8s %6s %16s %14s\n", "operation", "devices", "buses", "ns/op", "allocs/op");
+  std::size_t cyclic_allocations = 0;
+  try {
+    benchmark::registerStubFactories();
+    for (std::size_t devices : {10, 100, 500, 1000, 2000, 5000}) {
+      if (devices > max_devices) break;
+      for (std::size_t buses : {1, 4, 16, 64}) {
+        if (buses > devices) continue;
+        cyclic_allocations += benchmark::run({devices, buses}, directory);
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (const char* type : benchmark::deviceTypes) {
+    std::remove((directory + "/" + benchmark::configurationFile(type)).c_str());
+  }
+  rmdir(configuration_directory.c_str());
+  rmdir(directory.c_str());
+
+  if (cyclic_allocations != 0) {
+    std::cerr << "Cyclic access path allocated " << cyclic_allocations << " times" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+
+#include "anydrive_rsl/Anydrive.hpp"
+
+static anydrive_rsl::fsm::StateEnum fsm_state(EthercatDeviceConfigurator::DriveTarget target) {
+  return target == EthercatDeviceConfigurator::DriveTarget::Operational ? anydrive_rsl::fsm::StateEnum::ControlOp
+                                                                         : anydrive_rsl::fsm::StateEnum::Standby;
+}
+
+void registerAnydriveFactories(DeviceFactoryRegistry& registry) {
+  registry.registerFactory("Anydrive", [](const EthercatDeviceConfigurator::EthercatSlaveEntry& entry, const std::string& path) {
+    anydrive_rsl::PdoTypeEnum pdo = anydrive_rsl::PdoTypeEnum::NA;
+    if (entry.ethercat_pdo_type == "A") {
+      pdo = anydrive_rsl::PdoTypeEnum::A;
+    } else if (entry.ethercat_pdo_type == "B") {
+      pdo = anydrive_rsl::PdoTypeEnum::B;
+    } else if (entry.ethercat_pdo_type == "C") {
+      pdo = anydrive_rsl::PdoTypeEnum::C;
+    } else if (entry.ethercat_pdo_type == "D") {
+      pdo = anydrive_rsl::PdoTypeEnum::D;
+    } else if (entry.ethercat_pdo_type == "E") {
+      pdo = anydrive_rsl::PdoTypeEnum::E;
+    } else {
+      throw std::runtime_error("[EthercatDeviceConfigurator] PDO unknown: " + entry.ethercat_pdo_type);
+    }
+
+    std::shared_ptr<ecat_master::EthercatDevice> slave;
+    if (!path.empty()) {
+      slave = anydrive_rsl::AnydriveEthercatSlave::deviceFromFile(path, entry.name, entry.ethercat_address, pdo);
+    } else {
+      slave =
+          anydrive_rsl::AnydriveEthercatSlave::deviceFromRosParameterServer(entry.config_params, entry.name, entry.ethercat_address, pdo);
+    }
+    return slave;
+  });
+  // The devices of the type are created by the factory above
+  DeviceFactoryRegistry::DriveStateHandler handler;
+  handler.request = [](ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target) {
+    // reachState false: only sets the goal state, the fsm advances in the cyclic update
+    static_cast<anydrive_rsl::AnydriveEthercatSlave&>(drive).setFSMGoalState(fsm_state(target), false, 0, 0);
+  };
+  handler.reached = [](ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target) {
+    return static_cast<anydrive_rsl::AnydriveEthercatSlave&>(drive).getActiveStateEnum() == fsm_state(target);
+  };
+  registry.registerDriveStateHandler("Anydrive", std::move(handler));
+
+  DeviceFactoryRegistry::ProcessDataAdapter adapter;
+  adapter.reading_layout = SharedMemoryDataLayout::Drive;
+  adapter.command_layout = SharedMemoryDataLayout::DriveCommand;
+  adapter.read = [](ecat_master::EthercatDevice& drive, void* data) {
+    auto& device = static_cast<anydrive_rsl::AnydriveEthercatSlave&>(drive);
+    const auto reading = device.getReading();
+    auto& shared = *static_cast<SharedMemoryDriveReading*>(data);
+    shared.position = reading.getState().getJointPosition();
+    shared.velocity = reading.getState().getJointVelocity();
+    shared.torque = reading.getState().getJointTorque();
+    shared.current = reading.getState().getCurrent();
+    shared.state = static_cast<uint32_t>(device.getActiveStateEnum());
+  };
+  adapter.stage = [](ecat_master::EthercatDevice& drive, const void* data) {
+    const auto& shared = *static_cast<const SharedMemoryDriveCommand*>(data);
+    anydrive_rsl::Command command;
+    // 0: no mode was commanded yet (the export passes the last mode otherwise), NA is never commanded
+    if (shared.mode != 0) command.setModeEnum(static_cast<anydrive_rsl::mode::ModeEnum>(shared.mode));
+    command.setJointPosition(shared.position);
+    command.setJointVelocity(shared.velocity);
+    command.setJointTorque(shared.torque);
+    command.setCurrent(shared.current);
+    static_cast<anydrive_rsl::AnydriveEthercatSlave&>(drive).setCommand(command);
+  };
+  registry.registerProcessDataAdapter("Anydrive", std::move(adapter));
+}
+
+ETHERCAT_DEVICE_PLUGIN(registerAnydriveFactories)
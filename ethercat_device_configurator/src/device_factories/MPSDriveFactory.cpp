@@ -0,0 +1,49 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+
+#include "mps_ethercat_sdk/MPSDrive.hpp"
+
+static mps_ethercat_sdk::DriveState drive_state(EthercatDeviceConfigurator::DriveTarget target) {
+  return target == EthercatDeviceConfigurator::DriveTarget::Operational ? mps_ethercat_sdk::DriveState::OperationEnabled
+                                                                         : mps_ethercat_sdk::DriveState::SwitchOnDisabled;
+}
+
+void registerMPSDriveFactories(DeviceFactoryRegistry& registry) {
+  registry.registerFactory("MPSDrive", [](const EthercatDeviceConfigurator::EthercatSlaveEntry& entry, const std::string& path) {
+    if (path.empty()) throw std::runtime_error("MPSDrive configuring from ros1 parameter server not supported yet.");
+    return mps_ethercat_sdk::MPSDrive::deviceFromFile(path, entry.name, entry.ethercat_address);
+  });
+  // The devices of the type are created by the factory above
+  DeviceFactoryRegistry::DriveStateHandler handler;
+  handler.request = [](ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target) {
+    static_cast<mps_ethercat_sdk::MPSDrive&>(drive).setDriveStateViaPdo(drive_state(target), false);
+  };
+  handler.reached = [](ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target) {
+    auto& device = static_cast<mps_ethercat_sdk::MPSDrive&>(drive);
+    return device.lastPdoStateChangeSuccessful() && device.getReading().getDriveState() == drive_state(target);
+  };
+  registry.registerDriveStateHandler("MPSDrive", std::move(handler));
+}
+
+ETHERCAT_DEVICE_PLUGIN(registerMPSDriveFactories)
@@ -0,0 +1,73 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+
+#include "maxon_epos_ethercat_sdk/Maxon.hpp"
+
+static maxon::DriveState drive_state(EthercatDeviceConfigurator::DriveTarget target) {
+  return target == EthercatDeviceConfigurator::DriveTarget::Operational ? maxon::DriveState::OperationEnabled
+                                                                         : maxon::DriveState::SwitchOnDisabled;
+}
+
+void registerMaxonFactories(DeviceFactoryRegistry& registry) {
+  registry.registerFactory("Maxon", [](const EthercatDeviceConfigurator::EthercatSlaveEntry& entry, const std::string& path) {
+    if (path.empty()) throw std::runtime_error("Maxon configuring from ros1 parameter server not supported yet.");
+    return maxon::Maxon::deviceFromFile(path, entry.name, entry.ethercat_address);
+  });
+  // The devices of the type are created by the factory above
+  DeviceFactoryRegistry::DriveStateHandler handler;
+  handler.request = [](ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target) {
+    static_cast<maxon::Maxon&>(drive).setDriveStateViaPdo(drive_state(target), false);
+  };
+  handler.reached = [](ecat_master::EthercatDevice& drive, EthercatDeviceConfigurator::DriveTarget target) {
+    auto& device = static_cast<maxon::Maxon&>(drive);
+    return device.lastPdoStateChangeSuccessful() && device.getReading().getDriveState() == drive_state(target);
+  };
+  registry.registerDriveStateHandler("Maxon", std::move(handler));
+
+  DeviceFactoryRegistry::ProcessDataAdapter adapter;
+  adapter.reading_layout = SharedMemoryDataLayout::Drive;
+  adapter.command_layout = SharedMemoryDataLayout::DriveCommand;
+  adapter.read = [](ecat_master::EthercatDevice& drive, void* data) {
+    const auto reading = static_cast<maxon::Maxon&>(drive).getReading();
+    auto& shared = *static_cast<SharedMemoryDriveReading*>(data);
+    shared.position = reading.getActualPosition();
+    shared.velocity = reading.getActualVelocity();
+    shared.torque = reading.getActualTorque();
+    shared.current = reading.getActualCurrent();
+    shared.state = static_cast<uint32_t>(reading.getDriveState());
+  };
+  adapter.stage = [](ecat_master::EthercatDevice& drive, const void* data) {
+    const auto& shared = *static_cast<const SharedMemoryDriveCommand*>(data);
+    maxon::Command command;
+    command.setTargetPosition(shared.position);
+    command.setTargetVelocity(shared.velocity);
+    command.setTargetTorque(shared.torque);
+    command.setTargetCurrent(shared.current);
+    if (shared.mode != 0) command.setModeOfOperation(static_cast<maxon::ModeOfOperationEnum>(shared.mode));
+    static_cast<maxon::Maxon&>(drive).stageCommand(command);
+  };
+  registry.registerProcessDataAdapter("Maxon", std::move(adapter));
+}
+
+ETHERCAT_DEVICE_PLUGIN(registerMaxonFactories)
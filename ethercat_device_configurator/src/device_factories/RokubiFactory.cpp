@@ -0,0 +1,70 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ethercat_device_configurator/DeviceFactoryRegistry.hpp"
+
+#include "rokubimini_rsl_ethercat_slave/RokubiminiEthercat.hpp"
+
+void registerRokubiFactories(DeviceFactoryRegistry& registry) {
+  registry.registerFactory("Rokubi", [](const EthercatDeviceConfigurator::EthercatSlaveEntry& entry, const std::string& path) {
+    rokubimini::ethercat::PdoTypeEnum pdo = rokubimini::ethercat::PdoTypeEnum::NA;
+    if (entry.ethercat_pdo_type == "A") {
+      pdo = rokubimini::ethercat::PdoTypeEnum::A;
+    } else if (entry.ethercat_pdo_type == "B") {
+      pdo = rokubimini::ethercat::PdoTypeEnum::B;
+    } else if (entry.ethercat_pdo_type == "C") {
+      pdo = rokubimini::ethercat::PdoTypeEnum::C;
+    } else if (entry.ethercat_pdo_type == "Z") {
+      pdo = rokubimini::ethercat::PdoTypeEnum::Z;
+    } else if (entry.ethercat_pdo_type == "EXTIMU") {
+      pdo = rokubimini::ethercat::PdoTypeEnum::EXTIMU;
+    } else {
+      throw std::runtime_error("[EthercatDeviceConfigurator] PDO unknown: " + entry.ethercat_pdo_type);
+    }
+
+    std::shared_ptr<ecat_master::EthercatDevice> slave;
+    if (!path.empty()) {
+      slave = rokubimini::ethercat::RokubiminiEthercat::deviceFromFile(path, entry.name, entry.ethercat_address, pdo);
+    } else {
+      slave = rokubimini::ethercat::RokubiminiEthercat::deviceFromRosParameterServer(entry.config_params, entry.name,
+                                                                                     entry.ethercat_address, pdo);
+    }
+    return slave;
+  });
+
+  // Sensor without commands
+  DeviceFactoryRegistry::ProcessDataAdapter adapter;
+  adapter.reading_layout = SharedMemoryDataLayout::ForceTorque;
+  adapter.read = [](ecat_master::EthercatDevice& sensor, void* data) {
+    rokubimini::Reading reading;
+    static_cast<rokubimini::ethercat::RokubiminiEthercat&>(sensor).getReading(reading);
+    const auto& wrench = reading.getWrench().wrench_;
+    auto& shared = *static_cast<SharedMemoryForceTorqueReading*>(data);
+    for (int i = 0; i < 3; i++) {
+      shared.force[i] = wrench.getForce().toImplementation()(i);
+      shared.torque[i] = wrench.getTorque().toImplementation()(i);
+    }
+  };
+  registry.registerProcessDataAdapter("Rokubi", std::move(adapter));
+}
+
+ETHERCAT_DEVICE_PLUGIN(registerRokubiFactories)
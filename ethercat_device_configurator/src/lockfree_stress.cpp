@@ -0,0 +1,275 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+** Stress test of the lock-free exchanges between the cyclic threads and
+** the user threads: ReadingQueue (both overflow policies), the
+** ReadingDispatcher on top of it, TripleBuffer and the sequence lock of
+** the shared memory slots. One producer and one consumer thread run
+** flat out, the consumer checks that every value arrives untorn and in
+** order, and that the counters add up: every push is either pushed or
+** dropped, and every pushed reading is consumed.
+**   ┌────
+**   │ lockfree_stress [values per run]
+**   └────
+**   Exits with failure on the first violation. Under ThreadSanitizer the
+**   sequence lock reports the race on the slot data it is built around,
+**   the reader discards those copies.
+*/
+#include "ethercat_device_configurator/ReadingDispatcher.hpp"
+#include "ethercat_device_configurator/ReadingQueue.hpp"
+#include "ethercat_device_configurator/SharedMemoryLayout.hpp"
+#include "ethercat_device_configurator/TripleBuffer.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace stress {
+
+// Every word is derived from the sequence, a value mixed from two writes does not pass check
+struct Sample {
+  uint64_t sequence{0};
+  uint64_t words[7]{};
+
+  static Sample make(uint64_t sequence) {
+    Sample sample;
+    sample.sequence = sequence;
+    for (uint64_t i = 0; i < 7; i++) sample.words[i] = sequence * 0x9e3779b97f4a7c15ull + i;
+    return sample;
+  }
+  bool intact() const {
+    for (uint64_t i = 0; i < 7; i++) {
+      if (words[i] != sequence * 0x9e3779b97f4a7c15ull + i) return false;
+    }
+    return true;
+  }
+};
+
+void expect(bool condition, const std::string& message) {
+  if (!condition) throw std::runtime_error(message);
+}
+
+const char* policyName(ReadingOverflowPolicy policy) {
+  return policy == ReadingOverflowPolicy::DropOldest ? "DropOldest" : "DropNewest";
+}
+
+// Paces the producer with a varying delay around the speed of the consumer, so the queues run both full and empty
+void pause(uint64_t sequence) {
+  const uint64_t spins = (sequence * 0x9e3779b97f4a7c15ull) >> 55;
+  for (volatile uint64_t i = 0; i < spins; i = i + 1) {
+  }
+}
+
+void readingQueue(std::size_t capacity, ReadingOverflowPolicy policy, uint64_t values) {
+  ReadingQueue<Sample> queue(capacity, policy);
+  std::atomic<bool> done{false};
+  std::thread producer([&]() {
+    for (uint64_t sequence = 1; sequence <= values; sequence++) {
+      queue.push(Sample::make(sequence));
+      pause(sequence);
+    }
+    done = true;
+  });
+
+  uint64_t consumed = 0;
+  uint64_t last = 0;
+  std::string error;
+  const auto check = [&](const Sample& sample) {
+    if (error.empty() && !sample.intact()) error = "torn value " + std::to_string(sample.sequence);
+    if (error.empty() && sample.sequence <= last) {
+      error = "value " + std::to_string(sample.sequence) + " after " + std::to_string(last);
+    }
+    last = sample.sequence;
+    consumed++;
+  };
+  while (!done) {
+    queue.consume(check);
+  }
+  while (queue.consume(check)) {
+  }
+  producer.join();
+
+  const std::string run = std::string("ReadingQueue ") + policyName(policy) + " capacity " + std::to_string(capacity);
+  expect(error.empty(), run + ": " + error);
+  expect(queue.pushed() == consumed, run + ": pushed " + std::to_string(queue.pushed()) + " != consumed " + std::to_string(consumed));
+  expect(queue.pushed() + queue.dropped() == values, run + ": " + std::to_string(values) + " values != pushed " +
+                                                         std::to_string(queue.pushed()) + " + dropped " + std::to_string(queue.dropped()));
+  // The newest value is never dropped with DropOldest
+  if (policy == ReadingOverflowPolicy::DropOldest) expect(last == values, run + ": last value lost");
+  std::printf("%-40s consumed %9llu dropped %9llu\n", run.c_str(), static_cast<unsigned long long>(consumed),
+              static_cast<unsigned long long>(queue.dropped()));
+}
+
+void readingDispatcher(ReadingOverflowPolicy policy, uint64_t values) {
+  ReadingDispatcher::Configuration configuration;
+  configuration.worker_threads = 3;
+  configuration.queue_capacity = 8;
+  configuration.overflow_policy = policy;
+  configuration.poll_period = 0.00001;
+  ReadingDispatcher dispatcher(configuration);
+
+  // The workers take turns on a channel, one at a time: the state of a callback needs no synchronization
+  constexpr std::size_t number_of_channels = 4;
+  struct Order {
+    uint64_t last{0};
+    bool violated{false};
+  };
+  std::vector<Order> orders(number_of_channels);
+  std::vector<std::shared_ptr<ReadingChannel<Sample>>> channels;
+  for (std::size_t index = 0; index < number_of_channels; index++) {
+    channels.push_back(dispatcher.addChannel<Sample>("channel_" + std::to_string(index), [&orders, index](const std::string&,
+                                                                                                           const Sample& sample) {
+      auto& order = orders[index];
+      order.violated = order.violated || !sample.intact() || sample.sequence <= order.last;
+      order.last = sample.sequence;
+    }));
+  }
+  dispatcher.start();
+  std::thread producer([&]() {
+    for (uint64_t sequence = 1; sequence <= values; sequence++) {
+      // Half of the channels fill the slot in place, as addAsyncReadingCallback does
+      for (std::size_t index = 0; index < number_of_channels; index++) {
+        if (index % 2 == 0) {
+          channels[index]->push(Sample::make(sequence));
+        } else {
+          channels[index]->produce([sequence](Sample& sample) { sample = Sample::make(sequence); });
+        }
+      }
+      pause(sequence);
+    }
+  });
+  producer.join();
+  dispatcher.stop();
+
+  const std::string run = std::string("ReadingDispatcher ") + policyName(policy);
+  for (std::size_t index = 0; index < number_of_channels; index++) {
+    expect(!orders[index].violated, run + ": torn or reordered reading on channel " + std::to_string(index));
+  }
+  const auto statistics = dispatcher.getStatistics();
+  expect(statistics.pushed + statistics.dropped == values * number_of_channels,
+         run + ": pushed " + std::to_string(statistics.pushed) + " + dropped " + std::to_string(statistics.dropped) + " != values");
+  expect(statistics.pushed == statistics.dispatched,
+         run + ": pushed " + std::to_string(statistics.pushed) + " != dispatched " + std::to_string(statistics.dispatched));
+  std::printf("%-40s consumed %9llu dropped %9llu\n", run.c_str(), static_cast<unsigned long long>(statistics.dispatched),
+              static_cast<unsigned long long>(statistics.dropped));
+}
+
+void tripleBuffer(uint64_t values) {
+  TripleBuffer<Sample> buffer;
+  std::atomic<bool> done{false};
+  std::thread producer([&]() {
+    for (uint64_t sequence = 1; sequence <= values; sequence++) {
+      buffer.write(Sample::make(sequence));
+      pause(sequence);
+    }
+    done = true;
+  });
+
+  uint64_t updates = 0;
+  uint64_t last = 0;
+  std::string error;
+  const auto check = [&]() {
+    const Sample& sample = buffer.readBuffer();
+    if (error.empty() && !sample.intact()) error = "torn value " + std::to_string(sample.sequence);
+    if (error.empty() && sample.sequence <= last) error = "value " + std::to_string(sample.sequence) + " after " + std::to_string(last);
+    last = sample.sequence;
+    updates++;
+  };
+  while (!done) {
+    if (buffer.update()) check();
+  }
+  producer.join();
+  if (buffer.update()) check();
+
+  expect(error.empty(), "TripleBuffer: " + error);
+  expect(last == values, "TripleBuffer: latest value " + std::to_string(last) + " not received");
+  std::printf("%-40s updates  %9llu\n", "TripleBuffer", static_cast<unsigned long long>(updates));
+}
+
+void sequenceLock(uint64_t values) {
+  // A reading slot of the shared memory layout, in process memory
+  struct alignas(64) Slot {
+    SharedMemoryReadingSlot slot;
+    Sample sample;
+  };
+  static_assert(sizeof(SharedMemoryReadingSlot) % alignof(Sample) == 0, "the sample has to follow the slot directly");
+  Slot shared;
+  shared.sample = Sample::make(0);
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    for (uint64_t sequence = 1; sequence <= values; sequence++) {
+      const uint32_t odd = sharedMemoryWriteBegin(shared.slot.sequence);
+      *static_cast<Sample*>(sharedMemorySlotData(&shared.slot)) = Sample::make(sequence);
+      sharedMemoryWriteEnd(shared.slot.sequence, odd);
+      pause(sequence);
+    }
+    done = true;
+  });
+
+  uint64_t reads = 0;
+  uint64_t retries = 0;
+  uint64_t last = 0;
+  std::string error;
+  while (!done) {
+    Sample sample;
+    if (!sharedMemoryTryRead(shared.slot.sequence, [&]() { sample = *static_cast<const Sample*>(sharedMemorySlotData(&shared.slot)); })) {
+      retries++;
+      continue;
+    }
+    reads++;
+    if (error.empty() && !sample.intact()) error = "torn value " + std::to_string(sample.sequence);
+    if (error.empty() && sample.sequence < last) error = "value " + std::to_string(sample.sequence) + " after " + std::to_string(last);
+    last = sample.sequence;
+  }
+  writer.join();
+
+  expect(error.empty(), "sequence lock: " + error);
+  std::printf("%-40s reads    %9llu retries %9llu\n", "sequence lock", static_cast<unsigned long long>(reads),
+              static_cast<unsigned long long>(retries));
+}
+
+}  // namespace stress
+
+int main(int argc, char** argv) {
+  uint64_t values = 1000000;
+  if (argc > 1) values = std::strtoull(argv[1], nullptr, 10);
+
+  try {
+    for (auto policy : {ReadingOverflowPolicy::DropNewest, ReadingOverflowPolicy::DropOldest}) {
+      for (std::size_t capacity : {1, 4, 64}) {
+        stress::readingQueue(capacity, policy, values);
+      }
+      stress::readingDispatcher(policy, values / 4);
+    }
+    stress::tripleBuffer(values);
+    stress::sequenceLock(values);
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
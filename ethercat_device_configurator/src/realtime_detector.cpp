@@ -0,0 +1,629 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+** Realtime detector: counts the calls which must not happen on a realtime
+** thread, i.e. allocations, waits on a locked mutex and blocking i/o or
+** sleeps, on the threads inside a RealtimeSection (the cyclic threads of
+** startRuntime). Preload it into a process using the configurator:
+**   ┌────
+**   │ LD_PRELOAD=libethercat_realtime_detector.so path/to/executable ...
+**   └────
+**   The counts are read per master with getRealtimeViolations. With
+**   ETHERCAT_REALTIME_DETECTOR_BACKTRACES=n the backtraces of the first n
+**   violations are printed to stderr.
+*/
+// The hooks replace functions which _FORTIFY_SOURCE defines inline
+#undef _FORTIFY_SOURCE
+
+#include "ethercat_device_configurator/RealtimeViolations.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*posix*/
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Defined by the configurator library, nullptr if the process does not use it
+extern "C" __attribute__((weak)) RealtimeViolations* ethercat_realtime_violations();
+
+// Looked up by RealtimeSection::detectorLoaded
+extern "C" const int ethercat_realtime_detector_version = 1;
+
+namespace {
+
+// The next definitions of the hooked functions, usually the ones of libc
+struct NextFunctions {
+  void* (*malloc)(size_t){nullptr};
+  void* (*calloc)(size_t, size_t){nullptr};
+  void* (*realloc)(void*, size_t){nullptr};
+  void (*free)(void*){nullptr};
+  int (*posix_memalign)(void**, size_t, size_t){nullptr};
+  void* (*aligned_alloc)(size_t, size_t){nullptr};
+  void* (*memalign)(size_t, size_t){nullptr};
+  void* (*valloc)(size_t){nullptr};
+  int (*pthread_mutex_lock)(pthread_mutex_t*){nullptr};
+  int (*pthread_mutex_trylock)(pthread_mutex_t*){nullptr};
+  int (*pthread_rwlock_rdlock)(pthread_rwlock_t*){nullptr};
+  int (*pthread_rwlock_tryrdlock)(pthread_rwlock_t*){nullptr};
+  int (*pthread_rwlock_timedrdlock)(pthread_rwlock_t*, const timespec*){nullptr};
+  int (*pthread_rwlock_wrlock)(pthread_rwlock_t*){nullptr};
+  int (*pthread_rwlock_trywrlock)(pthread_rwlock_t*){nullptr};
+  int (*pthread_rwlock_timedwrlock)(pthread_rwlock_t*, const timespec*){nullptr};
+  int (*pthread_cond_wait)(pthread_cond_t*, pthread_mutex_t*){nullptr};
+  int (*pthread_cond_timedwait)(pthread_cond_t*, pthread_mutex_t*, const timespec*){nullptr};
+  int (*pthread_cond_clockwait)(pthread_cond_t*, pthread_mutex_t*, clockid_t, const timespec*){nullptr};
+  int (*sem_wait)(sem_t*){nullptr};
+  int (*sem_trywait)(sem_t*){nullptr};
+  int (*sem_timedwait)(sem_t*, const timespec*){nullptr};
+  int (*open)(const char*, int, ...){nullptr};
+  int (*open64)(const char*, int, ...){nullptr};
+  int (*openat)(int, const char*, int, ...){nullptr};
+  int (*close)(int){nullptr};
+  ssize_t (*read)(int, void*, size_t){nullptr};
+  ssize_t (*write)(int, const void*, size_t){nullptr};
+  ssize_t (*writev)(int, const iovec*, int){nullptr};
+  ssize_t (*pread)(int, void*, size_t, off_t){nullptr};
+  ssize_t (*pwrite)(int, const void*, size_t, off_t){nullptr};
+  int (*fsync)(int){nullptr};
+  int (*fdatasync)(int){nullptr};
+  FILE* (*fopen)(const char*, const char*){nullptr};
+  FILE* (*fopen64)(const char*, const char*){nullptr};
+  int (*fclose)(FILE*){nullptr};
+  size_t (*fwrite)(const void*, size_t, size_t, FILE*){nullptr};
+  int (*fputs)(const char*, FILE*){nullptr};
+  int (*fputc)(int, FILE*){nullptr};
+  int (*putc)(int, FILE*){nullptr};
+  int (*putchar)(int){nullptr};
+  int (*puts)(const char*){nullptr};
+  int (*vprintf)(const char*, va_list){nullptr};
+  int (*vfprintf)(FILE*, const char*, va_list){nullptr};
+  int (*__vprintf_chk)(int, const char*, va_list){nullptr};
+  int (*__vfprintf_chk)(FILE*, int, const char*, va_list){nullptr};
+  int (*fflush)(FILE*){nullptr};
+  int (*nanosleep)(const timespec*, timespec*){nullptr};
+  int (*usleep)(useconds_t){nullptr};
+  unsigned int (*sleep)(unsigned int){nullptr};
+};
+NextFunctions next;
+bool resolving = false;
+
+// Serves the allocations of dlsym while the next functions are resolved, never freed
+alignas(16) char bootstrap_arena[16384];
+size_t bootstrap_used = 0;
+
+void* bootstrap_allocate(size_t size) {
+  size = (size + 15) & ~static_cast<size_t>(15);
+  if (bootstrap_used + size > sizeof(bootstrap_arena)) return nullptr;
+  void* pointer = bootstrap_arena + bootstrap_used;
+  bootstrap_used += size;
+  return pointer;
+}
+
+bool is_bootstrap(const void* pointer) {
+  return pointer >= bootstrap_arena && pointer < bootstrap_arena + sizeof(bootstrap_arena);
+}
+
+template <typename Function>
+void resolve(Function& function, const char* name) {
+  function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+// dlsym returns the oldest version of the condition variable functions on x86_64 (GLIBC_2.2.5, the old condition variable layout)
+template <typename Function>
+void resolve_condition(Function& function, const char* name) {
+  function = reinterpret_cast<Function>(dlvsym(RTLD_NEXT, name, "GLIBC_2.3.2"));
+  if (!function) resolve(function, name);
+}
+
+void resolve_all() {
+  if (resolving) return;
+  resolving = true;
+  resolve(next.malloc, "malloc");
+  resolve(next.calloc, "calloc");
+  resolve(next.realloc, "realloc");
+  resolve(next.free, "free");
+  resolve(next.posix_memalign, "posix_memalign");
+  resolve(next.aligned_alloc, "aligned_alloc");
+  resolve(next.memalign, "memalign");
+  resolve(next.valloc, "valloc");
+  resolve(next.pthread_mutex_lock, "pthread_mutex_lock");
+  resolve(next.pthread_mutex_trylock, "pthread_mutex_trylock");
+  resolve(next.pthread_rwlock_rdlock, "pthread_rwlock_rdlock");
+  resolve(next.pthread_rwlock_tryrdlock, "pthread_rwlock_tryrdlock");
+  resolve(next.pthread_rwlock_timedrdlock, "pthread_rwlock_timedrdlock");
+  resolve(next.pthread_rwlock_wrlock, "pthread_rwlock_wrlock");
+  resolve(next.pthread_rwlock_trywrlock, "pthread_rwlock_trywrlock");
+  resolve(next.pthread_rwlock_timedwrlock, "pthread_rwlock_timedwrlock");
+  resolve_condition(next.pthread_cond_wait, "pthread_cond_wait");
+  resolve_condition(next.pthread_cond_timedwait, "pthread_cond_timedwait");
+  // glibc 2.30 and newer
+  resolve(next.pthread_cond_clockwait, "pthread_cond_clockwait");
+  resolve(next.sem_wait, "sem_wait");
+  resolve(next.sem_trywait, "sem_trywait");
+  resolve(next.sem_timedwait, "sem_timedwait");
+  resolve(next.open, "open");
+  resolve(next.open64, "open64");
+  resolve(next.openat, "openat");
+  resolve(next.close, "close");
+  resolve(next.read, "read");
+  resolve(next.write, "write");
+  resolve(next.writev, "writev");
+  resolve(next.pread, "pread");
+  resolve(next.pwrite, "pwrite");
+  resolve(next.fsync, "fsync");
+  resolve(next.fdatasync, "fdatasync");
+  resolve(next.fopen, "fopen");
+  resolve(next.fopen64, "fopen64");
+  resolve(next.fclose, "fclose");
+  resolve(next.fwrite, "fwrite");
+  resolve(next.fputs, "fputs");
+  resolve(next.fputc, "fputc");
+  resolve(next.putc, "putc");
+  resolve(next.putchar, "putchar");
+  resolve(next.puts, "puts");
+  resolve(next.vprintf, "vprintf");
+  resolve(next.vfprintf, "vfprintf");
+  resolve(next.__vprintf_chk, "__vprintf_chk");
+  resolve(next.__vfprintf_chk, "__vfprintf_chk");
+  resolve(next.fflush, "fflush");
+  resolve(next.nanosleep, "nanosleep");
+  resolve(next.usleep, "usleep");
+  resolve(next.sleep, "sleep");
+  resolving = false;
+}
+
+// Set while a violation is reported, the allocations and writes of the report are not counted
+__attribute__((tls_model("initial-exec"))) thread_local bool t_reporting = false;
+std::atomic<int> backtraces_left{0};
+
+void write_stderr(const char* text) {
+  if (next.write) next.write(STDERR_FILENO, text, std::strlen(text));
+}
+
+void violation(std::atomic<uint64_t> RealtimeViolations::*counter, const char* call) {
+  if (!ethercat_realtime_violations || t_reporting) return;
+  RealtimeViolations* violations = ethercat_realtime_violations();
+  if (!violations) return;
+  (violations->*counter).fetch_add(1, std::memory_order_relaxed);
+  if (backtraces_left.load(std::memory_order_relaxed) <= 0 || backtraces_left.fetch_sub(1, std::memory_order_relaxed) <= 0) return;
+  t_reporting = true;
+  write_stderr("[RealtimeDetector] ");
+  write_stderr(call);
+  write_stderr(" on a realtime thread:\n");
+  void* frames[32];
+  backtrace_symbols_fd(frames, backtrace(frames, 32), STDERR_FILENO);
+  t_reporting = false;
+}
+
+void allocation(const char* call) {
+  violation(&RealtimeViolations::allocations, call);
+}
+
+void blocking_call(const char* call) {
+  violation(&RealtimeViolations::blocking_calls, call);
+}
+
+__attribute__((constructor)) void initialize() {
+  resolve_all();
+  if (const char* backtraces = std::getenv("ETHERCAT_REALTIME_DETECTOR_BACKTRACES")) {
+    backtraces_left = std::atoi(backtraces);
+  }
+  if (backtraces_left > 0) {
+    // Loads the unwinder now instead of on the first violation
+    void* frame;
+    backtrace(&frame, 1);
+  }
+}
+
+}  // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+  if (!next.malloc) {
+    resolve_all();
+    if (!next.malloc) return bootstrap_allocate(size);
+  }
+  allocation("malloc");
+  return next.malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  if (!next.calloc) {
+    resolve_all();
+    // The arena is zero initialized
+    if (!next.calloc) return size != 0 && count > SIZE_MAX / size ? nullptr : bootstrap_allocate(count * size);
+  }
+  allocation("calloc");
+  return next.calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+  if (!next.realloc) resolve_all();
+  allocation("realloc");
+  if (is_bootstrap(pointer)) {
+    void* moved = malloc(size);
+    if (moved) std::memcpy(moved, pointer, std::min<size_t>(size, bootstrap_arena + sizeof(bootstrap_arena) - static_cast<char*>(pointer)));
+    return moved;
+  }
+  return next.realloc(pointer, size);
+}
+
+void free(void* pointer) {
+  if (!pointer || is_bootstrap(pointer)) return;
+  if (!next.free) resolve_all();
+  allocation("free");
+  next.free(pointer);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+  if (!next.posix_memalign) resolve_all();
+  allocation("posix_memalign");
+  return next.posix_memalign(pointer, alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  if (!next.aligned_alloc) resolve_all();
+  allocation("aligned_alloc");
+  return next.aligned_alloc(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  if (!next.memalign) resolve_all();
+  allocation("memalign");
+  return next.memalign(alignment, size);
+}
+
+void* valloc(size_t size) {
+  if (!next.valloc) resolve_all();
+  allocation("valloc");
+  return next.valloc(size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+  if (!next.pthread_mutex_lock) resolve_all();
+  // Only a lock held by another thread is a wait
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    const int result = next.pthread_mutex_trylock(mutex);
+    if (result != EBUSY) return result;
+    violation(&RealtimeViolations::lock_waits, "pthread_mutex_lock (contended)");
+  }
+  return next.pthread_mutex_lock(mutex);
+}
+
+// std::shared_mutex
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+  if (!next.pthread_rwlock_rdlock) resolve_all();
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    const int result = next.pthread_rwlock_tryrdlock(lock);
+    if (result != EBUSY) return result;
+    violation(&RealtimeViolations::lock_waits, "pthread_rwlock_rdlock (contended)");
+  }
+  return next.pthread_rwlock_rdlock(lock);
+}
+
+int pthread_rwlock_timedrdlock(pthread_rwlock_t* lock, const timespec* deadline) {
+  if (!next.pthread_rwlock_timedrdlock) resolve_all();
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    const int result = next.pthread_rwlock_tryrdlock(lock);
+    if (result != EBUSY) return result;
+    violation(&RealtimeViolations::lock_waits, "pthread_rwlock_timedrdlock (contended)");
+  }
+  return next.pthread_rwlock_timedrdlock(lock, deadline);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+  if (!next.pthread_rwlock_wrlock) resolve_all();
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    const int result = next.pthread_rwlock_trywrlock(lock);
+    if (result != EBUSY) return result;
+    violation(&RealtimeViolations::lock_waits, "pthread_rwlock_wrlock (contended)");
+  }
+  return next.pthread_rwlock_wrlock(lock);
+}
+
+int pthread_rwlock_timedwrlock(pthread_rwlock_t* lock, const timespec* deadline) {
+  if (!next.pthread_rwlock_timedwrlock) resolve_all();
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    const int result = next.pthread_rwlock_trywrlock(lock);
+    if (result != EBUSY) return result;
+    violation(&RealtimeViolations::lock_waits, "pthread_rwlock_timedwrlock (contended)");
+  }
+  return next.pthread_rwlock_timedwrlock(lock, deadline);
+}
+
+// std::condition_variable, always a wait
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex) {
+  if (!next.pthread_cond_wait) resolve_all();
+  violation(&RealtimeViolations::lock_waits, "pthread_cond_wait");
+  return next.pthread_cond_wait(condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const timespec* deadline) {
+  if (!next.pthread_cond_timedwait) resolve_all();
+  violation(&RealtimeViolations::lock_waits, "pthread_cond_timedwait");
+  return next.pthread_cond_timedwait(condition, mutex, deadline);
+}
+
+int pthread_cond_clockwait(pthread_cond_t* condition, pthread_mutex_t* mutex, clockid_t clock, const timespec* deadline) {
+  if (!next.pthread_cond_clockwait) resolve_all();
+  // Only called by programs linked against a glibc which has it
+  if (!next.pthread_cond_clockwait) return ENOSYS;
+  violation(&RealtimeViolations::lock_waits, "pthread_cond_clockwait");
+  return next.pthread_cond_clockwait(condition, mutex, clock, deadline);
+}
+
+// Only a semaphore at 0 is a wait
+int sem_wait(sem_t* semaphore) {
+  if (!next.sem_wait) resolve_all();
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    if (next.sem_trywait(semaphore) == 0) return 0;
+    violation(&RealtimeViolations::lock_waits, "sem_wait (at 0)");
+  }
+  return next.sem_wait(semaphore);
+}
+
+int sem_timedwait(sem_t* semaphore, const timespec* deadline) {
+  if (!next.sem_timedwait) resolve_all();
+  if (ethercat_realtime_violations && ethercat_realtime_violations()) {
+    if (next.sem_trywait(semaphore) == 0) return 0;
+    violation(&RealtimeViolations::lock_waits, "sem_timedwait (at 0)");
+  }
+  return next.sem_timedwait(semaphore, deadline);
+}
+
+int open(const char* path, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & (O_CREAT | O_TMPFILE)) {
+    va_list arguments;
+    va_start(arguments, flags);
+    mode = va_arg(arguments, mode_t);
+    va_end(arguments);
+  }
+  if (!next.open) resolve_all();
+  blocking_call("open");
+  return next.open(path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & (O_CREAT | O_TMPFILE)) {
+    va_list arguments;
+    va_start(arguments, flags);
+    mode = va_arg(arguments, mode_t);
+    va_end(arguments);
+  }
+  if (!next.open64) resolve_all();
+  blocking_call("open64");
+  return next.open64(path, flags, mode);
+}
+
+int openat(int directory, const char* path, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & (O_CREAT | O_TMPFILE)) {
+    va_list arguments;
+    va_start(arguments, flags);
+    mode = va_arg(arguments, mode_t);
+    va_end(arguments);
+  }
+  if (!next.openat) resolve_all();
+  blocking_call("openat");
+  return next.openat(directory, path, flags, mode);
+}
+
+int close(int file) {
+  if (!next.close) resolve_all();
+  blocking_call("close");
+  return next.close(file);
+}
+
+ssize_t read(int file, void* buffer, size_t size) {
+  if (!next.read) resolve_all();
+  blocking_call("read");
+  return next.read(file, buffer, size);
+}
+
+ssize_t write(int file, const void* buffer, size_t size) {
+  if (!next.write) resolve_all();
+  blocking_call("write");
+  return next.write(file, buffer, size);
+}
+
+ssize_t writev(int file, const iovec* vectors, int count) {
+  if (!next.writev) resolve_all();
+  blocking_call("writev");
+  return next.writev(file, vectors, count);
+}
+
+ssize_t pread(int file, void* buffer, size_t size, off_t offset) {
+  if (!next.pread) resolve_all();
+  blocking_call("pread");
+  return next.pread(file, buffer, size, offset);
+}
+
+ssize_t pwrite(int file, const void* buffer, size_t size, off_t offset) {
+  if (!next.pwrite) resolve_all();
+  blocking_call("pwrite");
+  return next.pwrite(file, buffer, size, offset);
+}
+
+int fsync(int file) {
+  if (!next.fsync) resolve_all();
+  blocking_call("fsync");
+  return next.fsync(file);
+}
+
+int fdatasync(int file) {
+  if (!next.fdatasync) resolve_all();
+  blocking_call("fdatasync");
+  return next.fdatasync(file);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+  if (!next.fopen) resolve_all();
+  blocking_call("fopen");
+  return next.fopen(path, mode);
+}
+
+FILE* fopen64(const char* path, const char* mode) {
+  if (!next.fopen64) resolve_all();
+  blocking_call("fopen64");
+  return next.fopen64(path, mode);
+}
+
+int fclose(FILE* stream) {
+  if (!next.fclose) resolve_all();
+  blocking_call("fclose");
+  return next.fclose(stream);
+}
+
+// stdio is buffered, but a full buffer or a flush writes from the calling thread. std::cout (and MELO_* logging) ends up here.
+// The write glibc makes internally (__write) cannot be interposed, it is counted at the stdio call which triggered it.
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* stream) {
+  if (!next.fwrite) resolve_all();
+  blocking_call("fwrite");
+  return next.fwrite(buffer, size, count, stream);
+}
+
+int fputs(const char* text, FILE* stream) {
+  if (!next.fputs) resolve_all();
+  blocking_call("fputs");
+  return next.fputs(text, stream);
+}
+
+int fputc(int character, FILE* stream) {
+  if (!next.fputc) resolve_all();
+  blocking_call("fputc");
+  return next.fputc(character, stream);
+}
+
+int putc(int character, FILE* stream) {
+  if (!next.putc) resolve_all();
+  blocking_call("putc");
+  return next.putc(character, stream);
+}
+
+int putchar(int character) {
+  if (!next.putchar) resolve_all();
+  blocking_call("putchar");
+  return next.putchar(character);
+}
+
+// printf without arguments is compiled to puts
+int puts(const char* text) {
+  if (!next.puts) resolve_all();
+  blocking_call("puts");
+  return next.puts(text);
+}
+
+int vprintf(const char* format, va_list arguments) {
+  if (!next.vprintf) resolve_all();
+  blocking_call("vprintf");
+  return next.vprintf(format, arguments);
+}
+
+int vfprintf(FILE* stream, const char* format, va_list arguments) {
+  if (!next.vfprintf) resolve_all();
+  blocking_call("vfprintf");
+  return next.vfprintf(stream, format, arguments);
+}
+
+int printf(const char* format, ...) {
+  if (!next.vprintf) resolve_all();
+  blocking_call("printf");
+  va_list arguments;
+  va_start(arguments, format);
+  const int result = next.vprintf(format, arguments);
+  va_end(arguments);
+  return result;
+}
+
+int fprintf(FILE* stream, const char* format, ...) {
+  if (!next.vfprintf) resolve_all();
+  blocking_call("fprintf");
+  va_list arguments;
+  va_start(arguments, format);
+  const int result = next.vfprintf(stream, format, arguments);
+  va_end(arguments);
+  return result;
+}
+
+// printf / fprintf of programs built with _FORTIFY_SOURCE
+int __printf_chk(int flag, const char* format, ...) {
+  if (!next.__vprintf_chk) resolve_all();
+  blocking_call("printf");
+  va_list arguments;
+  va_start(arguments, format);
+  const int result = next.__vprintf_chk(flag, format, arguments);
+  va_end(arguments);
+  return result;
+}
+
+int __fprintf_chk(FILE* stream, int flag, const char* format, ...) {
+  if (!next.__vfprintf_chk) resolve_all();
+  blocking_call("fprintf");
+  va_list arguments;
+  va_start(arguments, format);
+  const int result = next.__vfprintf_chk(stream, flag, format, arguments);
+  va_end(arguments);
+  return result;
+}
+
+int fflush(FILE* stream) {
+  if (!next.fflush) resolve_all();
+  blocking_call("fflush");
+  return next.fflush(stream);
+}
+
+// clock_nanosleep is not hooked, the cyclic threads wait for their next cycle with it
+int nanosleep(const timespec* duration, timespec* remaining) {
+  if (!next.nanosleep) resolve_all();
+  blocking_call("nanosleep");
+  return next.nanosleep(duration, remaining);
+}
+
+int usleep(useconds_t duration) {
+  if (!next.usleep) resolve_all();
+  blocking_call("usleep");
+  return next.usleep(duration);
+}
+
+unsigned int sleep(unsigned int seconds) {
+  if (!next.sleep) resolve_all();
+  blocking_call("sleep");
+  return next.sleep(seconds);
+}
+
+}  // extern "C"
@@ -0,0 +1,57 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+** Converts the ring files of a CycleRecorder (one master) into a csv file, one row per cycle and one column per value.
+**   ┌────
+**   │ recorder_to_csv output.csv recording/eth0_20260101-120000_*.cyclerec
+**   └────
+** Use - as output to write to stdout.
+*/
+#include "ethercat_device_configurator/CycleRecorder.hpp"
+
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: recorder_to_csv <output.csv | -> <ring files of one master...>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string output = argv[1];
+  try {
+    const auto recording = CycleRecording::read(std::vector<std::string>(argv + 2, argv + argc));
+    if (output == "-") {
+      recording.writeCsv(std::cout);
+    } else {
+      std::ofstream stream(output);
+      if (!stream) throw std::runtime_error("Could not open " + output);
+      recording.writeCsv(stream);
+      if (!stream) throw std::runtime_error("Could not write " + output);
+      std::cerr << "Wrote " << recording.numberOfFrames() << " cycles of bus " << recording.ethercat_bus << " to " << output << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
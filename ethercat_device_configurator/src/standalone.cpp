@@ -42,6 +42,7 @@
 **   README.md for more details.
 */
 #include "ethercat_device_configurator/EthercatDeviceConfigurator.hpp"
+#include "ethercat_device_configurator/JointStateSnapshot.hpp"
 #include "message_logger/message_logger.hpp"
 
 #ifdef _ANYDRIVE_FOUND_
@@ -68,16 +69,15 @@ namespace example {
 // possible dummy slave callbacks:
 #ifdef _ANYDRIVE_FOUND_
 void anydriveReadingCb(const std::string& name, const anydrive_rsl::ReadingExtended& reading) {
-  // note: callbacks are called within the ethercat update loop, they should not block! otherwise you'll see working counter too low errors
-  // all the time and your motors will not behave as expected.
+  // note: this callback runs on a worker of the configurator's reading dispatcher, not within the ethercat update loop. it may block, the
+  // update loop only queues the readings. callbacks added directly with addReadingCb run within the update loop and must not block.
   MELO_INFO_THROTTLE_STREAM(5, "[EthercatDeviceConfiguratorExample] Dummy Callback, reading of anydrive '"
                                    << name << "Joint velocity: " << reading.getState().getJointVelocity());
 }
 #endif
 #ifdef _ROKUBI_FOUND_
 void rokubiReadingCb(const std::string& name, const rokubimini::Reading& reading) {
-  //  //note: callbacks are called within the ethercat update loop, they should not block! otherwise you'll see working counter too low
-  //  errors all the time and your motors will not behave as expected.
+  // note: runs on a worker of the configurator's reading dispatcher, see anydriveReadingCb.
   MELO_INFO_THROTTLE_STREAM(5, "[EthercatDeviceConfiguratorExample] Dummy Callback, Reading of rokubi: "
                                    << name << " Force X: " << reading.getWrench().wrench_.getForce().toImplementation().x());
 }
@@ -95,6 +95,8 @@ class ExampleEcatHardwareInterface {
     configurator_->initializeFromFile(pathToConfigFile);
 
     ecatMaster_ = configurator_->master();  // throws if more than one master.
+    // position, velocity, torque of all slaves as contiguous arrays indexed by slave handle, gathered once per cycle.
+    jointStates_ = configurator_->addJointStateSnapshot();
 
     // get a list
 #ifdef _ELMO_FOUND_
@@ -113,7 +115,10 @@ class ExampleEcatHardwareInterface {
     ** of a ceratain type.
     */
     for (const auto& anydrive : anydrives_) {
-      anydrive->addReadingCb(anydriveReadingCb);
+      // the sdk callback within the update loop only pushes a copy of the reading, the dispatcher calls anydriveReadingCb.
+      auto channel =
+          configurator_->getReadingDispatcher().addChannel<anydrive_rsl::ReadingExtended>(anydrive->getName(), anydriveReadingCb);
+      anydrive->addReadingCb([channel](const std::string&, const anydrive_rsl::ReadingExtended& reading) { channel->push(reading); });
     }
 #endif
 #ifdef _ROKUBI_FOUND_
@@ -126,7 +131,8 @@ class ExampleEcatHardwareInterface {
     ** of a ceratain type.
     */
     for (auto& sensor : botaSensors_) {
-      sensor->addReadingCb(rokubiReadingCb);
+      auto channel = configurator_->getReadingDispatcher().addChannel<rokubimini::Reading>(sensor->getName(), rokubiReadingCb);
+      sensor->addReadingCb([channel](const std::string&, const rokubimini::Reading& reading) { channel->push(reading); });
     }
 #endif
 #ifdef _MPSDRIVE_FOUND_
@@ -137,17 +143,23 @@ class ExampleEcatHardwareInterface {
     // other operations can be performed in between. when the bus is directly put into OP state with startup(true) a watchdog on the slave
     // is started which checks if cyclic PDO is happening, if this communication is not started fast enough the drive goes into an error
     // state.
-    if (ecatMaster_->startup(startupAbortFlag_)) {
-      MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Successfully started Ethercat Master on Network Interface: "
-                       << ecatMaster_->getBusPtr()->getName());
-    } else {
-      MELO_ERROR_STREAM("[EthercatDeviceConfiguratorExample] Could not start the Ethercat Master.")
-      return false;
+    // startupAsync starts all buses concurrently, here we only have one. The future is ready when the startup finished or was aborted.
+    for (auto& startupReport : configurator_->startupAsync()) {
+      const auto report = startupReport.get();
+      if (report.success) {
+        MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Successfully started Ethercat Master on Network Interface: "
+                         << report.ethercat_bus);
+      } else {
+        MELO_ERROR_STREAM("[EthercatDeviceConfiguratorExample] Could not start the Ethercat Master: " << report.error)
+        return false;
+      }
     }
 
     // slaves are no in SAFE_OP state. SDO communication is available - special SDO config calls should be done in the slaves startup
     // memeber function which is called by the ecatMaster->startup() or here.
 
+    // workers for the reading callbacks. startRuntime would start them, this example runs its own update loop.
+    configurator_->getReadingDispatcher().start();
     workerThread_ = std::make_unique<std::thread>([this]() -> void {
       if (ecatMaster_->setRealtimePriority(48)) {  // do not set above 48, otherwise starve kernel processes on which soem depends.
         MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Set increased thread priority to 48")
@@ -162,6 +174,8 @@ class ExampleEcatHardwareInterface {
       // here the watchdog on the slave is activated. therefore don't block/sleep for 100ms..
       while (!abrtFlag_) {
         ecatMaster_->update(ecat_master::UpdateMode::StandaloneEnforceStep);
+        // startRuntime would do this in its cyclic thread: gather the readings of all slaves for the user thread.
+        jointStates_->cycle(0);
         // we could have interaction with some slaves here, e.g. getting and setting commands. this is than in sync with the ethercat loop.
         // but we have to be carefully to no block it too long. otherwise problems with certain slaves.
       }
@@ -179,42 +193,20 @@ class ExampleEcatHardwareInterface {
     // synchronous modes (csp, csv, cst, csc) with those drives you also have to check that interpolationIndex is set so that it reflects
     // the update time of the ethercat loop.
 
-#ifdef _ANYDRIVE_FOUND_
-    for (auto& anydrive : anydrives_) {
-      // put into controlOP, in blocking mode.
-      anydrive->setFSMGoalState(anydrive_rsl::fsm::StateEnum::ControlOp, true, 1, 10);
-    }
-#endif
-#ifdef _ROKUBI_FOUND_
-    // Do things with the Rokubi sensors here, seens a simple sensor no big activation needed.
-#endif
-#ifdef _ELMO_FOUND_
-    for (auto& elmo : elmos_) {
-      // Set elmos to operation enabled state, there is a option which is blocking s.t the user thread can pause till all elmos are
-      // operational
-      elmo->setDriveStateViaPdo(elmo::DriveState::OperationEnabled, true);
-      // set commands if we can
-    }
-#endif
-
-#ifdef _MPSDRIVE_FOUND_
-    // Set elmos to operation enabled state, do not block the call!
-    for (auto& mpsDrive : mpsDrives_) {
-      mpsDrive->setDriveStateViaPdo(mps_ethercat_sdk::DriveState::OperationEnabled, false);
-    }
-
-#endif
-#ifdef _MAXON_FOUND_
-    for (auto& maxon : maxons_) {
-      // Set maxons to operation enabled state, do not block the call!
-      maxon->setDriveStateViaPdo(maxon::DriveState::OperationEnabled, true);  // todo check
+    // Put all drives into ControlOp (anydrive) / OperationEnabled (elmo, mps drive, maxon). The target state is requested on all drives at
+    // once and the call blocks till all of them reached it or the shared timeout passed, instead of one blocking transition per drive.
+    // Devices without a drive state machine, e.g. Rokubi sensors, are skipped. Failed transitions are logged by the configurator.
+    for (const auto& result : configurator_->setDriveStates(EthercatDeviceConfigurator::DriveTarget::Operational, {}, {}, 10.0)) {
+      if (result.success) {
+        MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Drive " << result.name << " operational after " << result.duration << " s")
+      }
     }
-#endif
   }
 
   void cyclicUserInteraction() {
     userCyclicThread_ = std::make_unique<std::thread>([this]() {
       while (userInteraction_) {
+        jointStates_->update();
         // this can run fully async, as here! but be aware that we're doing concurrent blocking calls into the time sensitive cyclic PDO
         // loop. there are multiple ways to avoid/improve this e.g. syncing this interaction with the cyclic PDO loop with conditional
         // variables e.g. queue the readings into a (lock-free) fancy producer consumer queue e.g. copy out the readings in a callback. (the
@@ -240,9 +232,9 @@ class ExampleEcatHardwareInterface {
             // this is one concurrent call.
             elmo->stageCommand(command);
           }
-          // this is an other concurrent call into the ethercat update loop
-          auto reading = elmo->getReading();
-          MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Elmo: " << elmo->getName() << " velocity: " << reading.getActualVelocity());
+          // no call into the ethercat update loop: the velocity is read from the snapshot of the last cycle
+          MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Elmo: "
+                           << elmo->getName() << " velocity: " << jointStates_->getStates().velocity[configurator_->getSlaveHandle(elmo)]);
         }
 #endif
 #ifdef _MPSDRIVE_FOUND_
@@ -307,14 +299,29 @@ class ExampleEcatHardwareInterface {
       }
     }
     MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Joined the ethercat master.")
+    if (configurator_) {
+      configurator_->getReadingDispatcher().stop();
+    }
 
-    if (ecatMaster_) {
-      ecatMaster_->shutdown();
+    if (configurator_) {
+      // shuts down all buses concurrently, bounded by a hard deadline. with startRuntime instead of an own update loop this would also
+      // do the preShutdown and stop the cyclic threads.
+      for (auto& shutdownReport : configurator_->shutdownAsync(5.0)) {
+        const auto report = shutdownReport.get();
+        if (!report.success) {
+          MELO_WARN_STREAM("[EthercatDeviceConfiguratorExample] Shutdown of " << report.ethercat_bus << " failed: " << report.error)
+        }
+      }
     }
     MELO_INFO_STREAM("[EthercatDeviceConfiguratorExample] Fully shutdown.")
   }
 
-  void abortStartup() { startupAbortFlag_ = true; }
+  void abortStartup() {
+    // only sets an atomic flag, can be called from the signal handler.
+    if (configurator_) {
+      configurator_->abortStartup();
+    }
+  }
 
   ~ExampleEcatHardwareInterface() {
     // if no signal handler is used - we can do this in the destructor.
@@ -325,6 +332,7 @@ class ExampleEcatHardwareInterface {
  private:
   EthercatDeviceConfigurator::SharedPtr configurator_;
   ecat_master::EthercatMaster::SharedPtr ecatMaster_;
+  std::shared_ptr<JointStateSnapshot> jointStates_;
 
 // cache the devices on the bus, since topology of the robot does not change dynamically.
 // in the more general case you would do this per bus. e.g. you have a robot with two ethercat buses.
@@ -349,7 +357,6 @@ class ExampleEcatHardwareInterface {
 
   std::unique_ptr<std::thread> workerThread_;
   std::unique_ptr<std::thread> userCyclicThread_;
-  std::atomic<bool> startupAbortFlag_{false};
   std::atomic<bool> abrtFlag_{false};
   std::atomic<bool> userInteraction_{true};
 };
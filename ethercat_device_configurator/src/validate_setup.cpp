@@ -0,0 +1,48 @@
+/*
+ ** Copyright 2021 Robotic Systems Lab - ETH Zurich:
+ ** Lennart Nachtigall, Jonas Junger
+ ** Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ *are met:
+ **
+ ** 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ **
+ ** 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+ *documentation and/or other materials provided with the distribution.
+ **
+ ** 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from
+ *this software without specific prior written permission.
+ **
+ ** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ *ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ *USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+** Preflight check of a setup.yaml and all referenced device configuration
+** files, without touching any bus. Prints every error found. The devices are
+** created serially unless a thread count is given (0: hardware concurrency).
+**   ┌────
+**   │ validate_setup path/to/setup.yaml [threads]
+**   └────
+*/
+#include "ethercat_device_configurator/EthercatDeviceConfigurator.hpp"
+
+#include <iostream>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: validate_setup <setup.yaml> [threads]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const unsigned int threads = argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 1;
+  const auto report = EthercatDeviceConfigurator::validateSetupFile(argv[1], threads);
+  for (const auto& error : report.errors) {
+    std::cerr << error << std::endl;
+  }
+  std::cout << argv[1] << ": " << report.errors.size() << " error(s), " << report.valid_devices << " valid device(s), checked in "
+            << report.duration << " s" << std::endl;
+  return report.valid() ? EXIT_SUCCESS : EXIT_FAILURE;
+}